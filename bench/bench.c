@@ -0,0 +1,703 @@
+/* Microbenchmarks for the perform routines in `src/`.
+ *
+ * Each object is created through its class's new method, its dsp method is
+ * called with fake signal vectors, and the perform routines it passed to
+ * dsp_add are then called directly in a loop. There's no Pd involved: see
+ * `m_pd.h` and `pd_stub.c` in this directory.
+ *
+ * usage: simple_del_bench [-c] [-q] [-t msecs] [-k kernel] [-i interp] [class ...]
+ *   -c        self-check: don't time anything, run each fast path against the
+ *             direct one instead (see below) and exit with 1 if any differ
+ *   -q        quick run: fewer block sizes, buffer lengths and tap counts
+ *   -t msecs  time spent measuring each case (default 20)
+ *   -k kernel use this tap kernel (scalar, sse2, avx2) instead of the one
+ *             picked for the CPU
+ *   -i interp create delay2~ and multitap~ with this interpolation (none,
+ *             linear, cubic, lagrange, allpass, sinc) rather than cubic
+ *   class     only run cases for these classes (e.g. `multitap~`)
+ *
+ * Objects with a delay time inlet are run twice: once with a constant delay
+ * time ("const"), and once with one that changes every sample ("mod").
+ * delay2~ is also run with its delay time set by a `time` message ("time").
+ * multitap~ is also run from a tap table ("table"), with the taps spread
+ * unevenly over the buffer. simple_delwrite~ is run with each of its readers:
+ * one simple_delread~ per tap, a simple_delread_bank~ reading all the taps,
+ * and simple_vd~. delay2~ is also run with a 32 channel input ("delay2~ x32"),
+ * with the time divided by the number of channels, so that it compares with a
+ * row of mono delay2~.
+ *
+ * For each case it reports ns/sample, samples/s, and how many instances of the
+ * case would fit in the time one sample takes at 48kHz (the same ratio holds
+ * for a whole audio callback).
+ *
+ * The self-check (-c) runs each object twice on the same input, once on a fast
+ * path and once on the direct per-sample one, and compares the outlets: the
+ * tap kernel against the scalar one, `fft on` against `fft off` (multitap~),
+ * `thread 1` against `thread 0` (multitap~ and stereotaps2~, where the fast
+ * output is a block late), and the multi-sample passes of delay~ and delay2~
+ * against one sample at a time. A case fails if any sample is off by more than
+ * 1e-5 of the loudest direct one.
+ * */
+
+#include "pd_stub.h"
+#include "../src/simple_del_shared.h"
+#include "../src/simple_del_thread.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SR 48000
+#define BENCH_MAXSIGS 72
+
+void simple_delwrite_tilde_setup(void);
+void simple_delread_tilde_setup(void);
+void simple_delread_bank_tilde_setup(void);
+void simple_vd_tilde_setup(void);
+void delay_tilde_setup(void);
+void delay1_tilde_setup(void);
+void delay1_cubic_tilde_setup(void);
+void delay2_tilde_setup(void);
+void multitap_tilde_setup(void);
+void stereotaps_tilde_setup(void);
+void stereotaps2_tilde_setup(void);
+
+static const int bench_blocks[] = {1, 64, 256, 2048};
+static const int bench_blocks_quick[] = {64};
+static const t_float bench_buffers[] = {100, 1000, 10000};
+static const t_float bench_buffers_quick[] = {1000};
+static const int bench_taps[] = {1, 4, 16, 64, 512};
+static const int bench_taps_quick[] = {4, 16};
+
+#define NELEM(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+typedef struct _bench_config
+{
+  const int *c_blocks;
+  int c_nblocks;
+  const t_float *c_buffers;
+  int c_nbuffers;
+  const int *c_taps;
+  int c_ntaps;
+  double c_min_ns; // time spent measuring each case
+  t_symbol *c_interp; // creation argument for the classes that take one
+  int c_nfilter;
+  char **c_filter;
+} t_bench_config;
+
+static t_bench_config bench_config;
+
+// the signal vectors handed to the dsp method: inputs first, then outputs,
+// the way Pd orders them
+typedef struct _bench_sigs
+{
+  t_signal b_sig[BENCH_MAXSIGS];
+  t_signal *b_sp[BENCH_MAXSIGS];
+  int b_nsigs;
+} t_bench_sigs;
+
+static double bench_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bench_wanted(const char *class_name)
+{
+  int i;
+  if (!bench_config.c_nfilter) return 1;
+  for (i = 0; i < bench_config.c_nfilter; i++) {
+    if (!strcmp(bench_config.c_filter[i], class_name)) return 1;
+  }
+  return 0;
+}
+
+// deterministic noise, so every run sees the same input. the self-check puts
+// the seed back before each run, so that the paths it compares see the same noise
+#define BENCH_NOISE_SEED 12345u
+static unsigned int bench_noise_seed = BENCH_NOISE_SEED;
+
+static void bench_fill_noise(t_sample *vec, int n)
+{
+  int i;
+  for (i = 0; i < n; i++) {
+    bench_noise_seed = bench_noise_seed * 1664525u + 1013904223u;
+    vec[i] = ((t_sample)(bench_noise_seed >> 8) / (t_sample)(1 << 24)) * 2 - 1;
+  }
+}
+
+static void bench_fill_const(t_sample *vec, int n, t_sample f)
+{
+  int i;
+  for (i = 0; i < n; i++) vec[i] = f;
+}
+
+// a delay time that moves by up to 1% every sample, like a chorus would
+static void bench_fill_mod(t_sample *vec, int n, t_sample f)
+{
+  int i;
+  for (i = 0; i < n; i++) vec[i] = f * (1 + 0.01f * (i & 1 ? 1 : -1) * (t_sample)i / n);
+}
+
+static void bench_sigs_init(t_bench_sigs *s, int nsigs, int n)
+{
+  int i;
+  s->b_nsigs = nsigs;
+  for (i = 0; i < nsigs; i++) {
+    t_signal *sig = &s->b_sig[i];
+    memset(sig, 0, sizeof(t_signal));
+    sig->s_length = n;
+    sig->s_n = n;
+    sig->s_nchans = 1;
+    sig->s_sr = BENCH_SR;
+    sig->s_vec = (t_sample *)calloc(n, sizeof(t_sample));
+    s->b_sp[i] = sig;
+  }
+}
+
+// makes signal `i` `nchans` channels wide
+static void bench_sigs_multi(t_bench_sigs *s, int i, int nchans)
+{
+  t_signal *sig = &s->b_sig[i];
+  free(sig->s_vec);
+  sig->s_nchans = nchans;
+  sig->s_n = sig->s_length * nchans;
+  sig->s_vec = (t_sample *)calloc(sig->s_n, sizeof(t_sample));
+}
+
+static void bench_sigs_free(t_bench_sigs *s)
+{
+  int i;
+  for (i = 0; i < s->b_nsigs; i++) free(s->b_sig[i].s_vec);
+}
+
+static void bench_chain_tick(void)
+{
+  int i, nchain = stub_chain_count();
+  for (i = 0; i < nchain; i++) {
+    t_int *w = stub_chain_get(i)->c_w;
+    ((t_perfroutine)w[0])(w);
+  }
+}
+
+// runs the DSP chain until at least `min_ns` have passed and returns the
+// average ns per sample. `warmup` blocks are run first, so that the timing
+// doesn't include the first pass of the write head through a fresh buffer
+static double bench_time_chain(int n, int warmup)
+{
+  double start, elapsed;
+  long blocks = 0;
+  int batch = 16384 / n;
+  int i;
+
+  if (batch < 1) batch = 1;
+  for (i = 0; i < warmup; i++) bench_chain_tick();
+
+  start = bench_now_ns();
+  do {
+    for (i = 0; i < batch; i++) bench_chain_tick();
+    blocks += batch;
+    elapsed = bench_now_ns() - start;
+  } while (elapsed < bench_config.c_min_ns);
+
+  return elapsed / ((double)blocks * n);
+}
+
+static void bench_report(const char *class_name, int n, t_float buffer_ms,
+                         int taps, const char *delay_mode, double ns_per_sample)
+{
+  char taps_str[16];
+  if (taps > 0) snprintf(taps_str, sizeof(taps_str), "%d", taps);
+  else snprintf(taps_str, sizeof(taps_str), "-");
+  printf("%-26s %6d %8g %5s %6s %11.3f %14.0f %12.1f\n",
+         class_name, n, (double)buffer_ms, taps_str, delay_mode, ns_per_sample,
+         1e9 / ns_per_sample, (1e9 / BENCH_SR) / ns_per_sample);
+  fflush(stdout);
+}
+
+static int bench_warmup_blocks(t_float buffer_ms, int n)
+{
+  return (int)(buffer_ms * BENCH_SR * 0.001f) / n + 1;
+}
+
+/* single object cases */
+
+typedef struct _bench_object
+{
+  const char *o_class;
+  int o_nin;
+  int o_nout;
+  int o_has_taps; // accepts a `taps` message
+  int o_has_table; // accepts a `taps` list of (time gain feedback-send)
+  int o_has_time; // accepts a `time` message in place of the delay time inlet
+  int o_nchans; // channels in the first inlet and the outlets
+  const char *o_name; // in the report
+} t_bench_object;
+
+enum { BENCH_CONST, BENCH_MOD, BENCH_TABLE, BENCH_TIME, BENCH_NMODES };
+static const char *bench_delay_modes[] = {"const", "mod", "table", "time"};
+
+static const t_bench_object bench_objects[] = {
+  {"delay~", 2, 1, 0, 0, 0, 1, "delay~"},
+  {"delay1~", 1, 1, 0, 0, 0, 1, "delay1~"},
+  {"delay1_cubic~", 1, 1, 0, 0, 0, 1, "delay1_cubic~"},
+  {"delay2~", 2, 1, 0, 0, 1, 1, "delay2~"},
+  {"delay2~", 2, 1, 0, 0, 1, 32, "delay2~ x32"},
+  {"multitap~", 2, 1, 1, 1, 0, 1, "multitap~"},
+  {"stereotaps~", 2, 2, 1, 0, 0, 1, "stereotaps~"},
+  {"stereotaps2~", 2, 2, 1, 0, 0, 1, "stereotaps2~"},
+};
+
+// whether an object is run with delay times of kind `mode`
+static int bench_object_has_mode(const t_bench_object *o, int mode)
+{
+  switch (mode) {
+    case BENCH_CONST: return 1;
+    case BENCH_MOD: return o->o_nin > 1;
+    case BENCH_TABLE: return o->o_has_table;
+    default: return o->o_has_time;
+  }
+}
+
+// `taps` taps at pseudo-random times over the whole buffer, with falling gains
+static void bench_send_table(void *x, t_float buffer_ms, int taps)
+{
+  t_atom *argv = (t_atom *)calloc(3 * taps, sizeof(t_atom));
+  unsigned int seed = 4321;
+  int i;
+  for (i = 0; i < taps; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    SETFLOAT(argv + 3 * i, buffer_ms * 0.9f * (t_float)(seed >> 8) / (t_float)(1 << 24));
+    SETFLOAT(argv + 3 * i + 1, 1.0f / (i + 1));
+    SETFLOAT(argv + 3 * i + 2, i == 0 ? 1.0f : 0.0f);
+  }
+  stub_message_list(x, "taps", 3 * taps, argv);
+  free(argv);
+}
+
+// creates `o` and sets up its taps and delay time for a case. the delay time,
+// in msecs, goes in `delay_ms`
+static void *bench_object_new(const t_bench_object *o, t_float buffer_ms, int taps, int mode,
+                              t_float *delay_ms)
+{
+  t_class *c = stub_findclass(o->o_class);
+  void *x;
+
+  if (!c) {
+    fprintf(stderr, "bench: no class %s\n", o->o_class);
+    exit(1);
+  }
+
+  // spread the taps over the buffer
+  *delay_ms = buffer_ms / ((taps > 0 ? taps : 1) + 1);
+
+  // the third argument (maxsize, for the classes that take one) is left at 0.
+  // the fourth is the interpolation, empty unless -i was given
+  x = ((void *(*)(t_floatarg, t_floatarg, t_floatarg, t_symbol *))c->c_new)(
+      buffer_ms, *delay_ms, 0, bench_config.c_interp);
+  if (!x) {
+    fprintf(stderr, "bench: couldn't create %s\n", o->o_class);
+    exit(1);
+  }
+  if (o->o_has_taps) {
+    if (mode == BENCH_TABLE) bench_send_table(x, buffer_ms, taps);
+    else stub_message_float(x, "taps", taps);
+    stub_message_float(x, "wet_dry", 0.5f);
+    stub_message_float(x, "feedback", 0.5f);
+  }
+  if (mode == BENCH_TIME) stub_message_float(x, "time", *delay_ms);
+  return x;
+}
+
+// the signal vectors for `o`, with noise in and the delay time in msecs in
+// the second inlet, where there is one
+static void bench_object_sigs(const t_bench_object *o, t_bench_sigs *sigs, int n,
+                              t_float delay_ms, int mode)
+{
+  bench_sigs_init(sigs, o->o_nin + o->o_nout, n);
+  if (o->o_nchans > 1) {
+    int i;
+    bench_sigs_multi(sigs, 0, o->o_nchans);
+    for (i = o->o_nin; i < o->o_nin + o->o_nout; i++) bench_sigs_multi(sigs, i, o->o_nchans);
+  }
+  bench_fill_noise(sigs->b_sig[0].s_vec, n * o->o_nchans);
+  if (o->o_nin > 1) {
+    if (mode == BENCH_MOD) bench_fill_mod(sigs->b_sig[1].s_vec, n, delay_ms);
+    else bench_fill_const(sigs->b_sig[1].s_vec, n, delay_ms);
+  }
+}
+
+static void bench_object_case(const t_bench_object *o, int n,
+                              t_float buffer_ms, int taps, int mode)
+{
+  t_bench_sigs sigs;
+  t_float delay_ms;
+  void *x;
+  double ns;
+
+  x = bench_object_new(o, buffer_ms, taps, mode, &delay_ms);
+  bench_object_sigs(o, &sigs, n, delay_ms, mode);
+
+  stub_chain_reset();
+  stub_setblksize(n);
+  stub_dsp(x, sigs.b_sp);
+
+  ns = bench_time_chain(n, bench_warmup_blocks(buffer_ms, n)) / o->o_nchans;
+  bench_report(o->o_name, n, buffer_ms, o->o_has_taps ? taps : 0,
+               o->o_nin > 1 ? bench_delay_modes[mode] : "-", ns);
+
+  stub_chain_reset();
+  stub_free(x);
+  bench_sigs_free(&sigs);
+}
+
+static void bench_objects_run(void)
+{
+  int i, b, l, t, m;
+  for (i = 0; i < NELEM(bench_objects); i++) {
+    const t_bench_object *o = &bench_objects[i];
+    if (!bench_wanted(o->o_class)) continue;
+    for (m = 0; m < BENCH_NMODES; m++) {
+      if (!bench_object_has_mode(o, m)) continue;
+      for (l = 0; l < bench_config.c_nbuffers; l++) {
+        for (b = 0; b < bench_config.c_nblocks; b++) {
+          int n = bench_config.c_blocks[b];
+          t_float buffer_ms = bench_config.c_buffers[l];
+          if (!o->o_has_taps) {
+            bench_object_case(o, n, buffer_ms, 0, m);
+            continue;
+          }
+          for (t = 0; t < bench_config.c_ntaps; t++) {
+            bench_object_case(o, n, buffer_ms, bench_config.c_taps[t], m);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* simple_delwrite~ with its readers: simple_delread~ (one for each tap),
+ * simple_delread_bank~ reading all the taps, with an outlet each or summed,
+ * and simple_vd~ with a constant and a modulated delay time */
+
+enum { BENCH_READ, BENCH_BANK, BENCH_BANK_SUM, BENCH_VD };
+static const char *bench_pair_names[] = {
+  "simple_delwrite~+read", "simple_delwrite~+bank", "simple_delwrite~+bank_sum",
+  "simple_delwrite~+vd"
+};
+
+static void bench_pair_case(int reader_type, int n, t_float buffer_ms, int taps, int mode)
+{
+  t_class *wc = stub_findclass("simple_delwrite~");
+  t_symbol *name = gensym("bench_line");
+  t_bench_sigs wsigs, rsigs;
+  void *writer, *readers[BENCH_MAXSIGS];
+  int nreaders = 1, i;
+  double ns;
+
+  writer = ((void *(*)(t_symbol *, t_floatarg, t_floatarg))wc->c_new)(name, buffer_ms, 0);
+  bench_sigs_init(&wsigs, 1, n);
+  bench_fill_noise(wsigs.b_sig[0].s_vec, n);
+
+  if (reader_type == BENCH_VD) {
+    t_class *rc = stub_findclass("simple_vd~");
+    readers[0] = ((void *(*)(t_symbol *, t_symbol *))rc->c_new)(name, &s_);
+    bench_sigs_init(&rsigs, 2, n);
+    if (mode == BENCH_MOD) bench_fill_mod(rsigs.b_sig[0].s_vec, n, buffer_ms * 0.5f);
+    else bench_fill_const(rsigs.b_sig[0].s_vec, n, buffer_ms * 0.5f);
+  } else if (reader_type == BENCH_READ) {
+    t_class *rc = stub_findclass("simple_delread~");
+    nreaders = taps;
+    for (i = 0; i < taps; i++) {
+      readers[i] = ((void *(*)(t_symbol *, t_floatarg))rc->c_new)(
+        name, buffer_ms * (i + 1) / (taps + 1));
+    }
+    bench_sigs_init(&rsigs, taps, n);
+  } else {
+    t_class *rc = stub_findclass("simple_delread_bank~");
+    t_atom argv[BENCH_MAXSIGS + 2];
+    int argc = 0;
+    SETSYMBOL(&argv[argc], name);
+    argc++;
+    if (reader_type == BENCH_BANK_SUM) {
+      SETSYMBOL(&argv[argc], gensym("-sum"));
+      argc++;
+    }
+    for (i = 0; i < taps; i++) {
+      SETFLOAT(&argv[argc], buffer_ms * (i + 1) / (taps + 1));
+      argc++;
+    }
+    readers[0] = ((void *(*)(t_symbol *, int, t_atom *))rc->c_new)(gensym("simple_delread_bank~"),
+                                                                   argc, argv);
+    bench_sigs_init(&rsigs, reader_type == BENCH_BANK_SUM ? 1 : taps, n);
+  }
+
+  stub_chain_reset();
+  stub_setblksize(n);
+  stub_bump_sortno();
+  stub_dsp(writer, wsigs.b_sp);
+  for (i = 0; i < nreaders; i++) stub_dsp(readers[i], rsigs.b_sp + i);
+
+  ns = bench_time_chain(n, bench_warmup_blocks(buffer_ms, n));
+  bench_report(bench_pair_names[reader_type], n, buffer_ms,
+               reader_type == BENCH_VD ? 0 : taps,
+               reader_type == BENCH_VD ? bench_delay_modes[mode] : "-", ns);
+
+  stub_chain_reset();
+  for (i = 0; i < nreaders; i++) stub_free(readers[i]);
+  stub_free(writer);
+  bench_sigs_free(&wsigs);
+  bench_sigs_free(&rsigs);
+}
+
+static void bench_pair_run(void)
+{
+  int b, l, t, m;
+  int run_write = bench_wanted("simple_delwrite~");
+  int run_read = run_write || bench_wanted("simple_delread~");
+  int run_bank = run_write || bench_wanted("simple_delread_bank~");
+  int run_vd = run_write || bench_wanted("simple_vd~");
+  for (l = 0; l < bench_config.c_nbuffers; l++) {
+    for (b = 0; b < bench_config.c_nblocks; b++) {
+      int n = bench_config.c_blocks[b];
+      t_float buffer_ms = bench_config.c_buffers[l];
+      for (t = 0; t < bench_config.c_ntaps; t++) {
+        int taps = bench_config.c_taps[t];
+        if (run_read) bench_pair_case(BENCH_READ, n, buffer_ms, taps, BENCH_CONST);
+        if (run_bank) {
+          bench_pair_case(BENCH_BANK, n, buffer_ms, taps, BENCH_CONST);
+          bench_pair_case(BENCH_BANK_SUM, n, buffer_ms, taps, BENCH_CONST);
+        }
+      }
+      if (run_vd) {
+        for (m = BENCH_CONST; m <= BENCH_MOD; m++) {
+          bench_pair_case(BENCH_VD, n, buffer_ms, 0, m);
+        }
+      }
+    }
+  }
+}
+
+/* self-check */
+
+#define BENCH_CHECK_BLOCKS 400 // a little over half a second at 64
+#define BENCH_CHECK_TOL 1e-5
+
+enum { BENCH_PATH_KERNEL, BENCH_PATH_FFT, BENCH_PATH_THREAD, BENCH_PATH_PASSES };
+static const char *bench_path_names[] = {"kernel", "fft", "thread", "passes"};
+
+typedef struct _bench_check
+{
+  const char *k_class; // the first entry in bench_objects for it
+  int k_path;
+  int k_mode;
+  int k_taps;
+  int k_mix; // send wet_dry and feedback, as the tap objects always get
+} t_bench_check;
+
+static const t_bench_check bench_checks[] = {
+  {"multitap~", BENCH_PATH_KERNEL, BENCH_CONST, 16, 0},
+  {"multitap~", BENCH_PATH_KERNEL, BENCH_MOD, 16, 0},
+  {"multitap~", BENCH_PATH_KERNEL, BENCH_TABLE, 16, 0},
+  {"multitap~", BENCH_PATH_FFT, BENCH_TABLE, 64, 0},
+  {"multitap~", BENCH_PATH_THREAD, BENCH_MOD, 16, 0},
+  {"stereotaps~", BENCH_PATH_KERNEL, BENCH_CONST, 16, 0},
+  {"stereotaps~", BENCH_PATH_KERNEL, BENCH_MOD, 16, 0},
+  {"stereotaps2~", BENCH_PATH_KERNEL, BENCH_CONST, 16, 0},
+  {"stereotaps2~", BENCH_PATH_KERNEL, BENCH_MOD, 16, 0},
+  {"stereotaps2~", BENCH_PATH_THREAD, BENCH_MOD, 16, 0},
+  {"delay~", BENCH_PATH_PASSES, BENCH_CONST, 0, 0},
+  {"delay~", BENCH_PATH_PASSES, BENCH_MOD, 0, 0},
+  {"delay2~", BENCH_PATH_PASSES, BENCH_MOD, 0, 1},
+};
+
+// runs `o` for BENCH_CHECK_BLOCKS blocks of `n` on the fast path `path`, or
+// the direct one if `fast` is 0, and returns what came out of each outlet, one
+// outlet after the other. the tap kernel is the caller's to pick
+static t_sample *bench_check_run(const t_bench_object *o, const t_bench_check *k, int n,
+                                 t_float buffer_ms, int fast)
+{
+  int nsamps = n * o->o_nchans, total = nsamps * BENCH_CHECK_BLOCKS;
+  t_sample *out = (t_sample *)calloc((size_t)total * o->o_nout, sizeof(t_sample));
+  int path = k->k_path;
+  t_delay_thread *t = NULL;
+  t_bench_sigs sigs;
+  t_float delay_ms;
+  void *x;
+  int b, i;
+
+  bench_noise_seed = BENCH_NOISE_SEED;
+  if (path == BENCH_PATH_PASSES) delay_block_passes = fast;
+
+  x = bench_object_new(o, buffer_ms, k->k_taps, k->k_mode, &delay_ms);
+  if (k->k_mix) {
+    // (otherwise delay2~ puts out only its input)
+    stub_message_float(x, "wet_dry", 0.5f);
+    stub_message_float(x, "feedback", 0.5f);
+  }
+  if (path == BENCH_PATH_FFT) stub_message_symbol(x, "fft", fast ? "on" : "off");
+  if (path == BENCH_PATH_THREAD && fast) stub_message_float(x, "thread", 1);
+  bench_object_sigs(o, &sigs, n, delay_ms, k->k_mode);
+
+  stub_chain_reset();
+  stub_setblksize(n);
+  stub_dsp(x, sigs.b_sp);
+
+  // the helper runs each block while the next one is being built, so wait for
+  // it after every tick: the output is then always exactly one block late
+  for (i = 0; i < stub_chain_count(); i++) {
+    t_int *w = stub_chain_get(i)->c_w;
+    if (w[0] == (t_int)delay_thread_perform) t = (t_delay_thread *)w[1];
+  }
+  if (path == BENCH_PATH_THREAD && fast && !t) {
+    fprintf(stderr, "bench: %s didn't start its helper thread\n", o->o_name);
+    exit(1);
+  }
+
+  for (b = 0; b < BENCH_CHECK_BLOCKS; b++) {
+    bench_fill_noise(sigs.b_sig[0].s_vec, nsamps);
+    bench_chain_tick();
+    if (t) delay_thread_sync(t);
+    for (i = 0; i < o->o_nout; i++) {
+      memcpy(out + i * total + b * nsamps, sigs.b_sig[o->o_nin + i].s_vec,
+             nsamps * sizeof(t_sample));
+    }
+  }
+
+  stub_chain_reset();
+  stub_free(x);
+  bench_sigs_free(&sigs);
+  delay_block_passes = 1;
+  return out;
+}
+
+// returns 1 if the fast path matches the direct one
+static int bench_check_case(const t_bench_check *k, const char *fast_kernel)
+{
+  const t_bench_object *o = NULL;
+  const int n = 64;
+  const t_float buffer_ms = 100;
+  t_sample *direct, *fast;
+  double peak = 0, diff = 0;
+  int i, j, total, lag, ok;
+
+  for (i = 0; i < NELEM(bench_objects) && !o; i++) {
+    if (!strcmp(bench_objects[i].o_class, k->k_class)) o = &bench_objects[i];
+  }
+  total = n * o->o_nchans * BENCH_CHECK_BLOCKS;
+  // the helper thread's output comes a block late
+  lag = k->k_path == BENCH_PATH_THREAD ? n * o->o_nchans : 0;
+
+  if (k->k_path == BENCH_PATH_KERNEL) simple_del_kernels_select("scalar");
+  direct = bench_check_run(o, k, n, buffer_ms, 0);
+  if (k->k_path == BENCH_PATH_KERNEL) simple_del_kernels_select(fast_kernel);
+  fast = bench_check_run(o, k, n, buffer_ms, 1);
+
+  for (j = 0; j < o->o_nout; j++) {
+    for (i = 0; i < total - lag; i++) {
+      double d = direct[j * total + i], f = fast[j * total + i + lag];
+      if (fabs(d) > peak) peak = fabs(d);
+      if (fabs(f - d) > diff) diff = fabs(f - d);
+    }
+  }
+  ok = diff <= BENCH_CHECK_TOL * (peak > 1 ? peak : 1);
+
+  printf("%-14s %-7s %-6s %5d %12.3g %s\n", o->o_name, bench_path_names[k->k_path],
+         bench_delay_modes[k->k_mode], k->k_taps, diff, ok ? "ok" : "FAIL");
+  free(direct);
+  free(fast);
+  return ok;
+}
+
+// returns the number of cases that failed
+static int bench_check_all(void)
+{
+  const char *fast_kernel = simple_del_kernels_name();
+  int i, failed = 0;
+
+  printf("%-14s %-7s %-6s %5s %12s\n", "class", "path", "delay", "taps", "max diff");
+  for (i = 0; i < NELEM(bench_checks); i++) {
+    if (bench_wanted(bench_checks[i].k_class)) failed += !bench_check_case(&bench_checks[i], fast_kernel);
+  }
+  return failed;
+}
+
+int main(int argc, char **argv)
+{
+  const char *kernel = NULL;
+  int i, check = 0;
+
+  bench_config.c_blocks = bench_blocks;
+  bench_config.c_nblocks = NELEM(bench_blocks);
+  bench_config.c_buffers = bench_buffers;
+  bench_config.c_nbuffers = NELEM(bench_buffers);
+  bench_config.c_taps = bench_taps;
+  bench_config.c_ntaps = NELEM(bench_taps);
+  bench_config.c_min_ns = 20e6;
+  bench_config.c_interp = &s_;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c")) {
+      check = 1;
+    } else if (!strcmp(argv[i], "-q")) {
+      bench_config.c_blocks = bench_blocks_quick;
+      bench_config.c_nblocks = NELEM(bench_blocks_quick);
+      bench_config.c_buffers = bench_buffers_quick;
+      bench_config.c_nbuffers = NELEM(bench_buffers_quick);
+      bench_config.c_taps = bench_taps_quick;
+      bench_config.c_ntaps = NELEM(bench_taps_quick);
+    } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      bench_config.c_min_ns = atof(argv[++i]) * 1e6;
+    } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+      kernel = argv[++i];
+    } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+      bench_config.c_interp = gensym(argv[++i]);
+      if (delay_interp_find(bench_config.c_interp) < 0) {
+        fprintf(stderr, "bench: no interpolation called %s\n", argv[i]);
+        return 1;
+      }
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [-c] [-q] [-t msecs] [-k kernel] [-i interp] [class ...]\n",
+              argv[0]);
+      return 1;
+    } else {
+      break;
+    }
+  }
+  bench_config.c_filter = argv + i;
+  bench_config.c_nfilter = argc - i;
+
+  stub_setsr(BENCH_SR);
+
+  simple_delwrite_tilde_setup();
+  simple_delread_tilde_setup();
+  simple_delread_bank_tilde_setup();
+  simple_vd_tilde_setup();
+  delay_tilde_setup();
+  delay1_tilde_setup();
+  delay1_cubic_tilde_setup();
+  delay2_tilde_setup();
+  multitap_tilde_setup();
+  stereotaps_tilde_setup();
+  stereotaps2_tilde_setup();
+
+  if (kernel && !simple_del_kernels_select(kernel)) {
+    fprintf(stderr, "bench: kernel %s isn't available\n", kernel);
+    return 1;
+  }
+
+  printf("# t_sample: %d bit, sr: %d, tap kernel: %s, interp: %s\n",
+         (int)(8 * sizeof(t_sample)), BENCH_SR, simple_del_kernels_name(),
+         *bench_config.c_interp->s_name ? bench_config.c_interp->s_name : "cubic");
+  if (check) return bench_check_all() ? 1 : 0;
+
+  printf("%-26s %6s %8s %5s %6s %11s %14s %12s\n",
+         "class", "block", "buf_ms", "taps", "delay", "ns/sample", "samples/s", "inst/sample");
+
+  bench_objects_run();
+  bench_pair_run();
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+/* A stand-in for Pure Data's m_pd.h, just big enough to compile the objects in
+ * `src/` without Pd. Used by the benchmark harness in this directory: the
+ * functions declared here are implemented in `pd_stub.c`, and instead of
+ * talking to a running Pd they record what the objects ask for (classes,
+ * methods, dsp_add calls) so that `bench.c` can call the perform routines
+ * directly.
+ *
+ * Only the parts of the real header that the objects use are here. The names
+ * and signatures match the real ones, so anything that compiles against this
+ * should compile against Pd.
+ * */
+
+#ifndef __m_pd_h_
+#define __m_pd_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PD_MAJOR_VERSION 0
+#define PD_MINOR_VERSION 54
+#define PD_BUGFIX_VERSION 0
+
+#ifndef PD_FLOATSIZE
+#define PD_FLOATSIZE 32
+#endif
+
+#if PD_FLOATSIZE == 32
+#define PD_FLOATTYPE float
+#define PD_FLOATUINTTYPE uint32_t
+#elif PD_FLOATSIZE == 64
+#define PD_FLOATTYPE double
+#define PD_FLOATUINTTYPE uint64_t
+#else
+#error invalid PD_FLOATSIZE: must be 32 or 64
+#endif
+
+#define EXTERN extern
+
+typedef intptr_t t_int;
+typedef PD_FLOATTYPE t_float;
+typedef PD_FLOATTYPE t_floatarg;
+typedef PD_FLOATTYPE t_sample;
+
+typedef struct _symbol
+{
+  const char *s_name;
+  struct _class **s_thing;
+  struct _symbol *s_next;
+} t_symbol;
+
+typedef struct _class t_class;
+typedef t_class *t_pd;
+
+typedef struct _gobj
+{
+  t_pd g_pd;
+  struct _gobj *g_next;
+} t_gobj;
+
+typedef struct _text
+{
+  t_gobj te_g;
+} t_text;
+
+#define ob_pd te_g.g_pd
+typedef struct _text t_object;
+
+typedef struct _outlet t_outlet;
+
+struct _glist;
+#define t_glist struct _glist
+#define t_canvas struct _glist
+typedef struct _inlet t_inlet;
+
+typedef enum
+{
+  A_NULL,
+  A_FLOAT,
+  A_SYMBOL,
+  A_POINTER,
+  A_SEMI,
+  A_COMMA,
+  A_DEFFLOAT,
+  A_DEFSYM,
+  A_DOLLAR,
+  A_DOLLSYM,
+  A_GIMME,
+  A_CANT
+} t_atomtype;
+
+typedef union word
+{
+  t_float w_float;
+  t_symbol *w_symbol;
+  int w_index;
+} t_word;
+
+typedef struct _atom
+{
+  t_atomtype a_type;
+  union word a_w;
+} t_atom;
+
+#define SETFLOAT(atom, f) ((atom)->a_type = A_FLOAT, (atom)->a_w.w_float = (f))
+#define SETSYMBOL(atom, s) ((atom)->a_type = A_SYMBOL, (atom)->a_w.w_symbol = (s))
+
+typedef void (*t_method)(void);
+typedef void *(*t_newmethod)(void);
+
+#define CLASS_PD 0
+#define CLASS_DEFAULT 1
+#define CLASS_MULTICHANNEL 0x400
+
+EXTERN t_symbol s_signal;
+EXTERN t_symbol s_float;
+EXTERN t_symbol s_list;
+EXTERN t_symbol s_;
+
+EXTERN t_symbol *gensym(const char *s);
+
+EXTERN void *getbytes(size_t nbytes);
+EXTERN void *resizebytes(void *x, size_t oldsize, size_t newsize);
+EXTERN void freebytes(void *x, size_t nbytes);
+
+EXTERN void post(const char *fmt, ...);
+EXTERN void pd_error(const void *object, const char *fmt, ...);
+
+EXTERN t_class *class_new(t_symbol *name, t_newmethod newmethod,
+                          t_method freemethod, size_t size, int flags,
+                          t_atomtype arg1, ...);
+EXTERN void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+                            t_atomtype arg1, ...);
+EXTERN void class_addfloat(t_class *c, t_method fn);
+EXTERN void class_addlist(t_class *c, t_method fn);
+EXTERN void class_sethelpsymbol(t_class *c, t_symbol *s);
+EXTERN void class_domainsignalin(t_class *c, int onset);
+EXTERN const char *class_getname(const t_class *c);
+#ifndef PD_CLASS_DEF
+#define class_addfloat(x, y) class_addfloat((x), (t_method)(y))
+#define class_addlist(x, y) class_addlist((x), (t_method)(y))
+#endif
+#define CLASS_MAINSIGNALIN(c, type, field) \
+  class_domainsignalin(c, (char *)(&((type *)0)->field) - (char *)0)
+
+EXTERN t_pd *pd_new(t_class *cls);
+EXTERN void pd_free(t_pd *x);
+EXTERN void pd_float(t_pd *x, t_float f);
+EXTERN void pd_bind(t_pd *x, t_symbol *s);
+EXTERN void pd_unbind(t_pd *x, t_symbol *s);
+EXTERN t_pd *pd_findbyclass(t_symbol *s, const t_class *c);
+
+EXTERN t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2);
+EXTERN t_outlet *outlet_new(t_object *owner, t_symbol *s);
+EXTERN void outlet_free(t_outlet *x);
+EXTERN void outlet_float(t_outlet *x, t_float f);
+EXTERN void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+EXTERN void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+
+EXTERN t_float atom_getfloat(const t_atom *a);
+EXTERN t_float atom_getfloatarg(int which, int argc, const t_atom *argv);
+EXTERN t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv);
+
+/* signals */
+typedef struct _signal
+{
+  int s_n; /* allocated size of the vector: s_length * s_nchans */
+  t_sample *s_vec;
+  t_float s_sr;
+  int s_length; /* number of items per channel */
+  int s_nchans;
+  int s_overlap;
+} t_signal;
+
+typedef t_int *(*t_perfroutine)(t_int *args);
+
+EXTERN void dsp_add(t_perfroutine f, int n, ...);
+EXTERN void dsp_add_zero(t_sample *vec, int n);
+EXTERN void signal_setmultiout(t_signal **sig, int nchans);
+EXTERN t_float sys_getsr(void);
+EXTERN int sys_getblksize(void);
+EXTERN t_glist *canvas_getcurrent(void);
+
+/* real FFTs, in place. n is a power of two. The spectrum is packed with the
+ * real parts in real[0 .. n/2] and the imaginary part of bin k in real[n - k].
+ * mayer_realifft undoes mayer_realfft, times n.
+ */
+EXTERN void mayer_realfft(int n, t_sample *real);
+EXTERN void mayer_realifft(int n, t_sample *real);
+
+/* is a floating-point number nan, inf, or very large or small? */
+#if PD_FLOATSIZE == 32
+typedef union
+{
+  t_float f;
+  unsigned int ui;
+} t_bigorsmall32;
+
+static inline int PD_BIGORSMALL(t_float f)
+{
+  t_bigorsmall32 pun;
+  pun.f = f;
+  return ((pun.ui & 0x20000000) == ((pun.ui >> 1) & 0x20000000));
+}
+#else
+typedef union
+{
+  t_float f;
+  unsigned int ui[2];
+} t_bigorsmall64;
+
+static inline int PD_BIGORSMALL(t_float f)
+{
+  t_bigorsmall64 pun;
+  pun.f = f;
+  return ((pun.ui[1] & 0x20000000) == ((pun.ui[1] >> 1) & 0x20000000));
+}
+#endif
+
+#endif /* __m_pd_h_ */
@@ -0,0 +1,609 @@
+/* Just enough of Pd for the objects in `src/` to be created and have their
+ * perform routines called. See `m_pd.h` in this directory.
+ * */
+
+#define PD_CLASS_DEF
+#include "pd_stub.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+t_symbol s_signal = {"signal", 0, 0};
+t_symbol s_float = {"float", 0, 0};
+t_symbol s_list = {"list", 0, 0};
+t_symbol s_ = {"", 0, 0};
+
+static t_symbol *stub_symlist = NULL;
+static t_class *stub_classlist = NULL;
+static t_stub_chain stub_chain[STUB_MAXCHAIN];
+static int stub_nchain = 0;
+static int stub_verbose = 0;
+static int stub_sortno = 1;
+static t_float stub_sr = 48000;
+static int stub_blksize = 64;
+
+#define STUB_MAXOUT 256
+static t_atom stub_outbuf[STUB_MAXOUT];
+static int stub_noutbuf = 0;
+
+struct _outlet
+{
+  t_object *o_owner;
+};
+
+struct _inlet
+{
+  t_object *i_owner;
+};
+
+// a symbol's binding, for pd_bind / pd_findbyclass
+typedef struct _stub_binding
+{
+  t_symbol *b_sym;
+  t_pd *b_obj;
+  struct _stub_binding *b_next;
+} t_stub_binding;
+
+static t_stub_binding *stub_bindings = NULL;
+
+t_symbol *gensym(const char *s)
+{
+  t_symbol *sym;
+  for (sym = stub_symlist; sym; sym = sym->s_next) {
+    if (!strcmp(sym->s_name, s)) return sym;
+  }
+  sym = (t_symbol *)calloc(1, sizeof(t_symbol));
+  sym->s_name = strdup(s);
+  sym->s_next = stub_symlist;
+  stub_symlist = sym;
+  return sym;
+}
+
+void *getbytes(size_t nbytes)
+{
+  if (nbytes < 1) nbytes = 1;
+  return calloc(nbytes, 1);
+}
+
+// like Pd's: the new part of the block is zeroed
+void *resizebytes(void *x, size_t oldsize, size_t newsize)
+{
+  void *y;
+  if (newsize < 1) newsize = 1;
+  y = realloc(x, newsize);
+  if (y && newsize > oldsize) {
+    memset((char *)y + oldsize, 0, newsize - oldsize);
+  }
+  return y;
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+  (void)nbytes;
+  free(x);
+}
+
+void post(const char *fmt, ...)
+{
+  va_list ap;
+  if (!stub_verbose) return;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+// errors are always shown: a bench run that triggers one is measuring the
+// wrong thing
+void pd_error(const void *object, const char *fmt, ...)
+{
+  va_list ap;
+  (void)object;
+  va_start(ap, fmt);
+  fputs("error: ", stderr);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod,
+                   t_method freemethod, size_t size, int flags,
+                   t_atomtype arg1, ...)
+{
+  t_class *c = (t_class *)calloc(1, sizeof(t_class));
+  (void)flags;
+  (void)arg1;
+  c->c_name = name;
+  c->c_new = newmethod;
+  c->c_free = freemethod;
+  c->c_size = size;
+  c->c_next = stub_classlist;
+  stub_classlist = c;
+  return c;
+}
+
+const char *class_getname(const t_class *c)
+{
+  return c->c_name->s_name;
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+                     t_atomtype arg1, ...)
+{
+  if (c->c_nmethods >= STUB_MAXMETHODS) {
+    fprintf(stderr, "stub: too many methods for %s\n", c->c_name->s_name);
+    exit(1);
+  }
+  c->c_methods[c->c_nmethods].m_sel = sel;
+  c->c_methods[c->c_nmethods].m_fn = fn;
+  c->c_methods[c->c_nmethods].m_arg1 = arg1;
+  c->c_nmethods++;
+}
+
+void class_addfloat(t_class *c, t_method fn)
+{
+  c->c_float = fn;
+}
+
+void class_addlist(t_class *c, t_method fn)
+{
+  c->c_list = fn;
+}
+
+void class_sethelpsymbol(t_class *c, t_symbol *s)
+{
+  (void)c;
+  (void)s;
+}
+
+void class_domainsignalin(t_class *c, int onset)
+{
+  (void)c;
+  (void)onset;
+}
+
+t_pd *pd_new(t_class *cls)
+{
+  t_pd *x = (t_pd *)getbytes(cls->c_size);
+  *x = cls;
+  return x;
+}
+
+void pd_float(t_pd *x, t_float f)
+{
+  (void)x;
+  (void)f;
+}
+
+// as in Pd, s_thing is the first thing bound (Pd would make a bindlist of a
+// second one, the stub just leaves the first there)
+void pd_bind(t_pd *x, t_symbol *s)
+{
+  t_stub_binding *b = (t_stub_binding *)calloc(1, sizeof(t_stub_binding));
+  if (!s->s_thing) s->s_thing = x;
+  b->b_sym = s;
+  b->b_obj = x;
+  b->b_next = stub_bindings;
+  stub_bindings = b;
+}
+
+void pd_unbind(t_pd *x, t_symbol *s)
+{
+  t_stub_binding **bp;
+  if (s->s_thing == x) s->s_thing = NULL;
+  for (bp = &stub_bindings; *bp; bp = &(*bp)->b_next) {
+    if ((*bp)->b_sym == s && (*bp)->b_obj == x) {
+      t_stub_binding *b = *bp;
+      *bp = b->b_next;
+      free(b);
+      return;
+    }
+  }
+}
+
+t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
+{
+  t_stub_binding *b;
+  for (b = stub_bindings; b; b = b->b_next) {
+    if (b->b_sym == s && *b->b_obj == c) return b->b_obj;
+  }
+  return NULL;
+}
+
+t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2)
+{
+  t_inlet *i = (t_inlet *)calloc(1, sizeof(t_inlet));
+  (void)dest;
+  (void)s1;
+  (void)s2;
+  i->i_owner = owner;
+  return i;
+}
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+  t_outlet *o = (t_outlet *)calloc(1, sizeof(t_outlet));
+  (void)s;
+  o->o_owner = owner;
+  return o;
+}
+
+void outlet_free(t_outlet *x)
+{
+  free(x);
+}
+
+static void stub_outlet_store(int argc, t_atom *argv)
+{
+  if (argc > STUB_MAXOUT) argc = STUB_MAXOUT;
+  memcpy(stub_outbuf, argv, argc * sizeof(t_atom));
+  stub_noutbuf = argc;
+}
+
+void outlet_float(t_outlet *x, t_float f)
+{
+  t_atom a;
+  (void)x;
+  SETFLOAT(&a, f);
+  stub_outlet_store(1, &a);
+}
+
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+  (void)x;
+  (void)s;
+  stub_outlet_store(argc, argv);
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+  (void)x;
+  if (stub_verbose) {
+    int i;
+    fprintf(stderr, "%s", s->s_name);
+    for (i = 0; i < argc; i++) {
+      if (argv[i].a_type == A_FLOAT) fprintf(stderr, " %g", (double)argv[i].a_w.w_float);
+      else if (argv[i].a_type == A_SYMBOL) fprintf(stderr, " %s", argv[i].a_w.w_symbol->s_name);
+    }
+    fputc('\n', stderr);
+  }
+  stub_outlet_store(argc, argv);
+}
+
+t_float atom_getfloat(const t_atom *a)
+{
+  return (a->a_type == A_FLOAT) ? a->a_w.w_float : 0;
+}
+
+t_float atom_getfloatarg(int which, int argc, const t_atom *argv)
+{
+  if (which < 0 || which >= argc) return 0;
+  return atom_getfloat(argv + which);
+}
+
+t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv)
+{
+  if (which < 0 || which >= argc || argv[which].a_type != A_SYMBOL) return &s_;
+  return argv[which].a_w.w_symbol;
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+  va_list ap;
+  int i;
+  t_int *w;
+  if (stub_nchain >= STUB_MAXCHAIN) {
+    fprintf(stderr, "stub: DSP chain full\n");
+    exit(1);
+  }
+  w = (t_int *)calloc(n + 1, sizeof(t_int));
+  w[0] = (t_int)f;
+  va_start(ap, n);
+  for (i = 0; i < n; i++) w[i + 1] = va_arg(ap, t_int);
+  va_end(ap);
+  stub_chain[stub_nchain].c_w = w;
+  stub_chain[stub_nchain].c_n = n;
+  stub_nchain++;
+}
+
+static t_int *stub_zero_perform(t_int *w)
+{
+  memset((t_sample *)w[1], 0, (int)w[2] * sizeof(t_sample));
+  return (w+3);
+}
+
+void dsp_add_zero(t_sample *vec, int n)
+{
+  dsp_add(stub_zero_perform, 2, vec, (t_int)n);
+}
+
+void signal_setmultiout(t_signal **sig, int nchans)
+{
+  (*sig)->s_nchans = nchans;
+  (*sig)->s_n = (*sig)->s_length * nchans;
+}
+
+t_float sys_getsr(void)
+{
+  return stub_sr;
+}
+
+int sys_getblksize(void)
+{
+  return stub_blksize;
+}
+
+int ugen_getsortno(void)
+{
+  return stub_sortno;
+}
+
+// the bench builds its DSP chains by hand, so there's nothing to rebuild
+void canvas_update_dsp(void)
+{
+}
+
+// objects are made "in" whatever stub_setcanvas was last given, NULL to start
+// with, which is a subpatch of whatever stub_setroot was last given (or its
+// own root, if that's NULL)
+static t_glist *stub_canvas = NULL;
+static t_glist *stub_root = NULL;
+
+t_glist *canvas_getrootfor(t_glist *x)
+{
+  return stub_root ? stub_root : x;
+}
+
+void stub_setroot(t_glist *root)
+{
+  stub_root = root;
+}
+
+t_glist *canvas_getcurrent(void)
+{
+  return stub_canvas;
+}
+
+void stub_setcanvas(t_glist *canvas)
+{
+  stub_canvas = canvas;
+}
+
+/* The FFTs: a complex FFT of n/2 points on the even and odd samples, split
+ * into the n point real spectrum afterwards. Not as fast as the one in Pd,
+ * but the same layout and scaling (see m_pd.h).
+ */
+static int stub_fft_n = 0;
+static double *stub_fft_cos = NULL; // e^(-2 pi i k / n), k < n/2
+static double *stub_fft_sin = NULL;
+static double *stub_fft_re = NULL;
+static double *stub_fft_im = NULL;
+
+static void stub_fft_prepare(int n)
+{
+  int i;
+  if (n == stub_fft_n) return;
+  free(stub_fft_cos);
+  free(stub_fft_sin);
+  free(stub_fft_re);
+  free(stub_fft_im);
+  stub_fft_cos = (double *)malloc((n / 2) * sizeof(double));
+  stub_fft_sin = (double *)malloc((n / 2) * sizeof(double));
+  stub_fft_re = (double *)malloc((n / 2 + 1) * sizeof(double));
+  stub_fft_im = (double *)malloc((n / 2 + 1) * sizeof(double));
+  for (i = 0; i < n / 2; i++) {
+    stub_fft_cos[i] = cos(2 * M_PI * i / n);
+    stub_fft_sin[i] = -sin(2 * M_PI * i / n);
+  }
+  stub_fft_n = n;
+}
+
+// in-place complex FFT of m points (m = stub_fft_n / 2). sign -1 is the
+// inverse, unscaled
+static void stub_fft_complex(double *re, double *im, int m, int sign)
+{
+  int i, j, len;
+  for (i = 1, j = 0; i < m; i++) {
+    int bit = m >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (len = 2; len <= m; len <<= 1) {
+    // twiddles for m points are every other one of those for 2m
+    int step = 2 * m / len;
+    for (i = 0; i < m; i += len) {
+      for (j = 0; j < len / 2; j++) {
+        double wr = stub_fft_cos[j * step], wi = sign * stub_fft_sin[j * step];
+        int a = i + j, b = i + j + len / 2;
+        double tr = re[b] * wr - im[b] * wi;
+        double ti = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
+
+void mayer_realfft(int n, t_sample *real)
+{
+  int m = n / 2, k;
+  double *re, *im;
+  stub_fft_prepare(n);
+  re = stub_fft_re;
+  im = stub_fft_im;
+  for (k = 0; k < m; k++) {
+    re[k] = real[2 * k];
+    im[k] = real[2 * k + 1];
+  }
+  stub_fft_complex(re, im, m, 1);
+  re[m] = re[0];
+  im[m] = im[0];
+  for (k = 0; k <= m; k++) {
+    // the spectra of the even and the odd samples, then the butterfly
+    double er = 0.5 * (re[k] + re[m - k]), ei = 0.5 * (im[k] - im[m - k]);
+    double odr = 0.5 * (im[k] + im[m - k]), odi = -0.5 * (re[k] - re[m - k]);
+    double wr = (k < m) ? stub_fft_cos[k] : -1, wi = (k < m) ? stub_fft_sin[k] : 0;
+    real[k] = (t_sample)(er + wr * odr - wi * odi);
+    if (k > 0 && k < m) real[n - k] = (t_sample)(ei + wr * odi + wi * odr);
+  }
+}
+
+void mayer_realifft(int n, t_sample *real)
+{
+  int m = n / 2, k;
+  double *re, *im;
+  stub_fft_prepare(n);
+  re = stub_fft_re;
+  im = stub_fft_im;
+  for (k = 0; k < m; k++) {
+    double xr = real[k], xi = (k > 0) ? real[n - k] : 0;
+    double yr = real[m - k], yi = (k > 0) ? -real[n - (m - k)] : 0;
+    if (k == 0) yr = real[m];
+    // yr, yi: the conjugate of bin m - k
+    double er = xr + yr, ei = xi + yi;
+    double dr = xr - yr, di = xi - yi;
+    // times the conjugate twiddle
+    double wr = stub_fft_cos[k], wi = -stub_fft_sin[k];
+    double odr = dr * wr - di * wi, odi = dr * wi + di * wr;
+    re[k] = er - odi;
+    im[k] = ei + odr;
+  }
+  stub_fft_complex(re, im, m, -1);
+  for (k = 0; k < m; k++) {
+    real[2 * k] = (t_sample)re[k];
+    real[2 * k + 1] = (t_sample)im[k];
+  }
+}
+
+/* bench-side interface */
+
+t_class *stub_findclass(const char *name)
+{
+  t_class *c;
+  for (c = stub_classlist; c; c = c->c_next) {
+    if (!strcmp(c->c_name->s_name, name)) return c;
+  }
+  return NULL;
+}
+
+t_method stub_findmethod(t_class *c, const char *sel)
+{
+  int i;
+  t_symbol *s = gensym(sel);
+  for (i = 0; i < c->c_nmethods; i++) {
+    if (c->c_methods[i].m_sel == s) return c->c_methods[i].m_fn;
+  }
+  return NULL;
+}
+
+static t_class *stub_classof(void *x)
+{
+  return *(t_pd *)x;
+}
+
+static t_stub_method *stub_findentry(t_class *c, const char *sel)
+{
+  int i;
+  t_symbol *s = gensym(sel);
+  for (i = 0; i < c->c_nmethods; i++) {
+    if (c->c_methods[i].m_sel == s) return &c->c_methods[i];
+  }
+  fprintf(stderr, "stub: %s: no method for '%s'\n", c->c_name->s_name, sel);
+  exit(1);
+}
+
+// works for methods declared with A_FLOAT and with A_GIMME
+void stub_message_float(void *x, const char *sel, t_float f)
+{
+  t_stub_method *m = stub_findentry(stub_classof(x), sel);
+  if (m->m_arg1 == A_GIMME) {
+    t_atom a;
+    SETFLOAT(&a, f);
+    ((void (*)(void *, t_symbol *, int, t_atom *))m->m_fn)(x, m->m_sel, 1, &a);
+  } else {
+    ((void (*)(void *, t_floatarg))m->m_fn)(x, f);
+  }
+}
+
+// for methods declared with A_SYMBOL
+void stub_message_symbol(void *x, const char *sel, const char *s)
+{
+  t_stub_method *m = stub_findentry(stub_classof(x), sel);
+  ((void (*)(void *, t_symbol *))m->m_fn)(x, gensym(s));
+}
+
+void stub_message_list(void *x, const char *sel, int argc, t_atom *argv)
+{
+  t_stub_method *m = stub_findentry(stub_classof(x), sel);
+  ((void (*)(void *, t_symbol *, int, t_atom *))m->m_fn)(x, m->m_sel, argc, argv);
+}
+
+void stub_dsp(void *x, t_signal **sp)
+{
+  t_class *c = stub_classof(x);
+  t_method fn = stub_findmethod(c, "dsp");
+  ((void (*)(void *, t_signal **))fn)(x, sp);
+}
+
+void pd_free(t_pd *x)
+{
+  t_class *c = stub_classof(x);
+  if (c->c_free) ((void (*)(void *))c->c_free)(x);
+  free(x);
+}
+
+void stub_free(void *x)
+{
+  pd_free((t_pd *)x);
+}
+
+void stub_chain_reset(void)
+{
+  int i;
+  for (i = 0; i < stub_nchain; i++) free(stub_chain[i].c_w);
+  stub_nchain = 0;
+}
+
+int stub_chain_count(void)
+{
+  return stub_nchain;
+}
+
+t_stub_chain *stub_chain_get(int i)
+{
+  return &stub_chain[i];
+}
+
+void stub_setverbose(int verbose)
+{
+  stub_verbose = verbose;
+}
+
+void stub_setsr(t_float sr)
+{
+  stub_sr = sr;
+}
+
+void stub_setblksize(int n)
+{
+  stub_blksize = n;
+}
+
+void stub_bump_sortno(void)
+{
+  stub_sortno++;
+}
+
+int stub_last_outlet(t_atom **argv)
+{
+  *argv = stub_outbuf;
+  return stub_noutbuf;
+}
@@ -0,0 +1,68 @@
+/* The bench-side view of the stub Pd in `pd_stub.c`: lets `bench.c` find the
+ * classes that the setup functions registered, create objects, send them
+ * messages and collect whatever they passed to dsp_add.
+ * */
+
+#ifndef PD_STUB_H
+#define PD_STUB_H
+
+#include "m_pd.h"
+
+#define STUB_MAXMETHODS 32
+#define STUB_MAXCHAIN 64
+
+typedef struct _stub_method
+{
+  t_symbol *m_sel;
+  t_method m_fn;
+  t_atomtype m_arg1;
+} t_stub_method;
+
+struct _class
+{
+  t_symbol *c_name;
+  t_newmethod c_new;
+  t_method c_free;
+  size_t c_size;
+  t_method c_float;
+  t_method c_list;
+  t_stub_method c_methods[STUB_MAXMETHODS];
+  int c_nmethods;
+  struct _class *c_next;
+};
+
+// one entry per dsp_add call. c_w[0] is the perform routine, the way Pd lays
+// out its DSP chain, so the entry can be run with `c_w[0](c_w)`
+typedef struct _stub_chain
+{
+  t_int *c_w;
+  int c_n;
+} t_stub_chain;
+
+t_class *stub_findclass(const char *name);
+t_method stub_findmethod(t_class *c, const char *sel);
+void stub_message_float(void *x, const char *sel, t_float f);
+void stub_message_symbol(void *x, const char *sel, const char *s);
+void stub_message_list(void *x, const char *sel, int argc, t_atom *argv);
+void stub_dsp(void *x, t_signal **sp);
+void stub_free(void *x);
+
+// DSP chain built up by dsp_add since the last stub_chain_reset
+void stub_chain_reset(void);
+int stub_chain_count(void);
+t_stub_chain *stub_chain_get(int i);
+
+void stub_setverbose(int verbose);
+// the canvas canvas_getcurrent returns, for objects made from now on
+void stub_setcanvas(t_glist *canvas);
+// the toplevel canvas canvas_getrootfor returns, NULL for every canvas being
+// its own
+void stub_setroot(t_glist *root);
+void stub_setsr(t_float sr);
+void stub_setblksize(int n);
+void stub_bump_sortno(void);
+
+// the last thing an object sent to any of its outlets, as a list of floats
+int stub_last_outlet(t_atom **argv);
+
+#endif
@@ -13,6 +13,10 @@ typedef struct _delay1_cubic {
   int x_pd_block_size;
   int x_phase; // current __write__ position
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
 } t_delay1_cubic;
 
 t_class *delay1_cubic_class = NULL;
@@ -33,13 +37,17 @@ static void *delay_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_phase = 0;
   x->x_delay_samples = 0;
   
-  x->x_delay_buffer = getbytes(XTRASAMPS * sizeof(t_sample));
+  x->x_delay_buffer = delay_mem_alloc(XTRASAMPS * sizeof(t_sample));
 
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
 
   outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
@@ -56,9 +64,9 @@ static void delay_buffer_update(t_delay1_cubic *x)
   nsamps += x->x_pd_block_size;
 
   if (x->x_delay_buffer_samples < nsamps) {
-    x->x_delay_buffer = (t_sample *)resizebytes(x->x_delay_buffer,
-                                                x->x_delay_buffer_samples + XTRASAMPS * sizeof(t_sample),
-                                                (nsamps + XTRASAMPS) * sizeof(t_sample));
+    x->x_delay_buffer = (t_sample *)delay_mem_resize(x->x_delay_buffer,
+                                                     (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample),
+                                                     (nsamps + XTRASAMPS) * sizeof(t_sample));
     x->x_delay_buffer_samples = nsamps;
     x->x_phase = XTRASAMPS;
   }
@@ -67,7 +75,7 @@ static void delay_buffer_update(t_delay1_cubic *x)
 static void delay_set_system_params(t_delay1_cubic *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_delay1_cubic *x, t_float f)
@@ -89,7 +97,7 @@ static t_int *delay1_cubic_perform(t_int *w)
   int delay_buffer_samps = x->x_delay_buffer_samples;
   int delay_samples_int = (int)x->x_delay_samples;
 
-  float delay_frac = x->x_delay_samples - delay_samples_int;
+  t_sample delay_frac = x->x_delay_samples - delay_samples_int;
   int write_phase = x->x_phase;
   write_phase += n; // increment write position by block size for new loop
 
@@ -97,23 +105,21 @@ static t_int *delay1_cubic_perform(t_int *w)
   if (read_phase < 0) read_phase += delay_buffer_samps; 
 
   t_sample *vp = x->x_delay_buffer;
-  t_sample *wp = vp + write_phase;
-  t_sample *ep = vp + (x->x_delay_buffer_samples + XTRASAMPS);
 
-  while (n--) {
-    t_sample f = *in1++;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
-    *wp++ = f;
-    if (wp == ep) {
-      vp[0] = ep[-4];
-      vp[1] = ep[-3];
-      vp[2] = ep[-2];
-      vp[3] = ep[-1];
-      wp = vp + XTRASAMPS;
-      write_phase -= delay_buffer_samps;
-    }
+  // the whole block is written before anything is read: each sample's read
+  // position is at or behind where the per-sample loop would have written by
+  // then. the buffer only holds copies of the input, so there's no need for
+  // denormals_off(): the copy sanitizes it. x_phase stays a block behind the
+  // position the next block is written at
+  x->x_phase = delay_write_guarded(vp, delay_buffer_samps, write_phase, in1, n) - n;
 
-    if (read_phase < XTRASAMPS) read_phase += delay_samples_int;
+  while (n--) {
+    // too close to the start for all four points: read the same position one
+    // lap on, where the guard samples at the end of the buffer make up the
+    // points before it. (this used to add the delay, which read a point ahead
+    // of the one wanted, and with the block written first, one that could
+    // belong to this block's input)
+    if (read_phase < XTRASAMPS) read_phase += delay_buffer_samps;
     t_sample a = vp[read_phase];
     t_sample b = vp[read_phase - 1];
     t_sample c = vp[read_phase - 2];
@@ -121,7 +127,7 @@ static t_int *delay1_cubic_perform(t_int *w)
     t_sample cminusb = c-b;
 
     *out++ = b + delay_frac * (
-        cminusb - 0.1666667f * (1.-delay_frac) * (
+        cminusb - CUBIC_SIXTH * (1.0f - delay_frac) * (
             (d - a - 3.0f * cminusb) * delay_frac + (d + 2.0f*a - 3.0f*b)
         )
     );
@@ -132,13 +138,14 @@ static t_int *delay1_cubic_perform(t_int *w)
     }
   }
 
-  x->x_phase = write_phase;
   return (w+5);
 }
 
 static void delay1_cubic_dsp(t_delay1_cubic *x, t_signal **sp)
 {
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
   dsp_add(delay1_cubic_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  DELAY_STATS_DSP_END(&x->x_stats);
   delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
@@ -147,12 +154,32 @@ static void delay1_cubic_dsp(t_delay1_cubic *x, t_signal **sp)
 static void delay_free(t_delay1_cubic *x)
 {
   if (x->x_delay_buffer != NULL) {
-    freebytes(x->x_delay_buffer,
-              (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample));
+    delay_mem_free(x->x_delay_buffer,
+                   (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample));
     x->x_delay_buffer = NULL;
   }
 }
 
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_delay1_cubic *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// posts how much buffer there is, and what sort of memory holds it
+static void delay_bufinfo(t_delay1_cubic *x)
+{
+  delay_mem_post("delay1_cubic~", x->x_delay_buffer,
+                 (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample), NULL);
+}
+
+// `prefault`: fault in (1) or also lock (2) every delay buffer's memory
+static void delay_prefault(t_delay1_cubic *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
+}
+
 void delay1_cubic_tilde_setup(void)
 {
   delay1_cubic_class = class_new(gensym("delay1_cubic~"),
@@ -164,6 +191,11 @@ void delay1_cubic_tilde_setup(void)
 
   class_addmethod(delay1_cubic_class, (t_method)delay1_cubic_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(delay1_cubic_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
+  class_addmethod(delay1_cubic_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(delay1_cubic_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
 
   CLASS_MAINSIGNALIN(delay1_cubic_class, t_delay1_cubic, x_delay_buffer_msecs);
 }
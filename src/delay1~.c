@@ -23,6 +23,10 @@ typedef struct _delay1 {
   int x_pd_block_size;
   int x_phase; // current __write__ position
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
 } t_delay1;
 
 t_class *delay1_class = NULL;
@@ -43,13 +47,17 @@ static void *delay_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_phase = 0;
   x->x_delay_samples = 0;
   
-  x->x_delay_buffer = getbytes(XTRASAMPS * sizeof(t_sample));
+  x->x_delay_buffer = delay_mem_alloc(XTRASAMPS * sizeof(t_sample));
 
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
 
   outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
@@ -66,9 +74,9 @@ static void delay_buffer_update(t_delay1 *x)
   nsamps += x->x_pd_block_size;
 
   if (x->x_delay_buffer_samples < nsamps) {
-    x->x_delay_buffer = (t_sample *)resizebytes(x->x_delay_buffer,
-                                                x->x_delay_buffer_samples + XTRASAMPS * sizeof(t_sample),
-                                                (nsamps + XTRASAMPS) * sizeof(t_sample));
+    x->x_delay_buffer = (t_sample *)delay_mem_resize(x->x_delay_buffer,
+                                                     (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample),
+                                                     (nsamps + XTRASAMPS) * sizeof(t_sample));
     x->x_delay_buffer_samples = nsamps;
     x->x_phase = XTRASAMPS;
   }
@@ -77,7 +85,7 @@ static void delay_buffer_update(t_delay1 *x)
 static void delay_set_system_params(t_delay1 *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_delay1 *x, t_float f)
@@ -103,45 +111,29 @@ static t_int *delay1_perform(t_int *w)
   int delay_buffer_samps = x->x_delay_buffer_samples;
 
   t_sample *vp = x->x_delay_buffer; // pointer to beginning of delay buffer
-  t_sample *wp = vp + write_phase; // pointer to current write position
-  t_sample *rp; // pointer to current read position
-  t_sample *ep = vp + (x->x_delay_buffer_samples + XTRASAMPS); // pointer to end
-  // of delay buffer
 
   // if write_phase , x->x_delay_samples is before the beginning of the buffer
   if (read_phase < 0) read_phase += delay_buffer_samps; 
-  rp = vp + read_phase;
-
-  while (n--) {
-    // write input to delay buffer
-    // the output sounds clear, but does the read/write order matter?
-    t_sample f = *in1++;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
-    *wp++ = f;
-    // this is an attempt to copy what's happening in the Pure Data source code
-    // my understanding is that vp[0] to vp[3] only get written to here, but may
-    // be accessed by the read pointer
-    if (wp == ep) {
-      vp[0] = ep[-4];
-      vp[1] = ep[-3];
-      vp[2] = ep[-2];
-      vp[3] = ep[-1];
-      wp = vp + XTRASAMPS;
-      write_phase -= delay_buffer_samps;
-    }
-
-    *out++ = *rp++;
-
-    if (rp == ep) rp -= delay_buffer_samps;
-  }
 
-  x->x_phase = write_phase;
+  // write input to delay buffer. the whole block goes in before anything is
+  // read: sample i is read from (write_phase + i - x_delay_samples), which is
+  // never ahead of what the per-sample loop would have written by then. the
+  // buffer only holds copies of the input, so there's no need for
+  // denormals_off(): the copy sanitizes it. x_phase stays a block behind the
+  // position the next block is written at
+  x->x_phase = delay_write_guarded(vp, delay_buffer_samps, write_phase, in1, n) - n;
+
+  // then read it back out, again in one or two pieces
+  delay_read_guarded(vp, delay_buffer_samps, read_phase, out, n);
+
   return (w+5);
 }
 
 static void delay1_dsp(t_delay1 *x, t_signal **sp)
 {
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
   dsp_add(delay1_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  DELAY_STATS_DSP_END(&x->x_stats);
   delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
@@ -150,12 +142,32 @@ static void delay1_dsp(t_delay1 *x, t_signal **sp)
 static void delay_free(t_delay1 *x)
 {
   if (x->x_delay_buffer != NULL) {
-    freebytes(x->x_delay_buffer,
-              (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample));
+    delay_mem_free(x->x_delay_buffer,
+                   (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample));
     x->x_delay_buffer = NULL;
   }
 }
 
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_delay1 *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// `bufinfo` posts the buffer's size and backing
+static void delay_bufinfo(t_delay1 *x)
+{
+  delay_mem_post("delay1~", x->x_delay_buffer,
+                 (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample), NULL);
+}
+
+// process-wide, like the other classes' `prefault` (simple_del_mem.c)
+static void delay_prefault(t_delay1 *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
+}
+
 void delay1_tilde_setup(void)
 {
   delay1_class = class_new(gensym("delay1~"),
@@ -167,6 +179,11 @@ void delay1_tilde_setup(void)
 
   class_addmethod(delay1_class, (t_method)delay1_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(delay1_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
+  class_addmethod(delay1_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(delay1_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
 
   CLASS_MAINSIGNALIN(delay1_class, t_delay1, x_delay_buffer_msecs);
 }
@@ -6,29 +6,69 @@ typedef struct _delay2 {
 
   t_float x_s_per_msec; // samples per msec
   t_float x_delay_buffer_msecs;
-  int x_delay_buffer_samples; // number of samples in delay buffer
+  int x_delay_buffer_samples; // number of frames in delay buffer
+  int x_delay_buffer_alloc; // samples allocated, at least frames * x_nchans
+  // t_samples in the block x_delay_buffer points at. usually
+  // delay_format_words(&x_format, x_delay_buffer_alloc), but more if a
+  // `compact` couldn't shrink the block (see delay_compact)
+  int x_delay_buffer_words;
   int x_delay_buffer_initial_samples;
   t_float x_delay_msecs; // number of msecs to delay
   t_float x_delay_samples; // number of samples of delay
   t_sample *x_delay_buffer;
+  t_delay_format x_format; // floats, or 16 bit samples after `compact`
   int x_pd_block_size;
   int x_phase; // current __write__ position
   t_float x_tap1_level;
   t_float x_tap2_level;
+  int x_interp; // DELAY_INTERP_*, see simple_del_shared.h
+  t_sample x_interp_state[2]; // allpass, one per tap
+
+  // multichannel input: the buffer holds frames of x_nchans samples, one per
+  // channel, and every channel is delayed by the first channel of the delay
+  // time inlet
+  int x_nchans;
+  t_sample *x_chan_mix; // x_pd_block_size frames, the wet signal
+  t_sample *x_chan_tmp; // 2 * x_nchans, the taps of one frame
+  t_sample *x_chan_state; // 2 * x_nchans, allpass
+  int x_chan_alloc_frames; // x_pd_block_size that x_chan_mix was allocated for
+
+  // `time` messages rather than the delay time inlet (see delay_time_set):
+  // whole-sample taps, crossfaded from the old time to the new one
+  int x_control;
+  t_float x_ramp_msecs;
+  int x_ramp_from; // the delay being faded out, in samples
+  int x_ramp_to; // and the one faded in: the delay once the fade is over
+  int x_ramp_length; // samples in the current fade
+  int x_ramp_remain; // samples left of it
 
   t_float x_wet_dry;
   t_float x_feedback;
 
   t_inlet *x_delay_msec_inlet;
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+
+  t_delay_arena *x_arena; // the patch's, where a bigger buffer comes from
+
+  // x_delay_buffer until it outgrows this. at the end, away from the fields
+  // the perform routines use
+  t_sample x_delay_buffer_inline[DELAY_INLINE_SAMPLES];
 } t_delay2;
 
 t_class *delay2_class = NULL;
 
+extern void canvas_update_dsp(void);
+
 static void delay_buffer_update(t_delay2 *x);
+static void delay_maxsize(t_delay2 *x, t_floatarg msecs);
 static void delay_set_delay_samples(t_delay2 *x, t_float f);
 
-static void *delay2_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
+static void *delay2_new(t_floatarg buffer_msecs, t_floatarg delay_msecs,
+                        t_floatarg max_msecs, t_symbol *interp)
 {
   t_delay2 *x = (t_delay2 *)pd_new(delay2_class);
 
@@ -39,52 +79,147 @@ static void *delay2_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_pd_block_size = 0;
   x->x_phase = 0;
   x->x_delay_samples = 0;
-  
-  x->x_delay_buffer_samples = 1024; // initialize with 2^10;
-  x->x_delay_buffer = getbytes(x->x_delay_buffer_samples * sizeof(t_sample));
-  if (x->x_delay_buffer == NULL) {
-    pd_error(x, "delay2~: unable to assign memory to delay buffer");
-    return NULL;
-  }
+  x->x_nchans = 1;
+  x->x_chan_mix = x->x_chan_tmp = x->x_chan_state = NULL;
+  x->x_chan_alloc_frames = 0;
+  x->x_control = 0;
+  x->x_ramp_msecs = 20;
+  x->x_ramp_from = x->x_ramp_to = -1;
+  x->x_ramp_length = x->x_ramp_remain = 0;
+
+  // starts out in x_delay_buffer_inline, until a DSP rebuild needs more
+  x->x_delay_buffer_samples = DELAY_INLINE_SAMPLES;
+  x->x_delay_buffer_alloc = x->x_delay_buffer_samples;
+  x->x_delay_buffer_words = DELAY_INLINE_SAMPLES;
+  x->x_delay_buffer = x->x_delay_buffer_inline;
+  x->x_arena = delay_arena_get();
+  delay_format_set(&x->x_format, 0);
+  // optional third argument: reserve memory for a buffer of up to this many
+  // msecs
+  if (max_msecs > 0) delay_maxsize(x, max_msecs);
 
   x->x_tap1_level = 0.5f;
   x->x_tap2_level = 0.5f;
 
+  // optional fourth argument: the interpolation, cubic by default
+  x->x_interp = DELAY_INTERP_CUBIC;
+  x->x_interp_state[0] = x->x_interp_state[1] = 0;
+  if (*interp->s_name) {
+    int mode = delay_interp_find(interp);
+    if (mode < 0) {
+      pd_error(x, "delay2~: no interpolation called '%s', using cubic", interp->s_name);
+    } else {
+      x->x_interp = mode;
+    }
+  }
+
   x->x_delay_msec_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   // set inlet initial float value
   pd_float((t_pd *)x->x_delay_msec_inlet, x->x_delay_msecs);
 
   outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
+// makes sure there's memory for `samples` samples, without changing the size
+// of the buffer in use. returns 0 on failure
+static int delay_buffer_reserve(t_delay2 *x, int samples)
+{
+  t_sample *buf;
+  int words = delay_format_words(&x->x_format, samples);
+  if (samples <= x->x_delay_buffer_alloc) return 1;
+  if (words > x->x_delay_buffer_words) {
+    buf = delay_buffer_resize(x->x_delay_buffer, x->x_delay_buffer_words, words,
+                              x->x_delay_buffer_inline, DELAY_INLINE_SAMPLES, x->x_arena);
+    if (buf == NULL) {
+      pd_error(x, "delay2~: unable to resize x_delay_buffer");
+      return 0;
+    }
+    x->x_delay_buffer = buf;
+    x->x_delay_buffer_words = words;
+  }
+  x->x_delay_buffer_alloc = samples;
+  return 1;
+}
+
+// called on every DSP rebuild: does nothing unless the size has changed, and
+// keeps the contents of the buffer when it has (see delay_ring_resize)
 static void delay_buffer_update(t_delay2 *x)
 {
-  int buffer_size = 1;
-  while (buffer_size < (x->x_delay_buffer_msecs * x->x_s_per_msec + x->x_pd_block_size)) {
-    buffer_size *= 2;
+  int buffer_size = delay_pow2_size(x->x_delay_buffer_msecs * x->x_s_per_msec +
+                                    x->x_pd_block_size);
+  if (buffer_size == x->x_delay_buffer_samples) return;
+  if (!delay_buffer_reserve(x, buffer_size * x->x_nchans)) return;
+
+  x->x_phase = delay_ring_resize_bytes((char *)x->x_delay_buffer, x->x_delay_buffer_samples,
+                                       buffer_size, x->x_phase,
+                                       x->x_nchans * delay_format_bytes(&x->x_format));
+  x->x_delay_buffer_samples = buffer_size;
+}
+
+// reserves memory for a buffer of up to `msecs`, so that a DSP rebuild that
+// needs a bigger buffer (a longer buffer time, a higher sample rate) doesn't
+// have to allocate
+static void delay_maxsize(t_delay2 *x, t_floatarg msecs)
+{
+  t_float s_per_msec = (x->x_s_per_msec > 0) ? x->x_s_per_msec : sys_getsr() * 0.001;
+  int block_size = (x->x_pd_block_size > 0) ? x->x_pd_block_size : sys_getblksize();
+  delay_buffer_reserve(x, delay_pow2_size(msecs * s_per_msec + block_size) * x->x_nchans);
+}
+
+static void delay_chan_free(t_delay2 *x)
+{
+  if (x->x_chan_mix) {
+    freebytes(x->x_chan_mix, x->x_chan_alloc_frames * x->x_nchans * sizeof(t_sample));
+    freebytes(x->x_chan_tmp, 2 * x->x_nchans * sizeof(t_sample));
+    freebytes(x->x_chan_state, 2 * x->x_nchans * sizeof(t_sample));
   }
+  x->x_chan_mix = x->x_chan_tmp = x->x_chan_state = NULL;
+  x->x_chan_alloc_frames = 0;
+}
 
-  x->x_delay_buffer = (t_sample *)resizebytes(x->x_delay_buffer,
-                                              x->x_delay_buffer_samples *
-                                              sizeof(t_sample), buffer_size * sizeof(t_sample));
-  // todo: maybe return an int value for success/failure?
-  if (x->x_delay_buffer == NULL) {
-    pd_error(x, "delay2~: unable to resize x_delay_buffer");
-    return;
+// called from dsp with the number of channels coming in. the frames of a
+// buffer laid out for a different count mean nothing any more, so it starts
+// again empty. returns 0 if there's no memory for the channels
+static int delay_set_nchans(t_delay2 *x, int nchans, int n)
+{
+  if (nchans != x->x_nchans) {
+    if (!delay_buffer_reserve(x, x->x_delay_buffer_samples * nchans)) return 0;
+    delay_chan_free(x);
+    x->x_nchans = nchans;
+    memset(x->x_delay_buffer, 0,
+           delay_format_words(&x->x_format, x->x_delay_buffer_samples * nchans) *
+           sizeof(t_sample));
+    x->x_phase = 0;
   }
+  if (nchans == 1 || (x->x_chan_mix && x->x_chan_alloc_frames == n)) return 1;
 
-  x->x_delay_buffer_samples = buffer_size;
-  x->x_phase = 0;
-  post("delay2~: (debug) updated delay buffer");
-  post("delay2~: (debug) x_delay_buffer_samples: %d", x->x_delay_buffer_samples);
+  delay_chan_free(x);
+  x->x_chan_mix = (t_sample *)getbytes(n * nchans * sizeof(t_sample));
+  x->x_chan_tmp = (t_sample *)getbytes(2 * nchans * sizeof(t_sample));
+  x->x_chan_state = (t_sample *)getbytes(2 * nchans * sizeof(t_sample));
+  x->x_chan_alloc_frames = n;
+  if (!x->x_chan_mix || !x->x_chan_tmp || !x->x_chan_state) {
+    pd_error(x, "delay2~: unable to assign memory for %d channels", nchans);
+    if (x->x_chan_mix) freebytes(x->x_chan_mix, n * nchans * sizeof(t_sample));
+    if (x->x_chan_tmp) freebytes(x->x_chan_tmp, 2 * nchans * sizeof(t_sample));
+    if (x->x_chan_state) freebytes(x->x_chan_state, 2 * nchans * sizeof(t_sample));
+    x->x_chan_mix = x->x_chan_tmp = x->x_chan_state = NULL;
+    x->x_chan_alloc_frames = 0;
+    return 0;
+  }
+  return 1;
 }
 
 static void delay_set_system_params(t_delay2 *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_delay2 *x, t_float f)
@@ -93,7 +228,205 @@ static void delay_set_delay_samples(t_delay2 *x, t_float f)
   x->x_delay_samples = (int)(0.5 + x->x_s_per_msec * x->x_delay_msecs);
 }
 
-static t_int *delay2_perform(t_int *w)
+/* Used by delay2_perform when the delay time is the same for the whole block.
+ * The read offsets and the interpolation weights of both taps are worked out
+ * once, then the block is run in stretches where neither the write position
+ * nor the taps wrap around the end of the buffer, so that the loop is a plain
+ * stream through the buffer with no masking. Returns the new write phase.
+ * (This loop vectorizes as it is, so unlike the per-sample path it isn't
+ * split into passes: see DELAY_BLOCK_CHUNK.)
+ */
+DELAY_INTERP_INLINE int delay2_perform_constant(t_delay2 *x, t_sample *in1, t_sample *out,
+                                                t_sample delms, t_sample limit, int write_phase,
+                                                int n, const int mode)
+{
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  int delay_buffer_mask = delay_buffer_samples - 1;
+  t_sample *vp = x->x_delay_buffer;
+
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  t_float tap1_level = x->x_tap1_level;
+  t_float tap2_level = x->x_tap2_level;
+
+  t_sample min_delay = delay_interp_min(mode);
+  int older = delay_interp_older(mode);
+  int newer = delay_interp_newer(mode);
+  t_sample state1 = x->x_interp_state[0];
+  t_sample state2 = x->x_interp_state[1];
+
+  t_sample delsamps1 = x->x_s_per_msec * delms;
+  if (!(delsamps1 >= min_delay)) delsamps1 = min_delay;
+  if (delsamps1 > limit) delsamps1 = limit;
+  int idelsamps1 = delsamps1;
+  t_interp_coefs coefs1;
+  delay_interp_coefs(mode, delsamps1 - (t_sample)idelsamps1, &coefs1);
+
+  t_sample delsamps2 = x->x_s_per_msec * 2.0f * delms;
+  if (!(delsamps2 > min_delay)) delsamps2 = min_delay;
+  if (delsamps2 > limit) delsamps2 = limit;
+  int idelsamps2 = delsamps2;
+  t_interp_coefs coefs2;
+  delay_interp_coefs(mode, delsamps2 - (t_sample)idelsamps2, &coefs2);
+
+  int read_phase1 = (write_phase - idelsamps1) & delay_buffer_mask;
+  int read_phase2 = (write_phase - idelsamps2) & delay_buffer_mask;
+
+  while (n > 0) {
+    int len = n;
+    if (len > delay_buffer_samples - write_phase) len = delay_buffer_samples - write_phase;
+    if (len > delay_buffer_samples - newer - read_phase1) {
+      len = delay_buffer_samples - newer - read_phase1;
+    }
+    if (len > delay_buffer_samples - newer - read_phase2) {
+      len = delay_buffer_samples - newer - read_phase2;
+    }
+
+    if (read_phase1 < older || read_phase2 < older || len < 1) {
+      // a tap's points straddle an end of the buffer: do one sample the
+      // slow way
+      t_sample f = *in1;
+      t_sample delayed_output1 = delay_interp_apply(mode, vp, read_phase1, delay_buffer_mask,
+                                                    &coefs1, &state1);
+      t_sample delayed_output2 = delay_interp_apply(mode, vp, read_phase2, delay_buffer_mask,
+                                                    &coefs2, &state2);
+      t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
+      *out = wet_dry * output + wet_dry_inv * f;
+      vp[write_phase] = f * feedback_inv + delayed_output1 * feedback;
+      len = 1;
+    } else {
+      t_sample *wp = vp + write_phase;
+      t_sample *rp1 = vp + read_phase1;
+      t_sample *rp2 = vp + read_phase2;
+      for (int i = 0; i < len; i++) {
+        t_sample f = in1[i];
+        t_sample delayed_output1 = delay_interp_apply(mode, rp1, i, -1, &coefs1, &state1);
+        t_sample delayed_output2 = delay_interp_apply(mode, rp2, i, -1, &coefs2, &state2);
+        t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
+        out[i] = wet_dry * output + wet_dry_inv * f;
+        wp[i] = f * feedback_inv + delayed_output1 * feedback;
+      }
+    }
+
+    in1 += len;
+    out += len;
+    n -= len;
+    write_phase = (write_phase + len) & delay_buffer_mask;
+    read_phase1 = (read_phase1 + len) & delay_buffer_mask;
+    read_phase2 = (read_phase2 + len) & delay_buffer_mask;
+  }
+
+  x->x_interp_state[0] = state1;
+  x->x_interp_state[1] = state2;
+  return write_phase;
+}
+
+/* 1 if a block can be run in passes, DELAY_BLOCK_CHUNK samples at a time:
+ * neither tap reads anything written less than a stretch ago. (A block
+ * shorter than a tap's oldest point could also reach round to the stretch
+ * from the other end of the buffer.)
+ */
+DELAY_INTERP_INLINE int delay2_passes_ok(int idelsamps1, int idelsamps2, int n, const int mode)
+{
+  int chunk = n < DELAY_BLOCK_CHUNK ? n : DELAY_BLOCK_CHUNK;
+  int newer = delay_interp_newer(mode);
+  return DELAY_BLOCK_PASSES && idelsamps1 - newer >= chunk && idelsamps2 - newer >= chunk &&
+    n >= delay_interp_older(mode);
+}
+
+// the feedback write and the mix, for `n` samples whose taps have been read
+// into d1 and d2 already. returns the new write phase
+DELAY_INTERP_INLINE int delay2_write_mix(t_delay2 *x, const t_sample *in1, t_sample *out,
+                                         const t_sample *d1, const t_sample *d2,
+                                         int write_phase, int n)
+{
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  t_sample *vp = x->x_delay_buffer;
+
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  t_float tap1_level = x->x_tap1_level;
+  t_float tap2_level = x->x_tap2_level;
+
+  // the write first, in up to two runs: out can be the same vector as in1
+  for (int i = 0; i < n; ) {
+    int len = delay_buffer_samples - write_phase;
+    if (len > n - i) len = n - i;
+    t_sample *wp = vp + write_phase;
+    for (int j = 0; j < len; j++) wp[j] = in1[i + j] * feedback_inv + d1[i + j] * feedback;
+    i += len;
+    write_phase = (write_phase + len) & (delay_buffer_samples - 1);
+  }
+
+  for (int i = 0; i < n; i++) {
+    t_sample output = d1[i] * tap1_level + d2[i] * tap2_level;
+    out[i] = wet_dry * output + wet_dry_inv * in1[i];
+  }
+  return write_phase;
+}
+
+// the whole-sample part of both taps' delays, clamped as delay2_read_taps
+// clamps them
+DELAY_INTERP_INLINE void delay2_tap_samples(t_delay2 *x, const int mode, t_sample delms,
+                                            t_sample limit, int *idelsamps1, int *idelsamps2)
+{
+  t_sample min_delay = delay_interp_min(mode);
+
+  t_sample delsamps1 = x->x_s_per_msec * delms;
+  if (!(delsamps1 >= min_delay)) delsamps1 = min_delay;
+  if (delsamps1 > limit) delsamps1 = limit;
+  *idelsamps1 = delsamps1;
+
+  t_sample delsamps2 = x->x_s_per_msec * 2.0f * delms;
+  if (!(delsamps2 > min_delay)) delsamps2 = min_delay;
+  if (delsamps2 > limit) delsamps2 = limit;
+  *idelsamps2 = delsamps2;
+}
+
+// both taps, for one sample of the per-sample path
+DELAY_INTERP_INLINE void delay2_read_taps(t_delay2 *x, const int mode, t_sample delms,
+                                          t_sample limit, int write_phase, t_sample *state1,
+                                          t_sample *state2, t_sample *delayed_output1,
+                                          t_sample *delayed_output2)
+{
+  int delay_buffer_mask = x->x_delay_buffer_samples - 1;
+  t_sample *vp = x->x_delay_buffer;
+  t_sample min_delay = delay_interp_min(mode);
+
+  // first tap
+  t_sample delsamps1 = x->x_s_per_msec * delms;
+
+  if (!(delsamps1 >= min_delay)) delsamps1 = min_delay;
+  if (delsamps1 > limit) delsamps1 = limit;
+
+  int idelsamps1 = delsamps1;
+  int read_phase1 = (write_phase - idelsamps1) & delay_buffer_mask;
+
+  t_sample frac1 = delsamps1 - (t_sample)idelsamps1;
+
+  *delayed_output1 = delay_interp(mode, vp, read_phase1, delay_buffer_mask, frac1, state1);
+
+  // second tap
+  t_sample delsamps2 = x->x_s_per_msec * 2.0f * delms;
+
+  if (!(delsamps2 > min_delay)) delsamps2 = min_delay;
+  if (delsamps2 > limit) delsamps2 = limit;
+
+  int idelsamps2 = delsamps2;
+  int read_phase2 = (write_phase - idelsamps2) & delay_buffer_mask;
+
+  t_sample frac2 = delsamps2 - (t_sample)idelsamps2;
+
+  *delayed_output2 = delay_interp(mode, vp, read_phase2, delay_buffer_mask, frac2, state2);
+}
+
+// the perform routine, built once for each interpolation mode (see
+// delay2_perform below)
+DELAY_INTERP_INLINE t_int *delay2_perform_body(t_int *w, const int mode)
 {
   t_delay2 *x = (t_delay2*)(w[1]);
   t_sample *in1 = (t_sample *)(w[2]);
@@ -105,8 +438,11 @@ static t_int *delay2_perform(t_int *w)
   int delay_buffer_mask = delay_buffer_samples - 1;
   int write_phase = x->x_phase;
   write_phase = write_phase & delay_buffer_mask;
+  int write_start = write_phase;
+  int block_size = n;
 
   t_sample *vp = x->x_delay_buffer;
+  t_denormal_state denormal_state = denormals_off();
 
   t_float wet_dry = x->x_wet_dry;
   t_float wet_dry_inv = 1.0f - wet_dry;
@@ -119,76 +455,566 @@ static t_int *delay2_perform(t_int *w)
   if (limit < 0) {
     while (n--) {
       t_sample f = *in1++;
-      if (PD_BIGORSMALL(f)) f = 0.0f;
       vp[write_phase] = f;
       *out++ = 0;
       write_phase = (write_phase + 1) & delay_buffer_mask;
     }
     x->x_phase = write_phase;
+    denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+    denormals_restore(denormal_state);
     return (w+6);
   }
 
-  while (n--) {
-    t_sample f = *in1++;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
+  // ramps and modulated delay times take the per-sample path below
+  if (signal_is_constant(in2, n)) {
+    x->x_phase = delay2_perform_constant(x, in1, out, in2[0], limit, write_phase, n, mode);
+    denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
 
-    t_sample delms = *in2++;
+  t_sample state1 = x->x_interp_state[0];
+  t_sample state2 = x->x_interp_state[1];
 
-    // first tap
-    t_sample delsamps1 = x->x_s_per_msec * delms;
+  // the shortest delay in the block decides whether it can go in passes
+  t_sample delms_min = in2[0];
+  for (int i = 1; i < n; i++) {
+    if (!(in2[i] >= delms_min)) delms_min = in2[i];
+  }
+  int idelsamps1, idelsamps2;
+  delay2_tap_samples(x, mode, delms_min, limit, &idelsamps1, &idelsamps2);
 
-    if (!(delsamps1 >= 1.00001f)) delsamps1 = 1.00001f;
-    if (delsamps1 > limit) delsamps1 = limit;
+  if (delay2_passes_ok(idelsamps1, idelsamps2, n, mode)) {
+    t_sample d1[DELAY_BLOCK_CHUNK], d2[DELAY_BLOCK_CHUNK];
+    while (n > 0) {
+      int len = n < DELAY_BLOCK_CHUNK ? n : DELAY_BLOCK_CHUNK;
+      for (int i = 0; i < len; i++) {
+        delay2_read_taps(x, mode, in2[i], limit, write_phase + i, &state1, &state2,
+                         &d1[i], &d2[i]);
+      }
+      write_phase = delay2_write_mix(x, in1, out, d1, d2, write_phase, len);
+      in1 += len;
+      in2 += len;
+      out += len;
+      n -= len;
+    }
+  } else {
+    while (n--) {
+      t_sample f = *in1++;
+      t_sample delayed_output1, delayed_output2;
+      delay2_read_taps(x, mode, *in2++, limit, write_phase, &state1, &state2,
+                       &delayed_output1, &delayed_output2);
 
-    int idelsamps1 = delsamps1;
-    int read_phase1 = (write_phase - idelsamps1) & delay_buffer_mask;
+      // mix the taps
+      t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
 
-    t_sample frac1 = delsamps1 - (t_sample)idelsamps1;
+      *out++ = wet_dry * output + wet_dry_inv * f;
 
-    t_sample delayed_output1 = cubic_interpolate(vp, read_phase1, delay_buffer_mask, frac1);
+      vp[write_phase] = f * feedback_inv + delayed_output1 * feedback;
 
-    // second tap
-    t_sample delsamps2 = x->x_s_per_msec * 2.0f * delms;
+      write_phase = (write_phase + 1) & delay_buffer_mask;
+    }
+  }
 
-    if (!(delsamps2 > 1.00001f)) delsamps2 = 1.00001f;
-    if (delsamps2 > limit) delsamps2 = limit;
+  x->x_interp_state[0] = state1;
+  x->x_interp_state[1] = state2;
+  x->x_phase = write_phase;
+  denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+  denormals_restore(denormal_state);
+  return (w+6);
+}
 
-    int idelsamps2 = delsamps2;
-    int read_phase2 = (write_phase - idelsamps2) & delay_buffer_mask;
+// delay2_perform[mode]: one perform routine per interpolation mode
+DELAY_INTERP_PERFORM_TABLE(delay2_perform, delay2_perform_body);
 
-    t_sample frac2 = delsamps2 - (t_sample)idelsamps2;
+/* The perform routine for more than one channel. Pd hands over multichannel
+ * signals a channel at a time (channel c is in1[c * n ... c * n + n - 1]),
+ * but the buffer is stored a frame at a time, so that a read at one position
+ * is x_nchans neighbouring samples with the same weights: the taps are
+ * worked out once per frame, not once per channel, and the reads vectorize
+ * across channels (see delay_interp_apply_frames).
+ *
+ * So the input is first turned into frames in x_chan_mix, the block is run a
+ * frame at a time there, and the frames of output are turned back into
+ * channels at the end. (in1 and out can be the same vector: the input has all
+ * been copied by the time out is written.)
+ */
+DELAY_INTERP_INLINE void delay2_multi_taps(t_delay2 *x, const int mode, t_sample delms,
+                                           t_sample limit, int *idelsamps1,
+                                           t_interp_coefs *coefs1, int *idelsamps2,
+                                           t_interp_coefs *coefs2)
+{
+  t_sample min_delay = delay_interp_min(mode);
+
+  t_sample delsamps1 = x->x_s_per_msec * delms;
+  if (!(delsamps1 >= min_delay)) delsamps1 = min_delay;
+  if (delsamps1 > limit) delsamps1 = limit;
+  *idelsamps1 = delsamps1;
+  delay_interp_coefs(mode, delsamps1 - (t_sample)*idelsamps1, coefs1);
+
+  t_sample delsamps2 = x->x_s_per_msec * 2.0f * delms;
+  if (!(delsamps2 > min_delay)) delsamps2 = min_delay;
+  if (delsamps2 > limit) delsamps2 = limit;
+  *idelsamps2 = delsamps2;
+  delay_interp_coefs(mode, delsamps2 - (t_sample)*idelsamps2, coefs2);
+}
+
+DELAY_INTERP_INLINE t_int *delay2_perform_multi_body(t_int *w, const int mode)
+{
+  t_delay2 *x = (t_delay2*)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *in2 = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+
+  int nchans = x->x_nchans;
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  int delay_buffer_mask = delay_buffer_samples - 1;
+  int write_start = x->x_phase & delay_buffer_mask;
+  int write_phase;
+
+  t_sample *vp = x->x_delay_buffer;
+  t_sample *mix = x->x_chan_mix;
+  t_sample *d1 = x->x_chan_tmp, *d2 = x->x_chan_tmp + nchans;
+  t_sample *state1 = x->x_chan_state, *state2 = x->x_chan_state + nchans;
+  t_denormal_state denormal_state = denormals_off();
+
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  t_float tap1_level = x->x_tap1_level;
+  t_float tap2_level = x->x_tap2_level;
 
-    t_sample delayed_output2 = cubic_interpolate(vp, read_phase2, delay_buffer_mask, frac2);
+  t_sample limit = delay_buffer_samples - n;
+  if (limit < 0) {
+    for (int c = 0; c < nchans; c++) {
+      write_phase = write_start;
+      for (int i = 0; i < n; i++) {
+        vp[write_phase * nchans + c] = in1[c * n + i];
+        write_phase = (write_phase + 1) & delay_buffer_mask;
+      }
+    }
+    memset(out, 0, n * nchans * sizeof(t_sample));
+    x->x_phase = (write_start + n) & delay_buffer_mask;
+    denormals_sanitize_ring(vp, delay_buffer_samples * nchans, write_start * nchans,
+                            n * nchans);
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
+
+  for (int c = 0; c < nchans; c++) {
+    const t_sample *src = in1 + c * n;
+    for (int i = 0; i < n; i++) mix[i * nchans + c] = src[i];
+  }
 
-    // mix the taps
-    t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
+  // the taps, for every frame when the delay time moves, else just once
+  int constant = signal_is_constant(in2, n);
+  t_interp_coefs coefs1, coefs2;
+  int idelsamps1, idelsamps2;
+  delay2_multi_taps(x, mode, in2[0], limit, &idelsamps1, &coefs1, &idelsamps2, &coefs2);
 
-    *out++ = wet_dry * output + wet_dry_inv * f;
+  write_phase = write_start;
+  for (int i = 0; i < n; i++) {
+    if (i > 0 && !constant) {
+      delay2_multi_taps(x, mode, in2[i], limit, &idelsamps1, &coefs1, &idelsamps2, &coefs2);
+    }
 
-    vp[write_phase] = f * feedback_inv + delayed_output1 * feedback;
+    delay_interp_apply_frames(mode, vp, write_phase - idelsamps1, delay_buffer_mask, nchans,
+                              &coefs1, state1, d1);
+    delay_interp_apply_frames(mode, vp, write_phase - idelsamps2, delay_buffer_mask, nchans,
+                              &coefs2, state2, d2);
 
+    t_sample *wp = vp + write_phase * nchans;
+    t_sample *mp = mix + i * nchans;
+    for (int c = 0; c < nchans; c++) {
+      t_sample f = mp[c];
+      t_sample output = d1[c] * tap1_level + d2[c] * tap2_level;
+      mp[c] = wet_dry * output + wet_dry_inv * f;
+      wp[c] = f * feedback_inv + d1[c] * feedback;
+    }
     write_phase = (write_phase + 1) & delay_buffer_mask;
   }
 
+  for (int c = 0; c < nchans; c++) {
+    t_sample *o = out + c * n;
+    for (int i = 0; i < n; i++) o[i] = mix[i * nchans + c];
+  }
+
   x->x_phase = write_phase;
+  denormals_sanitize_ring(vp, delay_buffer_samples * nchans, write_start * nchans, n * nchans);
+  denormals_restore(denormal_state);
   return (w+6);
 }
 
+DELAY_INTERP_PERFORM_TABLE(delay2_perform_multi, delay2_perform_multi_body);
+
+/* The perform routine once the buffer is compact (see t_delay_format), for
+ * one channel or many. The points a tap reads are decoded to floats and then
+ * interpolated exactly as delay2_perform does it, so every mode works, and
+ * sounds the same bar the rounding to 16 bits. With the delay time holding
+ * still and both taps at least a stretch old, a stretch goes in passes: the
+ * points for all of it are decoded in one go (a plain loop the compiler
+ * vectorizes), then interpolated, then the feedback is encoded and written.
+ * Otherwise it's a sample at a time, decoding that sample's points.
+ *
+ * The channels of a multichannel block don't mix, so they're run one after
+ * the other, each through its own samples of the frames.
+ */
+
+// `len` samples of one channel, from position `from` on, decoded
+DELAY_INTERP_INLINE void delay2_compact_points(const t_delay_compact *cp, int nchans, int mask,
+                                               int from, int len, t_sample scale, t_sample *p)
+{
+  from &= mask;
+  if (nchans == 1 && from + len <= mask + 1) {
+    delay_compact_decode_vec(p, cp + from, len, scale);
+    return;
+  }
+  for (int k = 0; k < len; k++) p[k] = (t_sample)cp[((from + k) & mask) * nchans] * scale;
+}
+
+DELAY_INTERP_INLINE t_int *delay2_perform_compact_body(t_int *w, const int mode)
+{
+  t_delay2 *x = (t_delay2*)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *in2 = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+
+  int nchans = x->x_nchans;
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  int delay_buffer_mask = delay_buffer_samples - 1;
+  int write_start = x->x_phase & delay_buffer_mask;
+
+  t_delay_compact *vp = (t_delay_compact *)x->x_delay_buffer;
+  t_sample gain = x->x_format.f_gain;
+  t_sample scale = x->x_format.f_scale;
+  t_denormal_state denormal_state = denormals_off();
+
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  t_float tap1_level = x->x_tap1_level;
+  t_float tap2_level = x->x_tap2_level;
+
+  int older = delay_interp_older(mode);
+  int span = older + delay_interp_newer(mode) + 1; // points per read
+
+  t_sample limit = delay_buffer_samples - n;
+  if (limit < 0) {
+    for (int c = 0; c < nchans; c++) {
+      int write_phase = write_start;
+      for (int i = 0; i < n; i++) {
+        vp[write_phase * nchans + c] = delay_compact_encode(in1[c * n + i], gain);
+        write_phase = (write_phase + 1) & delay_buffer_mask;
+      }
+    }
+    memset(out, 0, n * nchans * sizeof(t_sample));
+    x->x_phase = (write_start + n) & delay_buffer_mask;
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
+
+  int constant = signal_is_constant(in2, n);
+  for (int c = 0; c < nchans; c++) {
+    const t_sample *src = in1 + c * n;
+    t_sample *dst = out + c * n;
+    t_delay_compact *cp = vp + c;
+    t_sample *st1 = (nchans > 1) ? x->x_chan_state + c : &x->x_interp_state[0];
+    t_sample *st2 = (nchans > 1) ? x->x_chan_state + nchans + c : &x->x_interp_state[1];
+    t_sample state1 = *st1, state2 = *st2;
+    int write_phase = write_start;
+    int i = 0;
+
+    t_interp_coefs coefs1, coefs2;
+    int idelsamps1, idelsamps2;
+    delay2_multi_taps(x, mode, in2[0], limit, &idelsamps1, &coefs1, &idelsamps2, &coefs2);
+
+    if (constant && delay2_passes_ok(idelsamps1, idelsamps2, n, mode)) {
+      t_sample p1[DELAY_BLOCK_CHUNK + DELAY_SINC_TAPS], p2[DELAY_BLOCK_CHUNK + DELAY_SINC_TAPS];
+      t_sample d1[DELAY_BLOCK_CHUNK], d2[DELAY_BLOCK_CHUNK];
+      while (i < n) {
+        int len = n - i < DELAY_BLOCK_CHUNK ? n - i : DELAY_BLOCK_CHUNK;
+        // read j of the stretch is at p[older + j]
+        delay2_compact_points(cp, nchans, delay_buffer_mask, write_phase - idelsamps1 - older,
+                              len + span - 1, scale, p1);
+        delay2_compact_points(cp, nchans, delay_buffer_mask, write_phase - idelsamps2 - older,
+                              len + span - 1, scale, p2);
+        for (int j = 0; j < len; j++) {
+          d1[j] = delay_interp_apply(mode, p1, older + j, -1, &coefs1, &state1);
+          d2[j] = delay_interp_apply(mode, p2, older + j, -1, &coefs2, &state2);
+        }
+
+        for (int j = 0; j < len; ) {
+          int run = delay_buffer_samples - write_phase;
+          if (run > len - j) run = len - j;
+          t_delay_compact *wp = cp + write_phase * nchans;
+          for (int k = 0; k < run; k++) {
+            wp[k * nchans] = delay_compact_encode(src[i + j + k] * feedback_inv +
+                                                  d1[j + k] * feedback, gain);
+          }
+          j += run;
+          write_phase = (write_phase + run) & delay_buffer_mask;
+        }
+
+        for (int j = 0; j < len; j++) {
+          t_sample output = d1[j] * tap1_level + d2[j] * tap2_level;
+          dst[i + j] = wet_dry * output + wet_dry_inv * src[i + j];
+        }
+        i += len;
+      }
+    }
+
+    for (; i < n; i++) {
+      t_sample p[DELAY_SINC_TAPS];
+      if (!constant) {
+        delay2_multi_taps(x, mode, in2[i], limit, &idelsamps1, &coefs1, &idelsamps2, &coefs2);
+      }
+      t_sample f = src[i];
+      delay2_compact_points(cp, nchans, delay_buffer_mask, write_phase - idelsamps1 - older,
+                            span, scale, p);
+      t_sample delayed_output1 = delay_interp_apply(mode, p, older, -1, &coefs1, &state1);
+      delay2_compact_points(cp, nchans, delay_buffer_mask, write_phase - idelsamps2 - older,
+                            span, scale, p);
+      t_sample delayed_output2 = delay_interp_apply(mode, p, older, -1, &coefs2, &state2);
+
+      t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
+      dst[i] = wet_dry * output + wet_dry_inv * f;
+      cp[write_phase * nchans] = delay_compact_encode(f * feedback_inv +
+                                                      delayed_output1 * feedback, gain);
+      write_phase = (write_phase + 1) & delay_buffer_mask;
+    }
+
+    *st1 = state1;
+    *st2 = state2;
+  }
+
+  x->x_phase = (write_start + n) & delay_buffer_mask;
+  denormals_restore(denormal_state);
+  return (w+6);
+}
+
+DELAY_INTERP_PERFORM_TABLE(delay2_perform_compact, delay2_perform_compact_body);
+
+/* The perform routine for `time` messages (see delay_time_set). The taps are
+ * whole samples, read where `interp none` reads them, so with the delay time
+ * holding still a block is a copy out of the buffer, done in stretches that
+ * don't wrap as in delay2_perform_constant. A new time doesn't jump: over
+ * the `ramp` time the taps at the old time fade out while those at the new
+ * time fade in, as cyclone's delay~ does it (see delay_cyclone_bak.c). A time
+ * that comes in during a fade waits until it's over.
+ *
+ * The channels don't mix, so a multichannel block is just run a channel at a
+ * time, through the frames of the buffer.
+ */
+DELAY_INTERP_INLINE t_int *delay2_perform_control_body(t_int *w, const int multi,
+                                                      const int compact)
+{
+  t_delay2 *x = (t_delay2*)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+
+  int nchans = multi ? x->x_nchans : 1;
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  int delay_buffer_mask = delay_buffer_samples - 1;
+  int write_start = x->x_phase & delay_buffer_mask;
+
+  t_sample *vp = x->x_delay_buffer;
+  t_delay_compact *vq = (t_delay_compact *)x->x_delay_buffer;
+  t_sample gain = x->x_format.f_gain;
+  t_sample scale = x->x_format.f_scale;
+  t_denormal_state denormal_state = denormals_off();
+
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  t_float tap1_level = x->x_tap1_level;
+  t_float tap2_level = x->x_tap2_level;
+
+  int limit = delay_buffer_samples - n;
+  if (limit < 1) {
+    for (int c = 0; c < nchans; c++) {
+      int write_phase = write_start;
+      for (int i = 0; i < n; i++) {
+        if (compact) vq[write_phase * nchans + c] = delay_compact_encode(in1[c * n + i], gain);
+        else vp[write_phase * nchans + c] = in1[c * n + i];
+        write_phase = (write_phase + 1) & delay_buffer_mask;
+      }
+    }
+    memset(out, 0, n * nchans * sizeof(t_sample));
+    x->x_phase = (write_start + n) & delay_buffer_mask;
+    if (!compact) {
+      denormals_sanitize_ring(vp, delay_buffer_samples * nchans, write_start * nchans,
+                              n * nchans);
+    }
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
+
+  int target = x->x_delay_samples;
+  if (target < 1) target = 1;
+  if (target > limit) target = limit;
+  if (x->x_ramp_to < 0) {
+    // nothing to fade from
+    x->x_ramp_to = target;
+    x->x_ramp_remain = 0;
+  } else if (!x->x_ramp_remain && target != x->x_ramp_to) {
+    x->x_ramp_from = x->x_ramp_to;
+    x->x_ramp_to = target;
+    x->x_ramp_length = x->x_ramp_msecs * x->x_s_per_msec;
+    x->x_ramp_remain = x->x_ramp_length;
+  }
+
+  // the buffer can have shrunk since the fade started
+  int from1 = x->x_ramp_from < limit ? x->x_ramp_from : limit;
+  int to1 = x->x_ramp_to < limit ? x->x_ramp_to : limit;
+  int from2 = 2 * from1 < limit ? 2 * from1 : limit;
+  int to2 = 2 * to1 < limit ? 2 * to1 : limit;
+
+  int fade = x->x_ramp_remain < n ? x->x_ramp_remain : n;
+  int done = x->x_ramp_length - x->x_ramp_remain;
+  t_sample ramp_inc = x->x_ramp_length > 0 ? 1.0f / x->x_ramp_length : 0;
+
+  for (int c = 0; c < nchans; c++) {
+    const t_sample *src = in1 + c * n;
+    t_sample *dst = out + c * n;
+    t_sample *cp = vp + c;
+    t_delay_compact *cq = vq + c;
+    int write_phase = write_start;
+    int i;
+
+#define DELAY_CHAN(p) (compact ? (t_sample)cq[((p) & delay_buffer_mask) * nchans] * scale \
+                       : cp[((p) & delay_buffer_mask) * nchans])
+    for (i = 0; i < fade; i++) {
+      t_sample g = (t_sample)(done + i + 1) * ramp_inc;
+      t_sample f = src[i];
+      t_sample delayed_output1 = (1.0f - g) * DELAY_CHAN(write_phase - from1 - 1) +
+        g * DELAY_CHAN(write_phase - to1 - 1);
+      t_sample delayed_output2 = (1.0f - g) * DELAY_CHAN(write_phase - from2 - 1) +
+        g * DELAY_CHAN(write_phase - to2 - 1);
+      t_sample output = delayed_output1 * tap1_level + delayed_output2 * tap2_level;
+      dst[i] = wet_dry * output + wet_dry_inv * f;
+      t_sample fb = f * feedback_inv + delayed_output1 * feedback;
+      if (compact) cq[write_phase * nchans] = delay_compact_encode(fb, gain);
+      else cp[write_phase * nchans] = fb;
+      write_phase = (write_phase + 1) & delay_buffer_mask;
+    }
+#undef DELAY_CHAN
+
+    int read_phase1 = (write_phase - to1 - 1) & delay_buffer_mask;
+    int read_phase2 = (write_phase - to2 - 1) & delay_buffer_mask;
+    while (i < n) {
+      int len = n - i;
+      if (len > delay_buffer_samples - write_phase) len = delay_buffer_samples - write_phase;
+      if (len > delay_buffer_samples - read_phase1) len = delay_buffer_samples - read_phase1;
+      if (len > delay_buffer_samples - read_phase2) len = delay_buffer_samples - read_phase2;
+
+      if (compact) {
+        t_delay_compact *wp = cq + write_phase * nchans;
+        const t_delay_compact *rp1 = cq + read_phase1 * nchans;
+        const t_delay_compact *rp2 = cq + read_phase2 * nchans;
+        for (int j = 0; j < len; j++) {
+          t_sample f = src[i + j];
+          t_sample delayed_output1 = (t_sample)rp1[j * nchans] * scale;
+          t_sample output = delayed_output1 * tap1_level +
+            (t_sample)rp2[j * nchans] * scale * tap2_level;
+          dst[i + j] = wet_dry * output + wet_dry_inv * f;
+          wp[j * nchans] = delay_compact_encode(f * feedback_inv + delayed_output1 * feedback,
+                                                gain);
+        }
+      } else {
+        t_sample *wp = cp + write_phase * nchans;
+        const t_sample *rp1 = cp + read_phase1 * nchans;
+        const t_sample *rp2 = cp + read_phase2 * nchans;
+        for (int j = 0; j < len; j++) {
+          t_sample f = src[i + j];
+          t_sample delayed_output1 = rp1[j * nchans];
+          t_sample output = delayed_output1 * tap1_level + rp2[j * nchans] * tap2_level;
+          dst[i + j] = wet_dry * output + wet_dry_inv * f;
+          wp[j * nchans] = f * feedback_inv + delayed_output1 * feedback;
+        }
+      }
+
+      i += len;
+      write_phase = (write_phase + len) & delay_buffer_mask;
+      read_phase1 = (read_phase1 + len) & delay_buffer_mask;
+      read_phase2 = (read_phase2 + len) & delay_buffer_mask;
+    }
+  }
+
+  x->x_ramp_remain -= fade;
+  x->x_phase = (write_start + n) & delay_buffer_mask;
+  if (!compact) {
+    denormals_sanitize_ring(vp, delay_buffer_samples * nchans, write_start * nchans, n * nchans);
+  }
+  denormals_restore(denormal_state);
+  return (w+6);
+}
+
+static t_int *delay2_perform_control(t_int *w)
+{
+  return delay2_perform_control_body(w, 0, 0);
+}
+
+static t_int *delay2_perform_control_multi(t_int *w)
+{
+  return delay2_perform_control_body(w, 1, 0);
+}
+
+static t_int *delay2_perform_control_compact(t_int *w)
+{
+  return delay2_perform_control_body(w, 0, 1);
+}
+
+static t_int *delay2_perform_control_compact_multi(t_int *w)
+{
+  return delay2_perform_control_body(w, 1, 1);
+}
+
 static void delay2_dsp(t_delay2 *x, t_signal **sp)
 {
-  dsp_add(delay2_perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_length);
-  delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
+  int n = sp[0]->s_length;
+  int nchans = 1;
+#ifdef CLASS_MULTICHANNEL
+  nchans = sp[0]->s_nchans;
+  signal_setmultiout(&sp[2], nchans);
+#endif
+  delay_set_system_params(x, n, sp[0]->s_sr);
+  if (!delay_set_nchans(x, nchans, n)) {
+    dsp_add_zero(sp[2]->s_vec, n * nchans);
+    return;
+  }
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
+  // a new chain starts at the delay time it was given, without a fade
+  x->x_ramp_to = -1;
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, n, sp[0]->s_sr);
+  if (x->x_control) {
+    t_perfroutine perform = x->x_format.f_compact
+      ? (nchans > 1 ? delay2_perform_control_compact_multi : delay2_perform_control_compact)
+      : (nchans > 1 ? delay2_perform_control_multi : delay2_perform_control);
+    dsp_add(perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, n);
+  } else if (x->x_format.f_compact) {
+    dsp_add(delay2_perform_compact[x->x_interp], 5,
+            x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, n);
+  } else {
+    dsp_add(nchans > 1 ? delay2_perform_multi[x->x_interp] : delay2_perform[x->x_interp], 5,
+            x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, n);
+  }
+  DELAY_STATS_DSP_END(&x->x_stats);
 }
 
 static void delay_free(t_delay2 *x)
 {
-  if (x->x_delay_buffer != NULL) {
-    freebytes(x->x_delay_buffer,
-              x->x_delay_buffer_samples * sizeof(t_sample));
-    x->x_delay_buffer = NULL;
-  }
+  delay_buffer_free(x->x_delay_buffer, x->x_delay_buffer_words, x->x_delay_buffer_inline,
+                    x->x_arena);
+  x->x_delay_buffer = NULL;
+  delay_arena_release(x->x_arena);
+  delay_chan_free(x);
 }
 
 static void delay_wet_dry(t_delay2 *x, t_floatarg f)
@@ -209,22 +1035,150 @@ static void delay_feedback(t_delay2 *x, t_floatarg f)
   x->x_feedback = f;
 }
 
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_delay2 *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// `interp none|linear|cubic|lagrange|allpass|sinc`. the perform routine is chosen
+// when the DSP chain is built, so this rebuilds it if DSP is on
+static void delay_interp_set(t_delay2 *x, t_symbol *s)
+{
+  int mode = delay_interp_find(s);
+  if (mode < 0) {
+    pd_error(x, "delay2~: interp: '%s' isn't none, linear, cubic, lagrange, allpass or sinc",
+             s->s_name);
+    return;
+  }
+  if (mode == x->x_interp) return;
+  x->x_interp = mode;
+  x->x_interp_state[0] = x->x_interp_state[1] = 0;
+  if (x->x_chan_state) memset(x->x_chan_state, 0, 2 * x->x_nchans * sizeof(t_sample));
+  canvas_update_dsp();
+}
+
+// `time <msecs>` sets the delay time from a message rather than the delay
+// time inlet, from then on, and fades to it over the `ramp` time; `time` on its
+// own goes back to the inlet. the perform routine is different, so switching
+// rebuilds the DSP chain
+static void delay_time_set(t_delay2 *x, t_symbol *s, int argc, t_atom *argv)
+{
+  int control = argc > 0;
+  if (control) delay_set_delay_samples(x, atom_getfloat(argv));
+  if (control == x->x_control) return;
+  x->x_control = control;
+  canvas_update_dsp();
+}
+
+// `compact <range>`: the buffer holds 16 bit samples up to +-range rather than
+// floats, for half the memory; `compact 0` goes back to floats. what's in the
+// buffer is converted, and since the perform routine is different the DSP
+// chain gets rebuilt
+static void delay_compact(t_delay2 *x, t_floatarg range)
+{
+  t_delay_format to;
+  delay_format_set(&to, range);
+  int words = x->x_delay_buffer_words;
+  int newwords = delay_format_words(&to, x->x_delay_buffer_alloc);
+  t_sample *buf = x->x_delay_buffer;
+
+  if (newwords > words) {
+    buf = delay_buffer_resize(buf, words, newwords, x->x_delay_buffer_inline,
+                              DELAY_INLINE_SAMPLES, x->x_arena);
+    if (buf == NULL) {
+      pd_error(x, "delay2~: unable to assign memory for float samples");
+      return;
+    }
+    words = newwords;
+  }
+  delay_format_convert(buf, x->x_delay_buffer_samples * x->x_nchans, &x->x_format, &to);
+  // if the smaller block can't be had, the compact samples stay in the old
+  // one, and x_delay_buffer_words still says how big that is
+  if (newwords < words) {
+    t_sample *shrunk = delay_buffer_resize(buf, words, newwords, x->x_delay_buffer_inline,
+                                           DELAY_INLINE_SAMPLES, x->x_arena);
+    if (shrunk) {
+      buf = shrunk;
+      words = newwords;
+    }
+  }
+  x->x_delay_buffer = buf;
+  x->x_delay_buffer_words = words;
+
+  int changed = to.f_compact != x->x_format.f_compact;
+  x->x_format = to;
+  if (changed) canvas_update_dsp();
+}
+
+// `ramp <msecs>`: how long a `time` message takes to fade to the new time.
+// a fade that's already going finishes at its own length
+static void delay_ramp(t_delay2 *x, t_floatarg f)
+{
+  x->x_ramp_msecs = (f > 0) ? f : 0;
+}
+
+// `bufinfo`: buffer size and backing. with a short delay it's still the
+// array inside the object
+static void delay_bufinfo(t_delay2 *x)
+{
+  delay_mem_post("delay2~", x->x_delay_buffer, x->x_delay_buffer_words * sizeof(t_sample),
+                 x->x_delay_buffer_inline);
+}
+
+// `poolstats`: how this patch's arena and all of them together are doing
+static void delay_poolstats(t_delay2 *x)
+{
+  delay_arena_post("delay2~", x->x_arena);
+}
+
+// `prefault 1` faults buffers in when they're allocated or grown rather than
+// on the first pass of the write head, `prefault 2` locks them in memory too.
+// it's a setting for the whole process (simple_del_mem.c)
+static void delay_prefault(t_delay2 *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
+}
+
 void delay2_tilde_setup(void)
 {
+  delay_sinc_init();
+
   delay2_class = class_new(gensym("delay2~"),
                           (t_newmethod)delay2_new,
                           (t_method)delay_free,
                           sizeof(t_delay2),
+#ifdef CLASS_MULTICHANNEL
+                          CLASS_MULTICHANNEL,
+#else
                           CLASS_DEFAULT,
-                          A_DEFFLOAT, A_DEFFLOAT, 0);
+#endif
+                          A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFSYM, 0);
 
   class_addmethod(delay2_class, (t_method)delay2_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(delay2_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
 
   class_addmethod(delay2_class, (t_method)delay_wet_dry,
                   gensym("wet_dry"), A_FLOAT, 0);
   class_addmethod(delay2_class, (t_method)delay_feedback,
                   gensym("feedback"), A_FLOAT, 0);
+  class_addmethod(delay2_class, (t_method)delay_maxsize,
+                  gensym("maxsize"), A_FLOAT, 0);
+  class_addmethod(delay2_class, (t_method)delay_compact,
+                  gensym("compact"), A_FLOAT, 0);
+  class_addmethod(delay2_class, (t_method)delay_interp_set,
+                  gensym("interp"), A_SYMBOL, 0);
+  class_addmethod(delay2_class, (t_method)delay_time_set,
+                  gensym("time"), A_GIMME, 0);
+  class_addmethod(delay2_class, (t_method)delay_ramp,
+                  gensym("ramp"), A_FLOAT, 0);
+  class_addmethod(delay2_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(delay2_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
+  class_addmethod(delay2_class, (t_method)delay_poolstats, gensym("poolstats"), 0);
 
   // dummy float arg is required by Pd
   CLASS_MAINSIGNALIN(delay2_class, t_delay2, x_delay_buffer_msecs);
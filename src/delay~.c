@@ -1,5 +1,6 @@
 #include "simple_del_shared.h"
 #include <m_pd.h>
+#include <string.h>
 
 typedef struct _delay {
   t_object x_obj;
@@ -15,6 +16,13 @@ typedef struct _delay {
 
   t_inlet *x_delay_msec_inlet;
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+
+  // where x_delay_buffer starts out (see delay_buffer_resize)
+  t_sample x_delay_buffer_inline[DELAY_INLINE_SAMPLES + XTRASAMPS];
 } t_delay;
 
 t_class *delay_class = NULL;
@@ -35,7 +43,7 @@ static void *delay_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_phase = 0;
   x->x_delay_samples = 0;
   
-  x->x_delay_buffer = getbytes(XTRASAMPS * sizeof(t_sample));
+  x->x_delay_buffer = x->x_delay_buffer_inline;
 
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
@@ -46,6 +54,10 @@ static void *delay_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
 
   outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
@@ -62,9 +74,14 @@ static void delay_buffer_update(t_delay *x)
   nsamps += x->x_pd_block_size;
 
   if (x->x_delay_buffer_samples < nsamps) {
-    x->x_delay_buffer = (t_sample *)resizebytes(x->x_delay_buffer,
-                                                x->x_delay_buffer_samples + XTRASAMPS * sizeof(t_sample),
-                                                (nsamps + XTRASAMPS) * sizeof(t_sample));
+    t_sample *buf = delay_buffer_resize(x->x_delay_buffer, x->x_delay_buffer_samples + XTRASAMPS,
+                                        nsamps + XTRASAMPS, x->x_delay_buffer_inline,
+                                        DELAY_INLINE_SAMPLES + XTRASAMPS, NULL);
+    if (buf == NULL) {
+      pd_error(x, "delay~: unable to assign memory for %d samples", nsamps);
+      return;
+    }
+    x->x_delay_buffer = buf;
     x->x_delay_buffer_samples = nsamps;
     x->x_phase = XTRASAMPS;
   }
@@ -73,7 +90,7 @@ static void delay_buffer_update(t_delay *x)
 static void delay_set_system_params(t_delay *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_delay *x, t_float f)
@@ -85,6 +102,77 @@ static void delay_set_delay_samples(t_delay *x, t_float f)
   x->x_delay_samples = (int)(0.5 + x->x_s_per_msec * x->x_delay_msecs);
 }
 
+/* delay_perform's loop, DELAY_BLOCK_CHUNK samples at a time: the reads into
+ * an array, then the feedback write, then the mix. Returns the new write
+ * phase.
+ */
+static int delay_perform_passes(t_delay *x, t_sample *in1, t_sample *in2, t_sample *out,
+                                t_sample limit, int write_phase, int n)
+{
+  int delay_buffer_samples = x->x_delay_buffer_samples;
+  t_sample *vp = x->x_delay_buffer;
+  t_sample *wp = vp + write_phase;
+  t_sample *ep = vp + (delay_buffer_samples + XTRASAMPS);
+  t_sample fn = n - 1;
+  t_sample delayed[DELAY_BLOCK_CHUNK];
+
+  while (n > 0) {
+    int chunk = n < DELAY_BLOCK_CHUNK ? n : DELAY_BLOCK_CHUNK;
+
+    for (int i = 0; i < chunk; i++) {
+      t_sample delsamps = x->x_s_per_msec * in2[i];
+      int idelsamps;
+
+      if (!(delsamps >= 1.00001f)) delsamps = 1.00001f;
+      if (delsamps > limit) delsamps = limit;
+
+      delsamps += fn;
+      fn = fn - 1.0f;
+      idelsamps = delsamps;
+      t_sample delay_frac = delsamps - (t_sample)idelsamps;
+      int read_phase = write_phase - idelsamps;
+
+      if (read_phase < XTRASAMPS) read_phase += delay_buffer_samples;
+      t_sample a = vp[read_phase];
+      t_sample b = vp[read_phase - 1];
+      t_sample c = vp[read_phase - 2];
+      t_sample d = vp[read_phase - 3];
+      t_sample cminusb = c-b;
+
+      delayed[i] = b + delay_frac * (
+          cminusb - CUBIC_SIXTH * (1.0f - delay_frac) * (
+              (d - a - 3.0f * cminusb) * delay_frac + (d + 2.0f*a - 3.0f*b)
+          )
+      );
+    }
+
+    // the write first: out can be the same vector as in1
+    for (int i = 0; i < chunk; ) {
+      if (wp == ep) {
+        vp[0] = ep[-4];
+        vp[1] = ep[-3];
+        vp[2] = ep[-2];
+        vp[3] = ep[-1];
+        wp = vp + XTRASAMPS;
+        write_phase -= delay_buffer_samples;
+      }
+      int len = ep - wp;
+      if (len > chunk - i) len = chunk - i;
+      for (int j = 0; j < len; j++) wp[j] = in1[i + j] * 0.6f + delayed[i + j] * 0.4f;
+      wp += len;
+      i += len;
+    }
+
+    for (int i = 0; i < chunk; i++) out[i] = 0.5f * delayed[i] + 0.5f * in1[i];
+
+    in1 += chunk;
+    in2 += chunk;
+    out += chunk;
+    n -= chunk;
+  }
+  return write_phase;
+}
+
 static t_int *delay_perform(t_int *w)
 {
   t_delay *x = (t_delay*)(w[1]);
@@ -100,32 +188,37 @@ static t_int *delay_perform(t_int *w)
   t_sample *vp = x->x_delay_buffer;
   t_sample *wp = vp + write_phase;
   t_sample *ep = vp + (x->x_delay_buffer_samples + XTRASAMPS);
+  int write_start = write_phase;
+  int block_size = n;
+  t_denormal_state denormal_state = denormals_off();
 
   t_sample fn = n - 1; // last index of n
 
   t_sample limit = delay_buffer_samples - n;
   if (limit < 0) {
-    while (n--) {
-      t_sample f = *in1++;
-      if (PD_BIGORSMALL(f)) f = 0.0f;
-      *wp++ = f;
-      if (wp == ep) {
-        vp[0] = ep[-4];
-        vp[1] = ep[-3];
-        vp[2] = ep[-2];
-        vp[3] = ep[-1];
-        wp = vp + XTRASAMPS;
-        write_phase -= delay_buffer_samples;
-      }
+    delay_write_guarded(vp, delay_buffer_samples, write_phase, in1, n);
+    memset(out, 0, n * sizeof(t_sample));
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
 
-      *out++ = 0;
-    }
+  // the reads slide back from a block behind the write (see below), so the
+  // block can go in passes (see DELAY_BLOCK_CHUNK) unless the longest delay
+  // reaches round to what the block writes from the other end of the buffer
+  t_sample delms_max = in2[0];
+  for (int i = 1; i < n; i++) {
+    if (in2[i] > delms_max) delms_max = in2[i];
+  }
+  if (DELAY_BLOCK_PASSES && x->x_s_per_msec * delms_max <= limit - n - XTRASAMPS) {
+    x->x_phase = delay_perform_passes(x, in1, in2, out, limit, write_phase, n);
+    denormals_sanitize_guarded(vp, delay_buffer_samples, write_start, block_size);
+    denormals_restore(denormal_state);
     return (w+6);
   }
 
-  while (n--) {
-    t_sample f = *in1++;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
+  // at most two runs: up to the end of the buffer, then from the start. the
+  // guard samples are copied once, when the write reaches the end
+  while (n > 0) {
     if (wp == ep) {
       vp[0] = ep[-4];
       vp[1] = ep[-3];
@@ -134,49 +227,59 @@ static t_int *delay_perform(t_int *w)
       wp = vp + XTRASAMPS;
       write_phase -= delay_buffer_samples;
     }
+    int len = ep - wp;
+    if (len > n) len = n;
+    n -= len;
 
-    t_sample delsamps = x->x_s_per_msec * *in2++;
-    int idelsamps;
-
-    if (!(delsamps >= 1.00001f)) delsamps = 1.00001f;
-    if (delsamps > limit) delsamps = limit;
-
-    // create a sliding window
-    delsamps += fn; // initialized to pd_block_size - 1
-    fn = fn - 1.0f;
-    idelsamps = delsamps;
-    t_sample delay_frac = delsamps - (t_sample)idelsamps;
-    int read_phase = write_phase - idelsamps;
-
-    // possibly delay_buffer_samples should be set to a power of 2 so that bit
-    // masking can be used here
-    // there's an example in `linreg~.c` for how that could be done
-    if (read_phase < XTRASAMPS) read_phase += delay_buffer_samples;
-    t_sample a = vp[read_phase];
-    t_sample b = vp[read_phase - 1];
-    t_sample c = vp[read_phase - 2];
-    t_sample d = vp[read_phase - 3];
-    t_sample cminusb = c-b;
-
-    t_sample delayed_output = b + delay_frac * (
-        cminusb - 0.1666667f * (1.-delay_frac) * (
-            (d - a - 3.0f * cminusb) * delay_frac + (d + 2.0f*a - 3.0f*b)
-        )
-    );
-
-    // wet dry hardcoded for now
-    *out++ = 0.5f * delayed_output + 0.5f * f;
-    // feedback hardcoded for now
-    *wp++ = f * 0.6f + delayed_output * 0.4f;
+    while (len--) {
+      t_sample f = *in1++;
+      t_sample delsamps = x->x_s_per_msec * *in2++;
+      int idelsamps;
+
+      if (!(delsamps >= 1.00001f)) delsamps = 1.00001f;
+      if (delsamps > limit) delsamps = limit;
+
+      // create a sliding window
+      delsamps += fn; // initialized to pd_block_size - 1
+      fn = fn - 1.0f;
+      idelsamps = delsamps;
+      t_sample delay_frac = delsamps - (t_sample)idelsamps;
+      int read_phase = write_phase - idelsamps;
+
+      // possibly delay_buffer_samples should be set to a power of 2 so that bit
+      // masking can be used here
+      // there's an example in `linreg~.c` for how that could be done
+      if (read_phase < XTRASAMPS) read_phase += delay_buffer_samples;
+      t_sample a = vp[read_phase];
+      t_sample b = vp[read_phase - 1];
+      t_sample c = vp[read_phase - 2];
+      t_sample d = vp[read_phase - 3];
+      t_sample cminusb = c-b;
+
+      t_sample delayed_output = b + delay_frac * (
+          cminusb - CUBIC_SIXTH * (1.0f - delay_frac) * (
+              (d - a - 3.0f * cminusb) * delay_frac + (d + 2.0f*a - 3.0f*b)
+          )
+      );
+
+      // wet dry hardcoded for now
+      *out++ = 0.5f * delayed_output + 0.5f * f;
+      // feedback hardcoded for now
+      *wp++ = f * 0.6f + delayed_output * 0.4f;
+    }
   }
 
   x->x_phase = write_phase;
+  denormals_sanitize_guarded(vp, delay_buffer_samples, write_start, block_size);
+  denormals_restore(denormal_state);
   return (w+6);
 }
 
 static void delay_dsp(t_delay *x, t_signal **sp)
 {
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
   dsp_add(delay_perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_length);
+  DELAY_STATS_DSP_END(&x->x_stats);
   delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
@@ -184,11 +287,31 @@ static void delay_dsp(t_delay *x, t_signal **sp)
 
 static void delay_free(t_delay *x)
 {
-  if (x->x_delay_buffer != NULL) {
-    freebytes(x->x_delay_buffer,
-              (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample));
-    x->x_delay_buffer = NULL;
-  }
+  delay_buffer_free(x->x_delay_buffer, x->x_delay_buffer_samples + XTRASAMPS,
+                    x->x_delay_buffer_inline, NULL);
+  x->x_delay_buffer = NULL;
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_delay *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// `bufinfo`: how big the buffer is and what memory it's in (see simple_del_mem.c)
+static void delay_bufinfo(t_delay *x)
+{
+  delay_mem_post("delay~", x->x_delay_buffer,
+                 (x->x_delay_buffer_samples + XTRASAMPS) * sizeof(t_sample),
+                 x->x_delay_buffer_inline);
+}
+
+// `prefault 1|2|0`, see simple_del_mem.c. it applies to every delay
+// buffer, not just this one's
+static void delay_prefault(t_delay *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
 }
 
 void delay_tilde_setup(void)
@@ -202,6 +325,11 @@ void delay_tilde_setup(void)
 
   class_addmethod(delay_class, (t_method)delay_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(delay_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
+  class_addmethod(delay_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(delay_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
 
   CLASS_MAINSIGNALIN(delay_class, t_delay, x_delay_buffer_msecs);
 }
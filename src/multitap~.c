@@ -1,4 +1,6 @@
 #include "simple_del_shared.h"
+#include "simple_del_thread.h"
+#include <math.h>
 
 typedef struct _multitap {
   t_object x_obj;
@@ -6,6 +8,7 @@ typedef struct _multitap {
   t_float x_s_per_msec; // samples per msec
   t_float x_delay_buffer_msecs;
   int x_delay_buffer_samples; // number of samples in delay buffer
+  int x_delay_buffer_alloc; // samples allocated, at least x_delay_buffer_samples
   int x_delay_buffer_initial_samples;
   t_float x_delay_msecs; // number of msecs to delay
   t_float x_delay_samples; // number of samples of delay
@@ -15,19 +18,80 @@ typedef struct _multitap {
   int x_num_taps;
   int x_feedback_tap;
 
+  // tap table set with a `taps` list, kept sorted by time. when it's empty
+  // the taps are evenly spaced at multiples of the delay time inlet
+  t_float *x_table_msecs;
+  t_sample *x_table_gain;
+  t_sample *x_table_send;
+  int x_table_size;
+
+  // the tap plan the perform routine works from, one entry per tap
+  int *x_tap_offset; // whole samples of delay
+  t_sample *x_tap_frac; // the fraction of a sample left over
+  t_sample *x_tap_gain; // level of the tap in the output
+  t_sample *x_tap_send; // level of the tap in the feedback path
+  // scratch space for cubic_interpolate_taps
+  int *x_tap_phase;
+  t_sample *x_tap_out;
+  // for the other interpolation modes: coefficients when the delay time is
+  // constant over a block, and each tap's allpass state
+  t_interp_coefs *x_tap_coefs;
+  t_sample *x_tap_state;
+  int *x_tap_fb; // the convolution path: which taps have a feedback send
+  int x_num_fb;
+  int x_tap_alloc; // room for this many taps in all of the above
+  int x_interp; // DELAY_INTERP_*, see simple_del_shared.h
+
+  // a tap table with enough taps is rendered into an impulse response and
+  // convolved with the buffer instead of being read tap by tap (see
+  // multitap_conv_plan)
+  t_delay_conv x_conv;
+  int x_conv_mode; // MULTITAP_CONV_*, set with `fft`
+  int x_conv_on; // x_conv holds the current tap table
+
+  // `thread 1`: the perform routine runs on a helper thread, a block late
+  // (see simple_del_thread.c)
+  t_delay_thread x_thread;
+  int x_thread_on;
+
   t_float x_wet_dry;
   t_float x_feedback;
 
   t_inlet *x_delay_msec_inlet;
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+
+  t_delay_arena *x_arena; // where the buffer goes after the inline array
+
+  // the buffer's first home (see delay_buffer_resize)
+  t_sample x_delay_buffer_inline[DELAY_INLINE_SAMPLES];
 } t_multitap;
 
 t_class *multitap_class = NULL;
 
+enum {
+  MULTITAP_CONV_AUTO, // whichever should be cheaper
+  MULTITAP_CONV_ON, // whenever it can be used
+  MULTITAP_CONV_OFF
+};
+
+// below this block size the FFTs cost too much per sample to be worth it
+#define MULTITAP_CONV_MIN_BLOCK 16
+
+extern void canvas_update_dsp(void);
+
 static void delay_buffer_update(t_multitap *x);
+static void delay_maxsize(t_multitap *x, t_floatarg msecs);
 static void delay_set_delay_samples(t_multitap *x, t_float f);
+static int delay_tap_alloc(t_multitap *x, int num_taps);
+static void multitap_plan_even(t_multitap *x);
+static void multitap_conv_plan(t_multitap *x);
 
-static void *multitap_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
+static void *multitap_new(t_floatarg buffer_msecs, t_floatarg delay_msecs,
+                          t_floatarg max_msecs, t_symbol *interp)
 {
   t_multitap *x = (t_multitap *)pd_new(multitap_class);
 
@@ -39,51 +103,266 @@ static void *multitap_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_phase = 0;
   x->x_delay_samples = 0;
   
-  x->x_delay_buffer_samples = 1024; // initialize with 2^10;
-  x->x_delay_buffer = getbytes(x->x_delay_buffer_samples * sizeof(t_sample));
-  if (x->x_delay_buffer == NULL) {
-    pd_error(x, "multitap~: unable to assign memory to delay buffer");
-    return NULL;
-  }
+  // starts out in x_delay_buffer_inline, until a DSP rebuild needs more
+  x->x_delay_buffer_samples = DELAY_INLINE_SAMPLES;
+  x->x_delay_buffer_alloc = x->x_delay_buffer_samples;
+  x->x_delay_buffer = x->x_delay_buffer_inline;
+  x->x_arena = delay_arena_get();
+  // optional third argument: reserve memory for a buffer of up to this many
+  // msecs
+  if (max_msecs > 0) delay_maxsize(x, max_msecs);
 
   x->x_num_taps = 4; // hardcoded for now
   x->x_feedback_tap = 1;
 
+  // optional fourth argument: the interpolation, cubic by default
+  x->x_interp = DELAY_INTERP_CUBIC;
+  if (*interp->s_name) {
+    int mode = delay_interp_find(interp);
+    if (mode < 0) {
+      pd_error(x, "multitap~: no interpolation called '%s', using cubic", interp->s_name);
+    } else {
+      x->x_interp = mode;
+    }
+  }
+
+  delay_conv_init(&x->x_conv);
+  x->x_conv_mode = MULTITAP_CONV_AUTO;
+  x->x_conv_on = 0;
+  x->x_num_fb = 0;
+  delay_thread_init(&x->x_thread);
+  x->x_thread_on = 0;
+
+  x->x_tap_alloc = 0;
+  if (!delay_tap_alloc(x, x->x_num_taps)) {
+    pd_error(x, "multitap~: unable to assign memory for taps");
+    pd_free((t_pd *)x); // delay_free gives back the buffer and the arena
+    return NULL;
+  }
+  x->x_table_size = 0;
+  multitap_plan_even(x);
+
   x->x_delay_msec_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   // set inlet initial float value
   pd_float((t_pd *)x->x_delay_msec_inlet, x->x_delay_msecs);
 
   outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
-static void delay_buffer_update(t_multitap *x)
+// grows the tap table and the tap plan. returns 0 on failure
+static int delay_tap_alloc(t_multitap *x, int num_taps)
+{
+  int old = x->x_tap_alloc;
+  if (num_taps <= old) return 1;
+
+  void *arrays[] = {x->x_table_msecs, x->x_table_gain, x->x_table_send, x->x_tap_offset,
+                    x->x_tap_frac, x->x_tap_gain, x->x_tap_send, x->x_tap_phase,
+                    x->x_tap_out, x->x_tap_coefs, x->x_tap_state, x->x_tap_fb};
+  const size_t sizes[] = {sizeof(t_float), sizeof(t_sample), sizeof(t_sample), sizeof(int),
+                          sizeof(t_sample), sizeof(t_sample), sizeof(t_sample), sizeof(int),
+                          sizeof(t_sample), sizeof(t_interp_coefs), sizeof(t_sample),
+                          sizeof(int)};
+  void *grown[12];
+  if (!delay_arrays_grow(arrays, grown, sizes, 12, old, num_taps)) return 0;
+
+  x->x_table_msecs = (t_float *)grown[0];
+  x->x_table_gain = (t_sample *)grown[1];
+  x->x_table_send = (t_sample *)grown[2];
+  x->x_tap_offset = (int *)grown[3];
+  x->x_tap_frac = (t_sample *)grown[4];
+  x->x_tap_gain = (t_sample *)grown[5];
+  x->x_tap_send = (t_sample *)grown[6];
+  x->x_tap_phase = (int *)grown[7];
+  x->x_tap_out = (t_sample *)grown[8];
+  x->x_tap_coefs = (t_interp_coefs *)grown[9];
+  x->x_tap_state = (t_sample *)grown[10];
+  x->x_tap_fb = (int *)grown[11];
+  x->x_tap_alloc = num_taps;
+  return 1;
+}
+
+/* Tap plans. Gains and feedback sends are worked out here, when the taps
+ * change, so the perform routine just multiplies every tap by its gain and its
+ * send: no checking which tap feeds back.
+ */
+
+// evenly spaced taps: all at the same level, one of them feeding back. the
+// offsets depend on the delay time inlet, so the perform routine fills them in
+static void multitap_plan_even(t_multitap *x)
 {
-  int buffer_size = 1;
-  while (buffer_size < (x->x_delay_buffer_msecs * x->x_s_per_msec + x->x_pd_block_size)) {
-    buffer_size *= 2;
+  t_sample tap_level = 1.0f / x->x_num_taps;
+  for (int i = 0; i < x->x_num_taps; i++) {
+    x->x_tap_gain[i] = tap_level;
+    x->x_tap_send[i] = (i + 1 == x->x_feedback_tap) ? 1.0f : 0.0f;
   }
+}
 
-  x->x_delay_buffer = (t_sample *)resizebytes(x->x_delay_buffer,
-                                              x->x_delay_buffer_samples *
-                                              sizeof(t_sample), buffer_size * sizeof(t_sample));
-  // todo: maybe return an int value for success/failure?
-  if (x->x_delay_buffer == NULL) {
-    pd_error(x, "multitap~: unable to resize x_delay_buffer");
+// taps from the tap table: the table doesn't depend on the inlet, so the whole
+// plan is made here, when the table is set and when the sample rate or block
+// size changes
+static void multitap_plan_table(t_multitap *x)
+{
+  t_sample limit = x->x_delay_buffer_samples - x->x_pd_block_size;
+  t_sample min_delay = delay_interp_min(x->x_interp);
+  for (int i = 0; i < x->x_table_size; i++) {
+    t_sample delsamps = x->x_s_per_msec * x->x_table_msecs[i];
+
+    if (!(delsamps >= min_delay)) delsamps = min_delay;
+    if (delsamps > limit) delsamps = limit;
+
+    int idelsamps = delsamps;
+    x->x_tap_offset[i] = idelsamps;
+    x->x_tap_frac[i] = delsamps - (t_sample)idelsamps;
+    x->x_tap_gain[i] = x->x_table_gain[i];
+    x->x_tap_send[i] = x->x_table_send[i];
+  }
+  multitap_conv_plan(x);
+}
+
+/* The convolution path. Every tap of a table is a fixed, weighted read of a
+ * few neighbouring samples, so the sum of them all is the buffer convolved
+ * with one impulse response. Past a few dozen taps it's cheaper to work that
+ * out with FFTs (simple_del_conv.c), a block at a time, than to read each tap
+ * for every sample. The taps with a feedback send are still read one by one,
+ * as each sample is written, since the next sample of the buffer depends on
+ * them; the output is then the convolution of the finished block. Nothing
+ * about the delays, the feedback or the output changes.
+ *
+ * allpass taps aren't fixed reads (they have state), and evenly spaced taps
+ * follow the delay time inlet, so those always take the direct path.
+ */
+
+// the weight a mode gives each of the points it reads for `frac`: w[0] for
+// buffer[phase + newer] down to w[older + newer] for buffer[phase - older].
+// found by reading a unit impulse at each point in turn
+static void multitap_point_weights(int mode, t_sample frac, t_sample *w)
+{
+  int older = delay_interp_older(mode), newer = delay_interp_newer(mode);
+  t_sample probe[16] = {0};
+  t_interp_coefs k;
+  // modes that don't need all the weights leave them alone
+  memset(&k, 0, sizeof(k));
+  t_sample state = 0;
+  delay_interp_coefs(mode, frac, &k);
+  for (int m = -newer; m <= older; m++) {
+    probe[8 - m] = 1;
+    w[m + newer] = delay_interp_apply(mode, probe, 8, 15, &k, &state);
+    probe[8 - m] = 0;
+  }
+}
+
+// whether the convolution should be cheaper: the tap count against the
+// length of the response. in units of one point of one tap read for one
+// sample, a partition costs about 2.5 per sample (a complex multiply-add per
+// bin, mostly waiting on memory) and the two FFTs about 10 * log2(FFT size)
+// spread over the block. measured with the bench's stub FFT on x86_64
+static int multitap_conv_wanted(t_multitap *x, int nparts)
+{
+  int block = x->x_pd_block_size;
+  if (x->x_conv_mode == MULTITAP_CONV_ON) return 1;
+  double points = delay_interp_older(x->x_interp) + delay_interp_newer(x->x_interp) + 1;
+  double direct = x->x_table_size * points;
+  double conv = 2.5 * nparts + 10.0 * log2(2.0 * block);
+  return conv < direct;
+}
+
+// sets up (or drops) the convolution path for the current tap plan
+static void multitap_conv_plan(t_multitap *x)
+{
+  int block = x->x_pd_block_size;
+  int mode = x->x_interp;
+  int older = delay_interp_older(mode), newer = delay_interp_newer(mode);
+
+  x->x_conv_on = 0;
+  if (x->x_conv_mode == MULTITAP_CONV_OFF || !x->x_table_size ||
+      mode == DELAY_INTERP_ALLPASS || block < MULTITAP_CONV_MIN_BLOCK ||
+      (block & (block - 1)) || 2 * block > x->x_delay_buffer_samples) {
+    delay_conv_free(&x->x_conv);
+    return;
+  }
+
+  int length = 0;
+  for (int i = 0; i < x->x_table_size; i++) {
+    if (x->x_tap_offset[i] + older + 1 > length) length = x->x_tap_offset[i] + older + 1;
+  }
+  if (!multitap_conv_wanted(x, (length + block - 1) / block)) {
+    delay_conv_free(&x->x_conv);
+    return;
+  }
+
+  t_sample *ir = (t_sample *)getbytes(length * sizeof(t_sample));
+  if (!ir || !delay_conv_setup(&x->x_conv, block, length)) {
+    if (ir) freebytes(ir, length * sizeof(t_sample));
+    pd_error(x, "multitap~: not enough memory for the convolution, reading taps one by one");
     return;
   }
+  x->x_num_fb = 0;
+  for (int i = 0; i < x->x_table_size; i++) {
+    t_sample weights[16];
+    multitap_point_weights(mode, x->x_tap_frac[i], weights);
+    for (int m = -newer; m <= older; m++) {
+      ir[x->x_tap_offset[i] + m] += x->x_tap_gain[i] * weights[m + newer];
+    }
+    if (x->x_tap_send[i] != 0) x->x_tap_fb[x->x_num_fb++] = i;
+  }
+  delay_conv_set_ir(&x->x_conv, ir, length, x->x_delay_buffer,
+                    x->x_delay_buffer_samples - 1, x->x_phase);
+  freebytes(ir, length * sizeof(t_sample));
+  x->x_conv_on = 1;
+}
+
+// makes sure there's memory for `samples` samples, without changing the size
+// of the buffer in use. returns 0 on failure
+static int delay_buffer_reserve(t_multitap *x, int samples)
+{
+  t_sample *buf;
+  if (samples <= x->x_delay_buffer_alloc) return 1;
+  buf = delay_buffer_resize(x->x_delay_buffer, x->x_delay_buffer_alloc, samples,
+                            x->x_delay_buffer_inline, DELAY_INLINE_SAMPLES, x->x_arena);
+  if (buf == NULL) {
+    pd_error(x, "multitap~: unable to resize x_delay_buffer");
+    return 0;
+  }
+  x->x_delay_buffer = buf;
+  x->x_delay_buffer_alloc = samples;
+  return 1;
+}
 
+// called on every DSP rebuild: does nothing unless the size has changed, and
+// keeps the contents of the buffer when it has (see delay_ring_resize)
+static void delay_buffer_update(t_multitap *x)
+{
+  int buffer_size = delay_pow2_size(x->x_delay_buffer_msecs * x->x_s_per_msec +
+                                    x->x_pd_block_size);
+  if (buffer_size == x->x_delay_buffer_samples) return;
+  if (!delay_buffer_reserve(x, buffer_size)) return;
+
+  x->x_phase = delay_ring_resize(x->x_delay_buffer, x->x_delay_buffer_samples,
+                                 buffer_size, x->x_phase, 1);
   x->x_delay_buffer_samples = buffer_size;
-  x->x_phase = 0;
-  post("multitap~: (debug) updated delay buffer");
-  post("multitap~: (debug) x_delay_buffer_samples: %d", x->x_delay_buffer_samples);
+}
+
+// reserves memory for a buffer of up to `msecs`, so that a DSP rebuild that
+// needs a bigger buffer (a longer buffer time, a higher sample rate) doesn't
+// have to allocate
+static void delay_maxsize(t_multitap *x, t_floatarg msecs)
+{
+  delay_thread_sync(&x->x_thread);
+  t_float s_per_msec = (x->x_s_per_msec > 0) ? x->x_s_per_msec : sys_getsr() * 0.001;
+  int block_size = (x->x_pd_block_size > 0) ? x->x_pd_block_size : sys_getblksize();
+  delay_buffer_reserve(x, delay_pow2_size(msecs * s_per_msec + block_size));
 }
 
 static void delay_set_system_params(t_multitap *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_multitap *x, t_float f)
@@ -92,7 +371,66 @@ static void delay_set_delay_samples(t_multitap *x, t_float f)
   x->x_delay_samples = (int)(0.5 + x->x_s_per_msec * x->x_delay_msecs);
 }
 
-static t_int *multitap_perform(t_int *w)
+// the whole number of samples each tap is delayed by, and the fraction left
+// over, for a delay time of `delms`
+static inline void multitap_tap_offsets(t_float s_per_msec, t_sample delms, t_sample limit,
+                                        t_sample min_delay, int num_taps, int *tap_offset,
+                                        t_sample *tap_frac)
+{
+  for (int i = 0; i < num_taps; i++) {
+    int tap = i + 1;
+    t_sample delsamps = s_per_msec * (t_sample)tap * delms;
+
+    if (!(delsamps >= min_delay)) delsamps = min_delay;
+    if (delsamps > limit) delsamps = limit;
+
+    int idelsamps = delsamps;
+    tap_offset[i] = idelsamps;
+    tap_frac[i] = delsamps - (t_sample)idelsamps;
+  }
+}
+
+// a block on the convolution path: writes the block into the buffer, reading
+// just the feedback taps, then convolves. returns the new write phase
+DELAY_INTERP_INLINE int multitap_perform_conv(t_multitap *x, const t_sample *in1, t_sample *out,
+                                              int n, int write_phase, const int mode)
+{
+  int delay_buffer_mask = x->x_delay_buffer_samples - 1;
+  t_sample *vp = x->x_delay_buffer;
+  t_float wet_dry = x->x_wet_dry;
+  t_float wet_dry_inv = 1.0f - wet_dry;
+  t_float feedback = x->x_feedback;
+  t_float feedback_inv = 1.0f - feedback;
+  int *tap_fb = x->x_tap_fb;
+  int num_fb = x->x_num_fb;
+  int *tap_offset = x->x_tap_offset;
+  t_sample *tap_send = x->x_tap_send;
+  t_interp_coefs *tap_coefs = x->x_tap_coefs;
+  t_sample *tap_state = x->x_tap_state;
+
+  for (int j = 0; j < num_fb; j++) {
+    delay_interp_coefs(mode, x->x_tap_frac[tap_fb[j]], &tap_coefs[tap_fb[j]]);
+  }
+  for (int i = 0; i < n; i++) {
+    t_sample tap_delay = 0.0f;
+    for (int j = 0; j < num_fb; j++) {
+      int t = tap_fb[j];
+      int phase = (write_phase - tap_offset[t]) & delay_buffer_mask;
+      tap_delay += tap_send[t] * delay_interp_apply(mode, vp, phase, delay_buffer_mask,
+                                                    &tap_coefs[t], &tap_state[t]);
+    }
+    vp[write_phase] = in1[i] * feedback_inv + tap_delay * feedback;
+    write_phase = (write_phase + 1) & delay_buffer_mask;
+  }
+
+  t_sample *delayed = delay_conv_process(&x->x_conv, vp, delay_buffer_mask, write_phase);
+  for (int i = 0; i < n; i++) out[i] = wet_dry * delayed[i] + wet_dry_inv * in1[i];
+  return write_phase;
+}
+
+// the perform routine, built once for each interpolation mode (see
+// multitap_perform below)
+DELAY_INTERP_INLINE t_int *multitap_perform_body(t_int *w, const int mode)
 {
   t_multitap *x = (t_multitap *)(w[1]);
   t_sample *in1 = (t_sample *)(w[2]);
@@ -104,51 +442,98 @@ static t_int *multitap_perform(t_int *w)
   int delay_buffer_mask = delay_buffer_samples - 1;
   int write_phase = x->x_phase;
   write_phase = write_phase & delay_buffer_mask;
+  int write_start = write_phase;
+  int block_size = n;
 
   t_sample *vp = x->x_delay_buffer;
+  t_denormal_state denormal_state = denormals_off();
 
   t_float wet_dry = x->x_wet_dry;
   t_float wet_dry_inv = 1.0f - wet_dry;
   t_float feedback = x->x_feedback;
   t_float feedback_inv = 1.0f - feedback;
-  t_float tap_level = 1.0f / x->x_num_taps;
 
   t_sample limit = delay_buffer_samples - n;
   if (limit < 0) {
     while (n--) {
       t_sample f = *in1++;
-      if (PD_BIGORSMALL(f)) f = 0.0f;
       vp[write_phase] = f;
       *out++ = 0;
       write_phase = (write_phase + 1) & delay_buffer_mask;
     }
     x->x_phase = write_phase;
+    denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+    denormals_restore(denormal_state);
+    return (w+6);
+  }
+
+  if (x->x_conv_on && n == x->x_conv.c_block) {
+    x->x_phase = multitap_perform_conv(x, in1, out, n, write_phase, mode);
+    denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+    denormals_restore(denormal_state);
     return (w+6);
   }
 
+  t_float s_per_msec = x->x_s_per_msec;
+  int num_taps = x->x_table_size ? x->x_table_size : x->x_num_taps;
+  int *tap_offset = x->x_tap_offset;
+  t_sample *tap_frac = x->x_tap_frac;
+  t_sample *tap_gain = x->x_tap_gain;
+  t_sample *tap_send = x->x_tap_send;
+  int *tap_phase = x->x_tap_phase;
+  t_sample *tap_out = x->x_tap_out;
+  t_interp_coefs *tap_coefs = x->x_tap_coefs;
+  t_sample *tap_state = x->x_tap_state;
+  t_sample min_delay = delay_interp_min(mode);
+
+  // the tap table's offsets are already in the plan. evenly spaced taps need
+  // them working out from the delay time inlet: once for the block when it
+  // doesn't change over the block (the usual case), and for every sample when
+  // it's a ramp or modulated
+  int constant_delay = x->x_table_size || signal_is_constant(in2, n);
+  if (!x->x_table_size && constant_delay) {
+    multitap_tap_offsets(s_per_msec, in2[0], limit, min_delay, num_taps, tap_offset, tap_frac);
+  }
+  // cubic has its own kernels for all the taps at once. the other modes
+  // work out what they can from the fractions up front when they don't change
+  if (mode != DELAY_INTERP_CUBIC && constant_delay) {
+    for (int i = 0; i < num_taps; i++) delay_interp_coefs(mode, tap_frac[i], &tap_coefs[i]);
+  }
+
   while (n--) {
     t_sample f = *in1++;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
 
     t_sample delms = *in2++;
 
     t_sample out_delays = 0.0f;
     t_sample tap_delay = 0.0f;
 
-    for (int i = 0; i < x->x_num_taps; i++) {
-      int tap = i + 1;
-      t_sample delsamps = x->x_s_per_msec * ((float)tap) * delms;
-
-      if (!(delsamps >= 1.00001f)) delsamps = 1.00001f;
-      if (delsamps > limit) delsamps = limit;
+    // work out where each tap reads from, then interpolate all of them in one
+    // go (see simple_del_kernels.c)
+    if (!constant_delay) {
+      multitap_tap_offsets(s_per_msec, delms, limit, min_delay, num_taps, tap_offset, tap_frac);
+    }
+    for (int i = 0; i < num_taps; i++) {
+      tap_phase[i] = (write_phase - tap_offset[i]) & delay_buffer_mask;
+    }
 
-      int idelsamps = delsamps;
-      int read_phase = (write_phase - idelsamps) & delay_buffer_mask;
+    if (mode == DELAY_INTERP_CUBIC) {
+      cubic_interpolate_taps(vp, delay_buffer_mask, tap_phase, tap_frac, tap_out, num_taps);
+    } else if (constant_delay) {
+      for (int i = 0; i < num_taps; i++) {
+        tap_out[i] = delay_interp_apply(mode, vp, tap_phase[i], delay_buffer_mask,
+                                        &tap_coefs[i], &tap_state[i]);
+      }
+    } else {
+      for (int i = 0; i < num_taps; i++) {
+        tap_out[i] = delay_interp(mode, vp, tap_phase[i], delay_buffer_mask, tap_frac[i],
+                                  &tap_state[i]);
+      }
+    }
 
-      t_sample frac = delsamps - (t_sample)idelsamps;
-      t_sample delay_line = cubic_interpolate(vp, read_phase, delay_buffer_mask, frac);
-      out_delays += tap_level * delay_line;
-      if (tap == x->x_feedback_tap) tap_delay = delay_line;
+    for (int i = 0; i < num_taps; i++) {
+      out_delays += tap_gain[i] * tap_out[i];
+      tap_delay += tap_send[i] * tap_out[i];
     }
 
     *out++ = wet_dry * out_delays + wet_dry_inv * f;
@@ -159,24 +544,53 @@ static t_int *multitap_perform(t_int *w)
   }
 
   x->x_phase = write_phase;
+  denormals_sanitize_ring(vp, delay_buffer_samples, write_start, block_size);
+  denormals_restore(denormal_state);
   return (w+6);
 }
 
+// multitap_perform[mode]: one perform routine per interpolation mode
+DELAY_INTERP_PERFORM_TABLE(multitap_perform, multitap_perform_body);
+
 static void multitap_dsp(t_multitap *x, t_signal **sp)
 {
-  dsp_add(multitap_perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_length);
+  delay_thread_sync(&x->x_thread);
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
+  if (!x->x_thread_on ||
+      !delay_thread_dsp(&x->x_thread, multitap_perform[x->x_interp], x, 2, 1, sp)) {
+    dsp_add(multitap_perform[x->x_interp], 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_length);
+  }
+  DELAY_STATS_DSP_END(&x->x_stats);
   delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
+  if (x->x_table_size) multitap_plan_table(x);
 }
 
 static void delay_free(t_multitap *x)
 {
-  if (x->x_delay_buffer != NULL) {
-    freebytes(x->x_delay_buffer,
-              x->x_delay_buffer_samples * sizeof(t_sample));
-    x->x_delay_buffer = NULL;
+  delay_thread_free(&x->x_thread);
+  delay_buffer_free(x->x_delay_buffer, x->x_delay_buffer_alloc, x->x_delay_buffer_inline,
+                    x->x_arena);
+  x->x_delay_buffer = NULL;
+  delay_arena_release(x->x_arena);
+
+  if (x->x_tap_alloc > 0) {
+    freebytes(x->x_table_msecs, x->x_tap_alloc * sizeof(t_float));
+    freebytes(x->x_table_gain, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_table_send, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_offset, x->x_tap_alloc * sizeof(int));
+    freebytes(x->x_tap_frac, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_gain, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_send, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_phase, x->x_tap_alloc * sizeof(int));
+    freebytes(x->x_tap_out, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_coefs, x->x_tap_alloc * sizeof(t_interp_coefs));
+    freebytes(x->x_tap_state, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_fb, x->x_tap_alloc * sizeof(int));
+    x->x_tap_alloc = 0;
   }
+  delay_conv_free(&x->x_conv);
 }
 
 static void delay_wet_dry(t_multitap *x, t_floatarg f)
@@ -197,40 +611,192 @@ static void delay_feedback(t_multitap *x, t_floatarg f)
   x->x_feedback = f;
 }
 
-static void delay_taps(t_multitap *x, t_floatarg f)
+/* `taps 8` spaces 8 taps evenly, at multiples of the delay time inlet, all at
+ * the same level.
+ * `taps 120 0.5 0.3 250 0.4 0 ...` sets a tap table instead: each tap is a
+ * time in msecs, a gain, and how much of it goes to the feedback path. While
+ * a table is set the delay time inlet is ignored.
+ */
+static void delay_taps(t_multitap *x, t_symbol *s, int argc, t_atom *argv)
 {
-  if (f < 1) {
-    pd_error(x, "multitap~: there needs to be at least 1 tap. Setting to 1");
-    f = 1.0f;
+  delay_thread_sync(&x->x_thread);
+  if (argc == 1) {
+    t_float f = atom_getfloat(argv);
+    if (f < 1) {
+      pd_error(x, "multitap~: there needs to be at least 1 tap. Setting to 1");
+      f = 1.0f;
+    }
+    if (!delay_tap_alloc(x, (int)f)) {
+      pd_error(x, "multitap~: unable to assign memory for %d taps", (int)f);
+      return;
+    }
+    x->x_num_taps = (int)f;
+    x->x_table_size = 0;
+    multitap_plan_even(x);
+    multitap_conv_plan(x);
+    return;
+  }
+
+  if (argc < 3 || argc % 3) {
+    pd_error(x, "multitap~: taps needs a number of taps, or a list of (time gain feedback-send) triples");
+    return;
+  }
+
+  int size = argc / 3;
+  if (!delay_tap_alloc(x, size)) {
+    pd_error(x, "multitap~: unable to assign memory for %d taps", size);
+    return;
   }
-  x->x_num_taps = (int)f;
+
+  // insertion sort by time, so that the taps read through the buffer in order
+  for (int i = 0; i < size; i++) {
+    t_float msecs = atom_getfloat(argv + 3 * i);
+    t_sample gain = atom_getfloat(argv + 3 * i + 1);
+    t_sample send = atom_getfloat(argv + 3 * i + 2);
+    int j = i;
+    if (msecs > x->x_delay_buffer_msecs) {
+      pd_error(x, "multitap~: tap at %g ms is longer than the %g ms buffer", msecs,
+               x->x_delay_buffer_msecs);
+    }
+    while (j > 0 && x->x_table_msecs[j - 1] > msecs) {
+      x->x_table_msecs[j] = x->x_table_msecs[j - 1];
+      x->x_table_gain[j] = x->x_table_gain[j - 1];
+      x->x_table_send[j] = x->x_table_send[j - 1];
+      j--;
+    }
+    x->x_table_msecs[j] = msecs;
+    x->x_table_gain[j] = gain;
+    x->x_table_send[j] = send;
+  }
+  x->x_table_size = size;
+  multitap_plan_table(x);
 }
 
 static void delay_feedback_tap(t_multitap *x, t_floatarg f)
 {
+  delay_thread_sync(&x->x_thread);
   x->x_feedback_tap = (int)f;
+  if (!x->x_table_size) multitap_plan_even(x);
+}
+
+// `interp none|linear|cubic|lagrange|allpass|sinc`. the perform routine is chosen
+// when the DSP chain is built, so this rebuilds it if DSP is on
+static void delay_interp_set(t_multitap *x, t_symbol *s)
+{
+  int mode = delay_interp_find(s);
+  if (mode < 0) {
+    pd_error(x, "multitap~: interp: '%s' isn't none, linear, cubic, lagrange, allpass or sinc",
+             s->s_name);
+    return;
+  }
+  if (mode == x->x_interp) return;
+  delay_thread_sync(&x->x_thread);
+  x->x_interp = mode;
+  memset(x->x_tap_state, 0, x->x_tap_alloc * sizeof(t_sample));
+  // the shortest delay depends on the mode
+  if (x->x_table_size) multitap_plan_table(x);
+  canvas_update_dsp();
+}
+
+// `fft auto` (the default) convolves a tap table when that should be cheaper
+// than reading its taps, `fft on` whenever it can, `fft off` never
+static void delay_fft(t_multitap *x, t_symbol *s)
+{
+  if (s == gensym("auto")) {
+    x->x_conv_mode = MULTITAP_CONV_AUTO;
+  } else if (s == gensym("on")) {
+    x->x_conv_mode = MULTITAP_CONV_ON;
+  } else if (s == gensym("off")) {
+    x->x_conv_mode = MULTITAP_CONV_OFF;
+  } else {
+    pd_error(x, "multitap~: fft: '%s' isn't auto, on or off", s->s_name);
+    return;
+  }
+  delay_thread_sync(&x->x_thread);
+  multitap_conv_plan(x);
+}
+
+// `thread 1` moves the perform routine to a helper thread, which adds a
+// block of latency, `thread 0` brings it back. `thread` on its own posts how
+// many blocks the helper has been too late with since it was last asked
+static void delay_thread_set(t_multitap *x, t_symbol *s, int argc, t_atom *argv)
+{
+  (void)s;
+  if (!argc) {
+    post("multitap~: %u blocks missed by the helper thread",
+         delay_thread_underruns(&x->x_thread));
+    return;
+  }
+  int on = (atom_getfloat(argv) != 0);
+  if (on == x->x_thread_on) return;
+  x->x_thread_on = on;
+  if (!on) delay_thread_stop(&x->x_thread);
+  canvas_update_dsp();
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_multitap *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// `bufinfo`: the ring's size and what kind of pages it's on (simple_del_mem.c)
+static void delay_bufinfo(t_multitap *x)
+{
+  delay_mem_post("multitap~", x->x_delay_buffer, x->x_delay_buffer_alloc * sizeof(t_sample),
+                 x->x_delay_buffer_inline);
+}
+
+// posts the arena's chunks, peak use and fragmentation (delay_arena_post)
+static void delay_poolstats(t_multitap *x)
+{
+  delay_arena_post("multitap~", x->x_arena);
+}
+
+// `prefault`, shared by all the delay classes: see simple_del_mem.c
+static void delay_prefault(t_multitap *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
 }
 
 void multitap_tilde_setup(void)
 {
+  simple_del_kernels_init();
+  delay_sinc_init();
+
   multitap_class = class_new(gensym("multitap~"),
                           (t_newmethod)multitap_new,
                           (t_method)delay_free,
                           sizeof(t_multitap),
                           CLASS_DEFAULT,
-                          A_DEFFLOAT, A_DEFFLOAT, 0);
+                          A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFSYM, 0);
 
   class_addmethod(multitap_class, (t_method)multitap_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(multitap_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
 
   class_addmethod(multitap_class, (t_method)delay_wet_dry,
                   gensym("wet_dry"), A_FLOAT, 0);
   class_addmethod(multitap_class, (t_method)delay_feedback,
                   gensym("feedback"), A_FLOAT, 0);
+  class_addmethod(multitap_class, (t_method)delay_maxsize,
+                  gensym("maxsize"), A_FLOAT, 0);
+  class_addmethod(multitap_class, (t_method)delay_interp_set,
+                  gensym("interp"), A_SYMBOL, 0);
   class_addmethod(multitap_class, (t_method)delay_taps,
-                  gensym("taps"), A_FLOAT, 0);
+                  gensym("taps"), A_GIMME, 0);
   class_addmethod(multitap_class, (t_method)delay_feedback_tap,
                   gensym("feedback_tap"), A_FLOAT, 0);
+  class_addmethod(multitap_class, (t_method)delay_fft,
+                  gensym("fft"), A_SYMBOL, 0);
+  class_addmethod(multitap_class, (t_method)delay_thread_set,
+                  gensym("thread"), A_GIMME, 0);
+  class_addmethod(multitap_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(multitap_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
+  class_addmethod(multitap_class, (t_method)delay_poolstats, gensym("poolstats"), 0);
 
   // dummy float arg is required by Pd
   CLASS_MAINSIGNALIN(multitap_class, t_multitap, x_delay_buffer_msecs);
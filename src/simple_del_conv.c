@@ -0,0 +1,167 @@
+/* Uniformly partitioned overlap-save convolution, for multitap~ with a lot of
+ * taps (see simple_del_shared.h).
+ *
+ * The impulse response is cut into partitions of one block each, and every
+ * partition is kept as the spectrum of the block zero padded to two. Each
+ * block, the last two blocks of input (the previous one and the one just
+ * written) are transformed once and stored in a ring of spectra, the
+ * "frequency domain delay line". The output spectrum is then the sum over
+ * partitions of partition p times the input spectrum from p blocks ago, and
+ * its inverse transform's second half is the output for the block. So the
+ * cost per block is two FFTs plus one complex multiply-add per bin per
+ * partition: it depends on how long the response is, not what's in it, and
+ * there's no latency beyond the block itself.
+ *
+ * Spectra are kept split, real parts and imaginary parts in separate arrays of
+ * block + 1 bins, so that the multiply-add loop is a plain stream the compiler
+ * can vectorize. The FFTs are Pd's (mayer_realfft), which pack the spectrum
+ * differently; delay_conv_unpack and delay_conv_pack convert.
+ *
+ * This file is compiled into every class (it's in `common.sources`).
+ * */
+
+#include "simple_del_shared.h"
+
+void delay_conv_init(t_delay_conv *c)
+{
+  memset(c, 0, sizeof(*c));
+}
+
+void delay_conv_free(t_delay_conv *c)
+{
+  int nbins = c->c_block + 1;
+  if (c->c_alloc_parts > 0) {
+    freebytes(c->c_ir_re, c->c_alloc_parts * nbins * sizeof(t_sample));
+    freebytes(c->c_ir_im, c->c_alloc_parts * nbins * sizeof(t_sample));
+    freebytes(c->c_in_re, c->c_alloc_parts * nbins * sizeof(t_sample));
+    freebytes(c->c_in_im, c->c_alloc_parts * nbins * sizeof(t_sample));
+  }
+  if (c->c_block > 0) {
+    freebytes(c->c_acc_re, nbins * sizeof(t_sample));
+    freebytes(c->c_acc_im, nbins * sizeof(t_sample));
+    freebytes(c->c_time, 2 * c->c_block * sizeof(t_sample));
+  }
+  delay_conv_init(c);
+}
+
+int delay_conv_setup(t_delay_conv *c, int block, int length)
+{
+  int nparts = (length + block - 1) / block;
+  if (nparts < 1) nparts = 1;
+  if (block != c->c_block || nparts > c->c_alloc_parts) {
+    int nbins = block + 1;
+    delay_conv_free(c);
+    c->c_ir_re = (t_sample *)getbytes(nparts * nbins * sizeof(t_sample));
+    c->c_ir_im = (t_sample *)getbytes(nparts * nbins * sizeof(t_sample));
+    c->c_in_re = (t_sample *)getbytes(nparts * nbins * sizeof(t_sample));
+    c->c_in_im = (t_sample *)getbytes(nparts * nbins * sizeof(t_sample));
+    c->c_acc_re = (t_sample *)getbytes(nbins * sizeof(t_sample));
+    c->c_acc_im = (t_sample *)getbytes(nbins * sizeof(t_sample));
+    c->c_time = (t_sample *)getbytes(2 * block * sizeof(t_sample));
+    c->c_block = block;
+    c->c_alloc_parts = nparts;
+    if (!c->c_ir_re || !c->c_ir_im || !c->c_in_re || !c->c_in_im ||
+        !c->c_acc_re || !c->c_acc_im || !c->c_time) {
+      delay_conv_free(c);
+      return 0;
+    }
+  }
+  c->c_nparts = nparts;
+  c->c_head = 0;
+  return 1;
+}
+
+// mayer_realfft's packing (real parts in t[0 .. n/2], the imaginary part of
+// bin k in t[n - k]) to and from split arrays
+static void delay_conv_unpack(const t_sample *t, int block, t_sample *re, t_sample *im)
+{
+  int n = 2 * block;
+  re[0] = t[0];
+  im[0] = 0;
+  for (int k = 1; k < block; k++) {
+    re[k] = t[k];
+    im[k] = t[n - k];
+  }
+  re[block] = t[block];
+  im[block] = 0;
+}
+
+static void delay_conv_pack(const t_sample *re, const t_sample *im, int block, t_sample *t)
+{
+  int n = 2 * block;
+  t[0] = re[0];
+  for (int k = 1; k < block; k++) {
+    t[k] = re[k];
+    t[n - k] = im[k];
+  }
+  t[block] = re[block];
+}
+
+// the spectrum of the two blocks of `buffer` before `end`, into slot `slot` of
+// the delay line
+static void delay_conv_input(t_delay_conv *c, const t_sample *buffer, int mask, int end,
+                             int slot)
+{
+  int block = c->c_block, nbins = block + 1;
+  int start = end - 2 * block;
+  t_sample *t = c->c_time;
+  for (int i = 0; i < 2 * block; i++) t[i] = buffer[(start + i) & mask];
+  mayer_realfft(2 * block, t);
+  delay_conv_unpack(t, block, c->c_in_re + slot * nbins, c->c_in_im + slot * nbins);
+}
+
+void delay_conv_set_ir(t_delay_conv *c, const t_sample *ir, int length,
+                       const t_sample *buffer, int mask, int end)
+{
+  int block = c->c_block, nbins = block + 1, nparts = c->c_nparts;
+  t_sample *t = c->c_time;
+  // the inverse FFT comes back 2 * block times too big: take that out here,
+  // once, rather than from every output sample
+  t_sample scale = 1.0f / (2 * block);
+
+  for (int p = 0; p < nparts; p++) {
+    int from = p * block;
+    for (int i = 0; i < block; i++) {
+      t[i] = (from + i < length) ? ir[from + i] * scale : 0;
+    }
+    memset(t + block, 0, block * sizeof(t_sample));
+    mayer_realfft(2 * block, t);
+    delay_conv_unpack(t, block, c->c_ir_re + p * nbins, c->c_ir_im + p * nbins);
+  }
+
+  // fill the delay line from what's already in the buffer, so that the
+  // output carries straight on from whatever was reading it before. slot
+  // c_head is the block that ended at `end`; the oldest slot is about to be
+  // replaced by the next block, so it's left alone
+  c->c_head = 0;
+  for (int p = 0; p < nparts - 1; p++) {
+    delay_conv_input(c, buffer, mask, end - p * block, (nparts - p) % nparts);
+  }
+}
+
+t_sample *delay_conv_process(t_delay_conv *c, const t_sample *buffer, int mask, int end)
+{
+  int block = c->c_block, nbins = block + 1, nparts = c->c_nparts;
+  t_sample *acc_re = c->c_acc_re, *acc_im = c->c_acc_im;
+
+  c->c_head = (c->c_head + 1) % nparts;
+  delay_conv_input(c, buffer, mask, end, c->c_head);
+
+  memset(acc_re, 0, nbins * sizeof(t_sample));
+  memset(acc_im, 0, nbins * sizeof(t_sample));
+  for (int p = 0; p < nparts; p++) {
+    int slot = c->c_head - p;
+    if (slot < 0) slot += nparts;
+    const t_sample *xr = c->c_in_re + slot * nbins, *xi = c->c_in_im + slot * nbins;
+    const t_sample *hr = c->c_ir_re + p * nbins, *hi = c->c_ir_im + p * nbins;
+    for (int k = 0; k < nbins; k++) {
+      acc_re[k] += xr[k] * hr[k] - xi[k] * hi[k];
+      acc_im[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+  }
+
+  delay_conv_pack(acc_re, acc_im, block, c->c_time);
+  mayer_realifft(2 * block, c->c_time);
+  // the first half wrapped around: only the second half is a proper result
+  return c->c_time + block;
+}
@@ -0,0 +1,784 @@
+/* Multi-tap versions of cubic_interpolate (see simple_del_shared.h).
+ *
+ * multitap~ and the stereotaps objects read a handful of taps from the same
+ * buffer for every sample. Rather than calling cubic_interpolate once per tap,
+ * the perform routines collect the read positions and fractions for all the
+ * taps and hand them to one of the kernels below, which do 4 (SSE2) or 8 (AVX2)
+ * taps at a time. The stereo kernels do the same for buffers that hold both
+ * channels as interleaved frames, and the compact kernels for buffers of 16
+ * bit samples (see t_delay_format), converting the points to floats as
+ * they're loaded.
+ *
+ * The kernel is picked at runtime from what the CPU supports, so the objects
+ * can still be built for a baseline x86_64 (pd-lib-builder uses
+ * -march=core2). Anything that isn't x86 gets the scalar version. A double
+ * precision build (PD_FLOATSIZE=64) has kernels of its own, further down,
+ * that do 2 (SSE2) or 4 (AVX2) taps at a time, under the same names.
+ *
+ * This file is compiled into every class (it's in `common.sources`).
+ * */
+
+#include "simple_del_shared.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMPLE_DEL_X86 1
+#include <immintrin.h>
+#endif
+
+static void cubic_interpolate_taps_scalar(t_sample *buffer, int mask,
+                                          const int *phase, const t_sample *frac,
+                                          t_sample *out, int ntaps)
+{
+  for (int i = 0; i < ntaps; i++) {
+    out[i] = cubic_interpolate(buffer, phase[i], mask, frac[i]);
+  }
+}
+
+static void cubic_interpolate_taps_stereo_scalar(t_sample *buffer, int mask,
+                                                 const int *phase, const t_sample *frac,
+                                                 t_sample *out, int ntaps)
+{
+  for (int i = 0; i < ntaps; i++) {
+    t_sample *a = buffer + 2 * phase[i];
+    t_sample *b = buffer + 2 * ((phase[i] - 1) & mask);
+    t_sample *c = buffer + 2 * ((phase[i] - 2) & mask);
+    t_sample *d = buffer + 2 * ((phase[i] - 3) & mask);
+    out[2 * i] = cubic_points(a[0], b[0], c[0], d[0], frac[i]);
+    out[2 * i + 1] = cubic_points(a[1], b[1], c[1], d[1], frac[i]);
+  }
+}
+
+// the compact buffer is scaled once per tap, rather than once per point
+static void cubic_interpolate_taps_compact_scalar(const t_delay_compact *buffer, int mask,
+                                                  const int *phase, const t_sample *frac,
+                                                  t_sample scale, t_sample *out, int ntaps)
+{
+  for (int i = 0; i < ntaps; i++) {
+    int p = phase[i];
+    out[i] = scale * cubic_points(buffer[p], buffer[(p - 1) & mask], buffer[(p - 2) & mask],
+                                  buffer[(p - 3) & mask], frac[i]);
+  }
+}
+
+static void cubic_interpolate_taps_stereo_compact_scalar(const t_delay_compact *buffer,
+                                                         int mask, const int *phase,
+                                                         const t_sample *frac, t_sample scale,
+                                                         t_sample *out, int ntaps)
+{
+  for (int i = 0; i < ntaps; i++) {
+    const t_delay_compact *a = buffer + 2 * phase[i];
+    const t_delay_compact *b = buffer + 2 * ((phase[i] - 1) & mask);
+    const t_delay_compact *c = buffer + 2 * ((phase[i] - 2) & mask);
+    const t_delay_compact *d = buffer + 2 * ((phase[i] - 3) & mask);
+    out[2 * i] = scale * cubic_points(a[0], b[0], c[0], d[0], frac[i]);
+    out[2 * i + 1] = scale * cubic_points(a[1], b[1], c[1], d[1], frac[i]);
+  }
+}
+
+#if defined(SIMPLE_DEL_X86) && PD_FLOATSIZE == 32
+
+// cubic_points for four (or eight) sets of points at once
+__attribute__((target("sse2")))
+static inline __m128 sse2_cubic_points(__m128 a, __m128 b, __m128 c, __m128 d, __m128 f)
+{
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 three = _mm_set1_ps(3.0f);
+  const __m128 sixth = _mm_set1_ps(CUBIC_SIXTH);
+  __m128 cminusb = _mm_sub_ps(c, b);
+  // (d - a - 3 * cminusb) * frac + (d + 2 * a - 3 * b)
+  __m128 t = _mm_add_ps(
+      _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(d, a), _mm_mul_ps(three, cminusb)), f),
+      _mm_sub_ps(_mm_add_ps(d, _mm_mul_ps(two, a)), _mm_mul_ps(three, b)));
+  t = _mm_mul_ps(_mm_mul_ps(sixth, _mm_sub_ps(one, f)), t);
+  return _mm_add_ps(b, _mm_mul_ps(f, _mm_sub_ps(cminusb, t)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 avx2_cubic_points(__m256 a, __m256 b, __m256 c, __m256 d, __m256 f)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 three = _mm256_set1_ps(3.0f);
+  const __m256 sixth = _mm256_set1_ps(CUBIC_SIXTH);
+  __m256 cminusb = _mm256_sub_ps(c, b);
+  __m256 t = _mm256_add_ps(
+      _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(d, a), _mm256_mul_ps(three, cminusb)), f),
+      _mm256_sub_ps(_mm256_add_ps(d, _mm256_mul_ps(two, a)), _mm256_mul_ps(three, b)));
+  t = _mm256_mul_ps(_mm256_mul_ps(sixth, _mm256_sub_ps(one, f)), t);
+  return _mm256_add_ps(b, _mm256_mul_ps(f, _mm256_sub_ps(cminusb, t)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 avx2_join(__m128 lo, __m128 hi)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+/* No gathers in SSE2. Instead the four points of a tap, buffer[phase - 3] to
+ * buffer[phase], are fetched with a single unaligned load and four taps are
+ * transposed so that each register holds the same point (a, b, c or d) for
+ * every tap. Only a tap whose points wrap around the start of the buffer
+ * needs to be put together one sample at a time.
+ */
+__attribute__((target("sse2")))
+static inline __m128 sse2_tap_points(t_sample *buffer, int phase, int mask)
+{
+  if (phase >= 3) return _mm_loadu_ps(buffer + phase - 3);
+  return _mm_setr_ps(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask],
+                     buffer[(phase - 1) & mask], buffer[phase]);
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_sse2(t_sample *buffer, int mask,
+                                        const int *phase, const t_sample *frac,
+                                        t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    // after the transpose: d = buffer[phase - 3], ... a = buffer[phase]
+    __m128 d = sse2_tap_points(buffer, phase[i], mask);
+    __m128 c = sse2_tap_points(buffer, phase[i + 1], mask);
+    __m128 b = sse2_tap_points(buffer, phase[i + 2], mask);
+    __m128 a = sse2_tap_points(buffer, phase[i + 3], mask);
+    _MM_TRANSPOSE4_PS(d, c, b, a);
+    _mm_storeu_ps(out + i, sse2_cubic_points(a, b, c, d, _mm_loadu_ps(frac + i)));
+  }
+
+  cubic_interpolate_taps_scalar(buffer, mask, phase + i, frac + i, out + i, ntaps - i);
+}
+
+/* AVX2 does 8 taps at a time. The points are fetched the same way as for SSE2
+ * (two sets of four transposed taps, joined into 256 bit registers): on the
+ * CPUs we've measured that beats four _mm256_i32gather_ps calls.
+ */
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_avx2(t_sample *buffer, int mask,
+                                        const int *phase, const t_sample *frac,
+                                        t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 8 <= ntaps; i += 8) {
+    __m128 d0 = sse2_tap_points(buffer, phase[i], mask);
+    __m128 c0 = sse2_tap_points(buffer, phase[i + 1], mask);
+    __m128 b0 = sse2_tap_points(buffer, phase[i + 2], mask);
+    __m128 a0 = sse2_tap_points(buffer, phase[i + 3], mask);
+    __m128 d1 = sse2_tap_points(buffer, phase[i + 4], mask);
+    __m128 c1 = sse2_tap_points(buffer, phase[i + 5], mask);
+    __m128 b1 = sse2_tap_points(buffer, phase[i + 6], mask);
+    __m128 a1 = sse2_tap_points(buffer, phase[i + 7], mask);
+    _MM_TRANSPOSE4_PS(d0, c0, b0, a0);
+    _MM_TRANSPOSE4_PS(d1, c1, b1, a1);
+    _mm256_storeu_ps(out + i, avx2_cubic_points(avx2_join(a0, a1), avx2_join(b0, b1),
+                                                avx2_join(c0, c1), avx2_join(d0, d1),
+                                                _mm256_loadu_ps(frac + i)));
+  }
+
+  // 4 to 7 leftover taps are still worth a pass of the SSE2 kernel
+  cubic_interpolate_taps_sse2(buffer, mask, phase + i, frac + i, out + i, ntaps - i);
+}
+
+/* Stereo: the four frames of a tap, (left, right) at phase - 3 to phase, are
+ * eight samples in a row, fetched with two loads. Two taps fill a register
+ * with the same point for (left, right, left, right).
+ */
+__attribute__((target("sse2")))
+static inline void sse2_frame_points(t_sample *buffer, int phase, int mask,
+                                     __m128 *dc, __m128 *ba)
+{
+  if (phase >= 3) {
+    *dc = _mm_loadu_ps(buffer + 2 * (phase - 3));
+    *ba = _mm_loadu_ps(buffer + 2 * (phase - 1));
+  } else {
+    t_sample *a = buffer + 2 * phase;
+    t_sample *b = buffer + 2 * ((phase - 1) & mask);
+    t_sample *c = buffer + 2 * ((phase - 2) & mask);
+    t_sample *d = buffer + 2 * ((phase - 3) & mask);
+    *dc = _mm_setr_ps(d[0], d[1], c[0], c[1]);
+    *ba = _mm_setr_ps(b[0], b[1], a[0], a[1]);
+  }
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_stereo_sse2(t_sample *buffer, int mask,
+                                               const int *phase, const t_sample *frac,
+                                               t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    __m128 dc0, ba0, dc1, ba1;
+    sse2_frame_points(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_frame_points(buffer, phase[i + 1], mask, &dc1, &ba1);
+    __m128 d = _mm_movelh_ps(dc0, dc1);
+    __m128 c = _mm_movehl_ps(dc1, dc0);
+    __m128 b = _mm_movelh_ps(ba0, ba1);
+    __m128 a = _mm_movehl_ps(ba1, ba0);
+    // (f0, f0, f1, f1)
+    __m128 f = _mm_setr_ps(frac[i], frac[i], frac[i + 1], frac[i + 1]);
+    _mm_storeu_ps(out + 2 * i, sse2_cubic_points(a, b, c, d, f));
+  }
+
+  cubic_interpolate_taps_stereo_scalar(buffer, mask, phase + i, frac + i,
+                                       out + 2 * i, ntaps - i);
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_stereo_avx2(t_sample *buffer, int mask,
+                                               const int *phase, const t_sample *frac,
+                                               t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    __m128 dc0, ba0, dc1, ba1, dc2, ba2, dc3, ba3;
+    sse2_frame_points(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_frame_points(buffer, phase[i + 1], mask, &dc1, &ba1);
+    sse2_frame_points(buffer, phase[i + 2], mask, &dc2, &ba2);
+    sse2_frame_points(buffer, phase[i + 3], mask, &dc3, &ba3);
+    __m256 d = avx2_join(_mm_movelh_ps(dc0, dc1), _mm_movelh_ps(dc2, dc3));
+    __m256 c = avx2_join(_mm_movehl_ps(dc1, dc0), _mm_movehl_ps(dc3, dc2));
+    __m256 b = avx2_join(_mm_movelh_ps(ba0, ba1), _mm_movelh_ps(ba2, ba3));
+    __m256 a = avx2_join(_mm_movehl_ps(ba1, ba0), _mm_movehl_ps(ba3, ba2));
+    __m128 f4 = _mm_loadu_ps(frac + i);
+    __m256 f = avx2_join(_mm_unpacklo_ps(f4, f4), _mm_unpackhi_ps(f4, f4));
+    _mm256_storeu_ps(out + 2 * i, avx2_cubic_points(a, b, c, d, f));
+  }
+
+  cubic_interpolate_taps_stereo_sse2(buffer, mask, phase + i, frac + i,
+                                     out + 2 * i, ntaps - i);
+}
+
+/* Compact buffers. A tap's four points are 8 bytes, fetched with one 64 bit
+ * load and sign extended to 32 bit integers (each 16 bit sample is unpacked
+ * into the top of a 32 bit lane, then shifted back down), then converted to
+ * floats. From there it's the same transpose as above.
+ */
+__attribute__((target("sse2")))
+static inline __m128 sse2_widen(__m128i v)
+{
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 sse2_tap_points_compact(const t_delay_compact *buffer, int phase, int mask)
+{
+  if (phase >= 3) return sse2_widen(_mm_loadl_epi64((const __m128i *)(buffer + phase - 3)));
+  return _mm_setr_ps(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask],
+                     buffer[(phase - 1) & mask], buffer[phase]);
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_compact_sse2(const t_delay_compact *buffer, int mask,
+                                                const int *phase, const t_sample *frac,
+                                                t_sample scale, t_sample *out, int ntaps)
+{
+  __m128 s = _mm_set1_ps(scale);
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    __m128 d = sse2_tap_points_compact(buffer, phase[i], mask);
+    __m128 c = sse2_tap_points_compact(buffer, phase[i + 1], mask);
+    __m128 b = sse2_tap_points_compact(buffer, phase[i + 2], mask);
+    __m128 a = sse2_tap_points_compact(buffer, phase[i + 3], mask);
+    _MM_TRANSPOSE4_PS(d, c, b, a);
+    _mm_storeu_ps(out + i, _mm_mul_ps(s, sse2_cubic_points(a, b, c, d, _mm_loadu_ps(frac + i))));
+  }
+
+  cubic_interpolate_taps_compact_scalar(buffer, mask, phase + i, frac + i, scale, out + i,
+                                        ntaps - i);
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_compact_avx2(const t_delay_compact *buffer, int mask,
+                                                const int *phase, const t_sample *frac,
+                                                t_sample scale, t_sample *out, int ntaps)
+{
+  __m256 s = _mm256_set1_ps(scale);
+  int i = 0;
+
+  for (; i + 8 <= ntaps; i += 8) {
+    __m128 d0 = sse2_tap_points_compact(buffer, phase[i], mask);
+    __m128 c0 = sse2_tap_points_compact(buffer, phase[i + 1], mask);
+    __m128 b0 = sse2_tap_points_compact(buffer, phase[i + 2], mask);
+    __m128 a0 = sse2_tap_points_compact(buffer, phase[i + 3], mask);
+    __m128 d1 = sse2_tap_points_compact(buffer, phase[i + 4], mask);
+    __m128 c1 = sse2_tap_points_compact(buffer, phase[i + 5], mask);
+    __m128 b1 = sse2_tap_points_compact(buffer, phase[i + 6], mask);
+    __m128 a1 = sse2_tap_points_compact(buffer, phase[i + 7], mask);
+    _MM_TRANSPOSE4_PS(d0, c0, b0, a0);
+    _MM_TRANSPOSE4_PS(d1, c1, b1, a1);
+    __m256 y = avx2_cubic_points(avx2_join(a0, a1), avx2_join(b0, b1), avx2_join(c0, c1),
+                                 avx2_join(d0, d1), _mm256_loadu_ps(frac + i));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(s, y));
+  }
+
+  cubic_interpolate_taps_compact_sse2(buffer, mask, phase + i, frac + i, scale, out + i,
+                                      ntaps - i);
+}
+
+// four (left, right) frames are 16 bytes: one load, widened in two halves
+__attribute__((target("sse2")))
+static inline void sse2_frame_points_compact(const t_delay_compact *buffer, int phase, int mask,
+                                             __m128 *dc, __m128 *ba)
+{
+  if (phase >= 3) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(buffer + 2 * (phase - 3)));
+    *dc = sse2_widen(v);
+    *ba = sse2_widen(_mm_unpackhi_epi64(v, v));
+  } else {
+    const t_delay_compact *a = buffer + 2 * phase;
+    const t_delay_compact *b = buffer + 2 * ((phase - 1) & mask);
+    const t_delay_compact *c = buffer + 2 * ((phase - 2) & mask);
+    const t_delay_compact *d = buffer + 2 * ((phase - 3) & mask);
+    *dc = _mm_setr_ps(d[0], d[1], c[0], c[1]);
+    *ba = _mm_setr_ps(b[0], b[1], a[0], a[1]);
+  }
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_stereo_compact_sse2(const t_delay_compact *buffer,
+                                                       int mask, const int *phase,
+                                                       const t_sample *frac, t_sample scale,
+                                                       t_sample *out, int ntaps)
+{
+  __m128 s = _mm_set1_ps(scale);
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    __m128 dc0, ba0, dc1, ba1;
+    sse2_frame_points_compact(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_frame_points_compact(buffer, phase[i + 1], mask, &dc1, &ba1);
+    __m128 d = _mm_movelh_ps(dc0, dc1);
+    __m128 c = _mm_movehl_ps(dc1, dc0);
+    __m128 b = _mm_movelh_ps(ba0, ba1);
+    __m128 a = _mm_movehl_ps(ba1, ba0);
+    __m128 f = _mm_setr_ps(frac[i], frac[i], frac[i + 1], frac[i + 1]);
+    _mm_storeu_ps(out + 2 * i, _mm_mul_ps(s, sse2_cubic_points(a, b, c, d, f)));
+  }
+
+  cubic_interpolate_taps_stereo_compact_scalar(buffer, mask, phase + i, frac + i, scale,
+                                               out + 2 * i, ntaps - i);
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_stereo_compact_avx2(const t_delay_compact *buffer,
+                                                       int mask, const int *phase,
+                                                       const t_sample *frac, t_sample scale,
+                                                       t_sample *out, int ntaps)
+{
+  __m256 s = _mm256_set1_ps(scale);
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    __m128 dc0, ba0, dc1, ba1, dc2, ba2, dc3, ba3;
+    sse2_frame_points_compact(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_frame_points_compact(buffer, phase[i + 1], mask, &dc1, &ba1);
+    sse2_frame_points_compact(buffer, phase[i + 2], mask, &dc2, &ba2);
+    sse2_frame_points_compact(buffer, phase[i + 3], mask, &dc3, &ba3);
+    __m256 d = avx2_join(_mm_movelh_ps(dc0, dc1), _mm_movelh_ps(dc2, dc3));
+    __m256 c = avx2_join(_mm_movehl_ps(dc1, dc0), _mm_movehl_ps(dc3, dc2));
+    __m256 b = avx2_join(_mm_movelh_ps(ba0, ba1), _mm_movelh_ps(ba2, ba3));
+    __m256 a = avx2_join(_mm_movehl_ps(ba1, ba0), _mm_movehl_ps(ba3, ba2));
+    __m128 f4 = _mm_loadu_ps(frac + i);
+    __m256 f = avx2_join(_mm_unpacklo_ps(f4, f4), _mm_unpackhi_ps(f4, f4));
+    _mm256_storeu_ps(out + 2 * i, _mm256_mul_ps(s, avx2_cubic_points(a, b, c, d, f)));
+  }
+
+  cubic_interpolate_taps_stereo_compact_sse2(buffer, mask, phase + i, frac + i, scale,
+                                             out + 2 * i, ntaps - i);
+}
+
+#elif defined(SIMPLE_DEL_X86)
+
+/* The same kernels for a double precision build. A register holds half as
+ * many samples, so SSE2 does 2 taps at a time and AVX2 4. A mono tap's four
+ * points are 32 bytes: two loads for SSE2, one for AVX2, and then the same
+ * sort of transpose as for floats. A stereo frame is one 128 bit register,
+ * so the stereo kernels just load the four frames of a tap one by one.
+ */
+__attribute__((target("sse2")))
+static inline __m128d sse2_cubic_points(__m128d a, __m128d b, __m128d c, __m128d d, __m128d f)
+{
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d two = _mm_set1_pd(2.0);
+  const __m128d three = _mm_set1_pd(3.0);
+  const __m128d sixth = _mm_set1_pd(CUBIC_SIXTH);
+  __m128d cminusb = _mm_sub_pd(c, b);
+  __m128d t = _mm_add_pd(
+      _mm_mul_pd(_mm_sub_pd(_mm_sub_pd(d, a), _mm_mul_pd(three, cminusb)), f),
+      _mm_sub_pd(_mm_add_pd(d, _mm_mul_pd(two, a)), _mm_mul_pd(three, b)));
+  t = _mm_mul_pd(_mm_mul_pd(sixth, _mm_sub_pd(one, f)), t);
+  return _mm_add_pd(b, _mm_mul_pd(f, _mm_sub_pd(cminusb, t)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d avx2_cubic_points(__m256d a, __m256d b, __m256d c, __m256d d, __m256d f)
+{
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d three = _mm256_set1_pd(3.0);
+  const __m256d sixth = _mm256_set1_pd(CUBIC_SIXTH);
+  __m256d cminusb = _mm256_sub_pd(c, b);
+  __m256d t = _mm256_add_pd(
+      _mm256_mul_pd(_mm256_sub_pd(_mm256_sub_pd(d, a), _mm256_mul_pd(three, cminusb)), f),
+      _mm256_sub_pd(_mm256_add_pd(d, _mm256_mul_pd(two, a)), _mm256_mul_pd(three, b)));
+  t = _mm256_mul_pd(_mm256_mul_pd(sixth, _mm256_sub_pd(one, f)), t);
+  return _mm256_add_pd(b, _mm256_mul_pd(f, _mm256_sub_pd(cminusb, t)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d avx2_join(__m128d lo, __m128d hi)
+{
+  return _mm256_insertf128_pd(_mm256_castpd128_pd256(lo), hi, 1);
+}
+
+// (buffer[phase - 3], buffer[phase - 2]) and (buffer[phase - 1], buffer[phase])
+__attribute__((target("sse2")))
+static inline void sse2_tap_points(t_sample *buffer, int phase, int mask,
+                                   __m128d *dc, __m128d *ba)
+{
+  if (phase >= 3) {
+    *dc = _mm_loadu_pd(buffer + phase - 3);
+    *ba = _mm_loadu_pd(buffer + phase - 1);
+  } else {
+    *dc = _mm_setr_pd(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask]);
+    *ba = _mm_setr_pd(buffer[(phase - 1) & mask], buffer[phase]);
+  }
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_sse2(t_sample *buffer, int mask,
+                                        const int *phase, const t_sample *frac,
+                                        t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    __m128d dc0, ba0, dc1, ba1;
+    sse2_tap_points(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_tap_points(buffer, phase[i + 1], mask, &dc1, &ba1);
+    __m128d d = _mm_unpacklo_pd(dc0, dc1);
+    __m128d c = _mm_unpackhi_pd(dc0, dc1);
+    __m128d b = _mm_unpacklo_pd(ba0, ba1);
+    __m128d a = _mm_unpackhi_pd(ba0, ba1);
+    _mm_storeu_pd(out + i, sse2_cubic_points(a, b, c, d, _mm_loadu_pd(frac + i)));
+  }
+
+  cubic_interpolate_taps_scalar(buffer, mask, phase + i, frac + i, out + i, ntaps - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d avx2_tap_points(t_sample *buffer, int phase, int mask)
+{
+  if (phase >= 3) return _mm256_loadu_pd(buffer + phase - 3);
+  return _mm256_setr_pd(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask],
+                        buffer[(phase - 1) & mask], buffer[phase]);
+}
+
+// rows (d, c, b, a) of four taps to a register per point
+__attribute__((target("avx2")))
+static inline void avx2_transpose4(__m256d *r0, __m256d *r1, __m256d *r2, __m256d *r3)
+{
+  __m256d db01 = _mm256_unpacklo_pd(*r0, *r1); // (d0, d1, b0, b1)
+  __m256d ca01 = _mm256_unpackhi_pd(*r0, *r1);
+  __m256d db23 = _mm256_unpacklo_pd(*r2, *r3);
+  __m256d ca23 = _mm256_unpackhi_pd(*r2, *r3);
+  *r0 = _mm256_permute2f128_pd(db01, db23, 0x20);
+  *r1 = _mm256_permute2f128_pd(ca01, ca23, 0x20);
+  *r2 = _mm256_permute2f128_pd(db01, db23, 0x31);
+  *r3 = _mm256_permute2f128_pd(ca01, ca23, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_avx2(t_sample *buffer, int mask,
+                                        const int *phase, const t_sample *frac,
+                                        t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    __m256d d = avx2_tap_points(buffer, phase[i], mask);
+    __m256d c = avx2_tap_points(buffer, phase[i + 1], mask);
+    __m256d b = avx2_tap_points(buffer, phase[i + 2], mask);
+    __m256d a = avx2_tap_points(buffer, phase[i + 3], mask);
+    avx2_transpose4(&d, &c, &b, &a);
+    _mm256_storeu_pd(out + i, avx2_cubic_points(a, b, c, d, _mm256_loadu_pd(frac + i)));
+  }
+
+  cubic_interpolate_taps_sse2(buffer, mask, phase + i, frac + i, out + i, ntaps - i);
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_stereo_sse2(t_sample *buffer, int mask,
+                                               const int *phase, const t_sample *frac,
+                                               t_sample *out, int ntaps)
+{
+  for (int i = 0; i < ntaps; i++) {
+    int p = phase[i];
+    __m128d a = _mm_loadu_pd(buffer + 2 * p);
+    __m128d b = _mm_loadu_pd(buffer + 2 * ((p - 1) & mask));
+    __m128d c = _mm_loadu_pd(buffer + 2 * ((p - 2) & mask));
+    __m128d d = _mm_loadu_pd(buffer + 2 * ((p - 3) & mask));
+    _mm_storeu_pd(out + 2 * i, sse2_cubic_points(a, b, c, d, _mm_set1_pd(frac[i])));
+  }
+}
+
+__attribute__((target("avx2")))
+static inline __m256d avx2_frames(t_sample *buffer, int p0, int p1)
+{
+  return avx2_join(_mm_loadu_pd(buffer + 2 * p0), _mm_loadu_pd(buffer + 2 * p1));
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_stereo_avx2(t_sample *buffer, int mask,
+                                               const int *phase, const t_sample *frac,
+                                               t_sample *out, int ntaps)
+{
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    int p0 = phase[i], p1 = phase[i + 1];
+    __m256d a = avx2_frames(buffer, p0, p1);
+    __m256d b = avx2_frames(buffer, (p0 - 1) & mask, (p1 - 1) & mask);
+    __m256d c = avx2_frames(buffer, (p0 - 2) & mask, (p1 - 2) & mask);
+    __m256d d = avx2_frames(buffer, (p0 - 3) & mask, (p1 - 3) & mask);
+    __m256d f = _mm256_setr_pd(frac[i], frac[i], frac[i + 1], frac[i + 1]);
+    _mm256_storeu_pd(out + 2 * i, avx2_cubic_points(a, b, c, d, f));
+  }
+
+  cubic_interpolate_taps_stereo_sse2(buffer, mask, phase + i, frac + i,
+                                     out + 2 * i, ntaps - i);
+}
+
+/* Compact buffers: the 16 bit points are sign extended to 32 bit integers
+ * as for floats, and each pair of those converted to doubles.
+ */
+__attribute__((target("sse2")))
+static inline __m128i sse2_widen32(__m128i v)
+{
+  return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+__attribute__((target("sse2")))
+static inline void sse2_tap_points_compact(const t_delay_compact *buffer, int phase, int mask,
+                                           __m128d *dc, __m128d *ba)
+{
+  if (phase >= 3) {
+    __m128i v = sse2_widen32(_mm_loadl_epi64((const __m128i *)(buffer + phase - 3)));
+    *dc = _mm_cvtepi32_pd(v);
+    *ba = _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v));
+  } else {
+    *dc = _mm_setr_pd(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask]);
+    *ba = _mm_setr_pd(buffer[(phase - 1) & mask], buffer[phase]);
+  }
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_compact_sse2(const t_delay_compact *buffer, int mask,
+                                                const int *phase, const t_sample *frac,
+                                                t_sample scale, t_sample *out, int ntaps)
+{
+  __m128d s = _mm_set1_pd(scale);
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    __m128d dc0, ba0, dc1, ba1;
+    sse2_tap_points_compact(buffer, phase[i], mask, &dc0, &ba0);
+    sse2_tap_points_compact(buffer, phase[i + 1], mask, &dc1, &ba1);
+    __m128d d = _mm_unpacklo_pd(dc0, dc1);
+    __m128d c = _mm_unpackhi_pd(dc0, dc1);
+    __m128d b = _mm_unpacklo_pd(ba0, ba1);
+    __m128d a = _mm_unpackhi_pd(ba0, ba1);
+    _mm_storeu_pd(out + i, _mm_mul_pd(s, sse2_cubic_points(a, b, c, d, _mm_loadu_pd(frac + i))));
+  }
+
+  cubic_interpolate_taps_compact_scalar(buffer, mask, phase + i, frac + i, scale, out + i,
+                                        ntaps - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d avx2_tap_points_compact(const t_delay_compact *buffer, int phase, int mask)
+{
+  if (phase >= 3) {
+    return _mm256_cvtepi32_pd(sse2_widen32(_mm_loadl_epi64((const __m128i *)(buffer + phase - 3))));
+  }
+  return _mm256_setr_pd(buffer[(phase - 3) & mask], buffer[(phase - 2) & mask],
+                        buffer[(phase - 1) & mask], buffer[phase]);
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_compact_avx2(const t_delay_compact *buffer, int mask,
+                                                const int *phase, const t_sample *frac,
+                                                t_sample scale, t_sample *out, int ntaps)
+{
+  __m256d s = _mm256_set1_pd(scale);
+  int i = 0;
+
+  for (; i + 4 <= ntaps; i += 4) {
+    __m256d d = avx2_tap_points_compact(buffer, phase[i], mask);
+    __m256d c = avx2_tap_points_compact(buffer, phase[i + 1], mask);
+    __m256d b = avx2_tap_points_compact(buffer, phase[i + 2], mask);
+    __m256d a = avx2_tap_points_compact(buffer, phase[i + 3], mask);
+    avx2_transpose4(&d, &c, &b, &a);
+    __m256d y = avx2_cubic_points(a, b, c, d, _mm256_loadu_pd(frac + i));
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(s, y));
+  }
+
+  cubic_interpolate_taps_compact_sse2(buffer, mask, phase + i, frac + i, scale, out + i,
+                                      ntaps - i);
+}
+
+// a (left, right) frame of a compact buffer as two doubles
+__attribute__((target("sse2")))
+static inline __m128d sse2_frame_compact(const t_delay_compact *buffer, int p)
+{
+  return _mm_setr_pd(buffer[2 * p], buffer[2 * p + 1]);
+}
+
+__attribute__((target("sse2")))
+static void cubic_interpolate_taps_stereo_compact_sse2(const t_delay_compact *buffer,
+                                                       int mask, const int *phase,
+                                                       const t_sample *frac, t_sample scale,
+                                                       t_sample *out, int ntaps)
+{
+  __m128d s = _mm_set1_pd(scale);
+
+  for (int i = 0; i < ntaps; i++) {
+    int p = phase[i];
+    __m128d a = sse2_frame_compact(buffer, p);
+    __m128d b = sse2_frame_compact(buffer, (p - 1) & mask);
+    __m128d c = sse2_frame_compact(buffer, (p - 2) & mask);
+    __m128d d = sse2_frame_compact(buffer, (p - 3) & mask);
+    __m128d y = sse2_cubic_points(a, b, c, d, _mm_set1_pd(frac[i]));
+    _mm_storeu_pd(out + 2 * i, _mm_mul_pd(s, y));
+  }
+}
+
+// four frames in a row, 16 bytes: one load, widened to (d, c) and (b, a)
+__attribute__((target("avx2")))
+static inline void avx2_frame_points_compact(const t_delay_compact *buffer, int phase, int mask,
+                                             __m256d *dc, __m256d *ba)
+{
+  if (phase >= 3) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(buffer + 2 * (phase - 3)));
+    *dc = _mm256_cvtepi32_pd(sse2_widen32(v));
+    *ba = _mm256_cvtepi32_pd(sse2_widen32(_mm_unpackhi_epi64(v, v)));
+  } else {
+    const t_delay_compact *a = buffer + 2 * phase;
+    const t_delay_compact *b = buffer + 2 * ((phase - 1) & mask);
+    const t_delay_compact *c = buffer + 2 * ((phase - 2) & mask);
+    const t_delay_compact *d = buffer + 2 * ((phase - 3) & mask);
+    *dc = _mm256_setr_pd(d[0], d[1], c[0], c[1]);
+    *ba = _mm256_setr_pd(b[0], b[1], a[0], a[1]);
+  }
+}
+
+__attribute__((target("avx2")))
+static void cubic_interpolate_taps_stereo_compact_avx2(const t_delay_compact *buffer,
+                                                       int mask, const int *phase,
+                                                       const t_sample *frac, t_sample scale,
+                                                       t_sample *out, int ntaps)
+{
+  __m256d s = _mm256_set1_pd(scale);
+  int i = 0;
+
+  for (; i + 2 <= ntaps; i += 2) {
+    __m256d dc0, ba0, dc1, ba1;
+    avx2_frame_points_compact(buffer, phase[i], mask, &dc0, &ba0);
+    avx2_frame_points_compact(buffer, phase[i + 1], mask, &dc1, &ba1);
+    __m256d d = _mm256_permute2f128_pd(dc0, dc1, 0x20);
+    __m256d c = _mm256_permute2f128_pd(dc0, dc1, 0x31);
+    __m256d b = _mm256_permute2f128_pd(ba0, ba1, 0x20);
+    __m256d a = _mm256_permute2f128_pd(ba0, ba1, 0x31);
+    __m256d f = _mm256_setr_pd(frac[i], frac[i], frac[i + 1], frac[i + 1]);
+    _mm256_storeu_pd(out + 2 * i, _mm256_mul_pd(s, avx2_cubic_points(a, b, c, d, f)));
+  }
+
+  cubic_interpolate_taps_stereo_compact_sse2(buffer, mask, phase + i, frac + i, scale,
+                                             out + 2 * i, ntaps - i);
+}
+
+#endif /* SIMPLE_DEL_X86 */
+
+typedef struct _simple_del_kernel
+{
+  const char *k_name;
+  t_cubic_taps_fn k_cubic_taps;
+  t_cubic_taps_fn k_cubic_taps_stereo;
+  t_cubic_taps_compact_fn k_cubic_taps_compact;
+  t_cubic_taps_compact_fn k_cubic_taps_stereo_compact;
+} t_simple_del_kernel;
+
+static const t_simple_del_kernel simple_del_kernels[] = {
+  {"scalar", cubic_interpolate_taps_scalar, cubic_interpolate_taps_stereo_scalar,
+   cubic_interpolate_taps_compact_scalar, cubic_interpolate_taps_stereo_compact_scalar},
+#ifdef SIMPLE_DEL_X86
+  {"sse2", cubic_interpolate_taps_sse2, cubic_interpolate_taps_stereo_sse2,
+   cubic_interpolate_taps_compact_sse2, cubic_interpolate_taps_stereo_compact_sse2},
+  {"avx2", cubic_interpolate_taps_avx2, cubic_interpolate_taps_stereo_avx2,
+   cubic_interpolate_taps_compact_avx2, cubic_interpolate_taps_stereo_compact_avx2},
+#endif
+};
+
+#define SIMPLE_DEL_NKERNELS \
+  ((int)(sizeof(simple_del_kernels) / sizeof(simple_del_kernels[0])))
+
+t_cubic_taps_fn cubic_interpolate_taps = cubic_interpolate_taps_scalar;
+t_cubic_taps_fn cubic_interpolate_taps_stereo = cubic_interpolate_taps_stereo_scalar;
+t_cubic_taps_compact_fn cubic_interpolate_taps_compact = cubic_interpolate_taps_compact_scalar;
+t_cubic_taps_compact_fn cubic_interpolate_taps_stereo_compact =
+  cubic_interpolate_taps_stereo_compact_scalar;
+static const char *simple_del_kernel_name = "scalar";
+
+#ifdef SIMPLE_DEL_BENCH
+// not a kernel, but another code path the bench picks (simple_del_shared.h)
+int delay_block_passes = 1;
+#endif
+
+static int simple_del_kernel_supported(const char *name)
+{
+  if (!strcmp(name, "scalar")) return 1;
+#ifdef SIMPLE_DEL_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "sse2")) return __builtin_cpu_supports("sse2");
+  if (!strcmp(name, "avx2")) return __builtin_cpu_supports("avx2");
+#endif
+  return 0;
+}
+
+int simple_del_kernels_select(const char *name)
+{
+  for (int i = 0; i < SIMPLE_DEL_NKERNELS; i++) {
+    if (!strcmp(simple_del_kernels[i].k_name, name)) {
+      if (!simple_del_kernel_supported(name)) return 0;
+      cubic_interpolate_taps = simple_del_kernels[i].k_cubic_taps;
+      cubic_interpolate_taps_stereo = simple_del_kernels[i].k_cubic_taps_stereo;
+      cubic_interpolate_taps_compact = simple_del_kernels[i].k_cubic_taps_compact;
+      cubic_interpolate_taps_stereo_compact = simple_del_kernels[i].k_cubic_taps_stereo_compact;
+      simple_del_kernel_name = simple_del_kernels[i].k_name;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void simple_del_kernels_init(void)
+{
+  static int initialized = 0;
+  if (initialized) return;
+  initialized = 1;
+
+  // the list is in order of preference, last one wins
+  for (int i = 0; i < SIMPLE_DEL_NKERNELS; i++) {
+    simple_del_kernels_select(simple_del_kernels[i].k_name);
+  }
+}
+
+const char *simple_del_kernels_name(void)
+{
+  return simple_del_kernel_name;
+}
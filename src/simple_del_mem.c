@@ -0,0 +1,629 @@
+/* Memory for delay buffers (see delay_mem_alloc in simple_del_shared.h).
+ *
+ * getbytes() gives no promise about alignment, and a buffer of a few
+ * megabytes ends up on 4 KiB pages. A multitap~ with its taps spread over
+ * seconds of buffer then touches a different page with nearly every tap, and
+ * each of those wants a TLB entry of its own. So delay buffers come from here
+ * instead:
+ *
+ *   - every buffer starts on a 64 byte boundary, a cache line
+ *   - a buffer of DELAY_MEM_HUGE bytes or more is mapped on its own, on 2 MiB
+ *     pages: explicit huge pages if the system has some set aside
+ *     (vm.nr_hugepages), otherwise a normal mapping with madvise(MADV_HUGEPAGE)
+ *     so that the kernel backs it with transparent huge pages where it can
+ *   - if neither works, or on a system without them, it's the heap, still
+ *     aligned
+ *
+ * Mapped buffers are kept in a list (s_maps), anything else came from the
+ * heap. `bufinfo` reports which it is.
+ *
+ * A fresh mapping is all zero pages that the kernel only fills in when
+ * they're first written, which for a delay line is the write head's first
+ * pass through the buffer, in the audio callback, a page fault at a time.
+ * `prefault 1` has every mapped buffer written to as it's allocated or
+ * grown, here, which is always outside the perform routines (a DSP rebuild
+ * or a message). `prefault 2` also locks them into memory with mlock, so
+ * that they can't be paged out later; to lock the small buffers on their own
+ * pages, they get a mapping of their own too while it's on. It's a setting
+ * for the whole process: mlock counts against the process's RLIMIT_MEMLOCK
+ * (`ulimit -l`), and failing that a buffer is kept, just not locked. Heap
+ * buffers don't need prefaulting: they're zeroed with memset, which touches
+ * every page anyway. The ones already on the heap when `prefault 2` arrives
+ * stay unlocked, until they're next resized.
+ * Mapped buffers that already exist when `prefault 1` arrives are only
+ * faulted in where the kernel has MADV_POPULATE_WRITE (Linux 5.14): they may
+ * be in use, see delay_mem_touch.
+ *
+ * Further down, the arena that delay2~, multitap~ and stereotaps~ take their
+ * smaller buffers from, a pool per patch (delay_arena_alloc).
+ *
+ * This file is compiled into every class (it's in `common.sources`), and
+ * pd-lib-builder makes each class a binary of its own, each with its own copy
+ * of the code. What the code keeps (the `prefault` mode, the list of mappings
+ * and the arenas) is there once per process all the same: it lives in a
+ * hidden object bound to a symbol, which the first class to need it makes and
+ * the others find (delay_mem_state). So `prefault 2` sent to a multitap~
+ * settles the delay2~ buffers too, and a delay2~ and a multitap~ in the same
+ * patch cut their blocks from the same arena.
+ * */
+
+#include "simple_del_shared.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define DELAY_MEM_MMAP 1
+#endif
+
+enum {
+  DELAY_MEM_HEAP,
+  DELAY_MEM_PAGES,
+  DELAY_MEM_THP,
+  DELAY_MEM_HUGETLB
+};
+
+static void *delay_mem_heap(size_t bytes)
+{
+  void *p;
+#ifdef _WIN32
+  p = _aligned_malloc(bytes, DELAY_MEM_ALIGN);
+#else
+  if (posix_memalign(&p, DELAY_MEM_ALIGN, bytes)) p = NULL;
+#endif
+  if (p) memset(p, 0, bytes);
+  return p;
+}
+
+static void delay_mem_heap_free(void *p)
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+/* A mapped buffer starts right at the start of its first huge page, with no
+ * room for a header (one in front would push a power of two sized buffer into
+ * one more huge page), so they're kept in a list to know how to free them.
+ * There are only ever a few, and the list is only looked at when a buffer is
+ * resized or freed.
+ */
+typedef struct _delay_mem_map
+{
+  void *m_base;
+  size_t m_len;
+  int m_backing;
+  int m_locked;
+  struct _delay_mem_map *m_next;
+} t_delay_mem_map;
+
+/* Everything kept here, bound to DELAY_MEM_STATE. The name has a version in
+ * it, to be bumped whenever this struct or the ones it points to change:
+ * classes from two different releases loaded side by side then each keep
+ * their own. An arena's chunks can end up freed by another class than the one
+ * that allocated them, so they all go through the allocator of whichever class
+ * made the state (on Windows each binary may have a C runtime heap of its own).
+ */
+#define DELAY_MEM_STATE "#simple_del-mem-1"
+
+typedef struct _delay_mem_state
+{
+  t_pd s_pd;
+  int s_prefault; // 0 leaves new pages to the kernel, 1 prefaults them, 2 prefaults and locks
+  t_delay_mem_map *s_maps;
+  t_delay_arena *s_arenas;
+  size_t s_pool_live, s_pool_peak; // all the arenas together
+  void *(*s_chunk_alloc)(size_t bytes);
+  void (*s_chunk_free)(void *p, size_t bytes);
+} t_delay_mem_state;
+
+static t_class *delay_mem_state_class;
+// for when something else already has the name: this class keeps its own
+static t_delay_mem_state delay_mem_private;
+
+// only ever called from the main thread, so nothing can come between the
+// look and the bind
+static t_delay_mem_state *delay_mem_state(void)
+{
+  t_symbol *s = gensym(DELAY_MEM_STATE);
+  t_delay_mem_state *st;
+  if (s->s_thing) {
+    if (!strcmp(class_getname(*s->s_thing), DELAY_MEM_STATE)) {
+      return (t_delay_mem_state *)s->s_thing;
+    }
+    st = &delay_mem_private;
+  } else {
+    if (!delay_mem_state_class) {
+      delay_mem_state_class = class_new(gensym(DELAY_MEM_STATE), 0, 0,
+                                        sizeof(t_delay_mem_state), CLASS_PD, A_NULL);
+    }
+    st = (t_delay_mem_state *)pd_new(delay_mem_state_class);
+    pd_bind(&st->s_pd, s);
+  }
+  if (!st->s_chunk_alloc) {
+    st->s_chunk_alloc = delay_mem_alloc;
+    st->s_chunk_free = delay_mem_free;
+  }
+  return st;
+}
+
+static t_delay_mem_map *delay_mem_findmap(const void *p)
+{
+  t_delay_mem_map *m;
+  for (m = delay_mem_state()->s_maps; m; m = m->m_next) {
+    if (m->m_base == p) return m;
+  }
+  return NULL;
+}
+
+#ifdef DELAY_MEM_MMAP
+// `len` bytes (a multiple of DELAY_MEM_HUGE) on huge pages, explicit or
+// transparent, starting on a huge page boundary. NULL if neither is to be had.
+// fresh mappings are zeroed
+static void *delay_mem_map_huge(size_t len, int *backing)
+{
+  char *base;
+#ifdef MAP_HUGETLB
+  base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (base != MAP_FAILED) {
+    *backing = DELAY_MEM_HUGETLB;
+    return base;
+  }
+#endif
+#ifdef MADV_HUGEPAGE
+  // mmap only promises page alignment: ask for a huge page more than needed
+  // and give back what's either side of the aligned part
+  size_t slack = DELAY_MEM_HUGE;
+  base = mmap(NULL, len + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) return NULL;
+  char *start = (char *)(((uintptr_t)base + DELAY_MEM_HUGE - 1) & ~(uintptr_t)(DELAY_MEM_HUGE - 1));
+  if (start > base) munmap(base, start - base);
+  if (start + len < base + len + slack) munmap(start + len, base + slack - start);
+  if (!madvise(start, len, MADV_HUGEPAGE)) {
+    *backing = DELAY_MEM_THP;
+    return start;
+  }
+  // no transparent huge pages in this kernel: the heap does just as well
+  munmap(start, len);
+#endif
+  (void)len;
+  (void)backing;
+  return NULL;
+}
+
+// faults in every page of a mapping. MADV_POPULATE_WRITE does that in one go
+// without writing anything, on kernels that have it. Otherwise a byte of each
+// page gets rewritten, which is only safe while no one else can see the
+// mapping: a helper thread (`thread 1`) writing the buffer between the read
+// and the write would have its sample put back. So a mapping that's already
+// in use (`fresh` not set) is left to fault in as it's written
+static void delay_mem_touch(char *p, size_t len, int fresh)
+{
+#ifdef MADV_POPULATE_WRITE
+  if (!madvise(p, len, MADV_POPULATE_WRITE)) return;
+#endif
+  if (!fresh) return;
+  for (size_t i = 0; i < len; i += 4096) {
+    volatile char *v = p + i;
+    *v = *v;
+  }
+}
+
+// brings a mapping in line with the prefault mode. `fresh` is set for a
+// mapping just made, that nothing has a pointer to yet. returns 0 if it
+// should have been locked and couldn't be
+static int delay_mem_settle(t_delay_mem_map *m, int fresh)
+{
+  int mode = delay_mem_state()->s_prefault;
+  if (mode >= 2 && !m->m_locked) {
+    // mlock faults the pages in as well
+    m->m_locked = !mlock(m->m_base, m->m_len);
+    if (m->m_locked) return 1;
+  } else if (mode < 2 && m->m_locked) {
+    munlock(m->m_base, m->m_len);
+    m->m_locked = 0;
+  }
+  if (mode >= 1 && m->m_backing != DELAY_MEM_HUGETLB) {
+    // (hugetlb pages are there from the start)
+    delay_mem_touch(m->m_base, m->m_len, fresh);
+  }
+  return mode < 2 || m->m_locked;
+}
+
+// a buffer of its own: on huge pages if it's big enough, otherwise (only
+// while locking) on normal pages, so that locking it doesn't lock part of
+// something else on the heap
+static void *delay_mem_map(size_t bytes)
+{
+  t_delay_mem_state *st = delay_mem_state();
+  size_t len;
+  int backing;
+  void *p;
+  if (bytes >= DELAY_MEM_HUGE) {
+    len = (bytes + DELAY_MEM_HUGE - 1) / DELAY_MEM_HUGE * DELAY_MEM_HUGE;
+    p = delay_mem_map_huge(len, &backing);
+  } else if (st->s_prefault >= 2) {
+    len = (bytes + 4095) & ~(size_t)4095;
+    backing = DELAY_MEM_PAGES;
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) p = NULL;
+  } else {
+    return NULL;
+  }
+  if (!p) return NULL;
+
+  t_delay_mem_map *m = (t_delay_mem_map *)getbytes(sizeof(t_delay_mem_map));
+  if (!m) {
+    munmap(p, len);
+    return NULL;
+  }
+  m->m_base = p;
+  m->m_len = len;
+  m->m_backing = backing;
+  m->m_locked = 0;
+  m->m_next = st->s_maps;
+  st->s_maps = m;
+  if (!delay_mem_settle(m, 1)) {
+    pd_error(0, "delay buffer of %lu bytes couldn't be locked into memory "
+             "(see ulimit -l)", (unsigned long)len);
+  }
+  return p;
+}
+#endif
+
+void *delay_mem_alloc(size_t bytes)
+{
+#ifdef DELAY_MEM_MMAP
+  void *p = delay_mem_map(bytes);
+  if (p) return p;
+#endif
+  return delay_mem_heap(bytes);
+}
+
+void delay_mem_free(void *p, size_t bytes)
+{
+  t_delay_mem_map **mp;
+  (void)bytes;
+  if (!p) return;
+  for (mp = &delay_mem_state()->s_maps; *mp; mp = &(*mp)->m_next) {
+    if ((*mp)->m_base == p) {
+      t_delay_mem_map *m = *mp;
+      *mp = m->m_next;
+#ifdef DELAY_MEM_MMAP
+      munmap(m->m_base, m->m_len);
+#endif
+      freebytes(m, sizeof(t_delay_mem_map));
+      return;
+    }
+  }
+  delay_mem_heap_free(p);
+}
+
+void *delay_mem_resize(void *p, size_t bytes, size_t newbytes)
+{
+  if (!p) return delay_mem_alloc(newbytes);
+  t_delay_mem_map *m = delay_mem_findmap(p);
+
+  // a mapping with room to spare (it's rounded up to whole pages) is kept, as
+  // long as the buffer would still get the same sort of mapping. what's
+  // zeroed here is already faulted in, or locked along with the rest
+  if (m && newbytes <= m->m_len &&
+      (newbytes >= DELAY_MEM_HUGE) == (m->m_backing != DELAY_MEM_PAGES)) {
+    if (newbytes > bytes) memset((char *)p + bytes, 0, newbytes - bytes);
+    return p;
+  }
+
+  void *q = delay_mem_alloc(newbytes);
+  if (!q) return NULL;
+  memcpy(q, p, bytes < newbytes ? bytes : newbytes);
+  delay_mem_free(p, bytes);
+  return q;
+}
+
+void delay_mem_prefault(const void *owner, t_floatarg mode)
+{
+  t_delay_mem_state *st = delay_mem_state();
+  int n = (mode < 0) ? 0 : (mode > 2) ? 2 : (int)mode;
+#ifdef DELAY_MEM_MMAP
+  t_delay_mem_map *m;
+  int failed = 0;
+  st->s_prefault = n;
+  // the buffers there already
+  for (m = st->s_maps; m; m = m->m_next) {
+    if (!delay_mem_settle(m, 0)) failed++;
+  }
+  if (failed) {
+    pd_error(owner, "%d delay buffers couldn't be locked into memory (see ulimit -l)", failed);
+  }
+#else
+  if (n >= 2) {
+    pd_error(owner, "locking delay buffers into memory isn't supported on this system");
+    n = 1;
+  }
+  st->s_prefault = n;
+#endif
+}
+
+/* The arena (delay2~, multitap~ and stereotaps~).
+ *
+ * A patch with thousands of delay lines would otherwise have thousands of
+ * separate blocks, each grown by doubling with a fresh allocation every time,
+ * scattered over the heap between whatever else Pd allocated meanwhile. Here
+ * the buffers of a patch are cut from chunks of its own, one sub-arena per
+ * toplevel canvas (subpatches and abstractions share their root's, as do all
+ * the classes), so the lines of one patch sit together. The chunks are
+ * delay_mem buffers themselves. An arena's first is DELAY_POOL_FIRST bytes,
+ * so that a patch with a few short delays in it doesn't tie up much more than
+ * they need, and each after that twice the one before, up to DELAY_POOL_CHUNK,
+ * which is a huge page: a patch with a lot of buffer ends up mostly on those.
+ * Blocks are powers of two in size, from DELAY_POOL_MIN to DELAY_POOL_MAX
+ * bytes, which is what the power of two rings want anyway; a freed block goes
+ * on its arena's free list for its size, for the next buffer of that size to
+ * use. Nothing is coalesced: the chunks go back when the last object using
+ * the patch's arena is freed. Anything bigger than DELAY_POOL_MAX gets a
+ * delay_mem buffer of its own, as before.
+ *
+ * Like the rest of this file, it's only used from Pd's main thread.
+ */
+#define DELAY_POOL_MINSHIFT 10
+#define DELAY_POOL_MAXSHIFT 20
+#define DELAY_POOL_MIN ((size_t)1 << DELAY_POOL_MINSHIFT)
+#define DELAY_POOL_MAX ((size_t)1 << DELAY_POOL_MAXSHIFT)
+#define DELAY_POOL_CLASSES (DELAY_POOL_MAXSHIFT - DELAY_POOL_MINSHIFT + 1)
+#define DELAY_POOL_FIRST ((size_t)64 << 10)
+#define DELAY_POOL_CHUNK ((size_t)DELAY_MEM_HUGE)
+
+typedef struct _delay_chunk
+{
+  char *c_base;
+  size_t c_size;
+  size_t c_used; // blocks are cut from the front, this far so far
+  struct _delay_chunk *c_next;
+} t_delay_chunk;
+
+struct _delay_arena
+{
+  t_glist *a_root; // the toplevel canvas
+  int a_users; // objects holding on to it
+  t_delay_chunk *a_chunks; // newest first: blocks are cut from this one
+  void *a_free[DELAY_POOL_CLASSES]; // freed blocks, linked by their first word
+  int a_nfree[DELAY_POOL_CLASSES];
+  size_t a_live; // bytes of blocks in use
+  size_t a_asked; // what was asked for, out of a_live
+  size_t a_peak; // most a_live has been
+  int a_nchunks;
+  size_t a_held; // bytes in chunks
+  struct _delay_arena *a_next;
+};
+
+// g_canvas.h
+t_glist *canvas_getrootfor(t_glist *x);
+
+// the size class for `bytes`, or -1 if it's too big for the pool
+static int delay_pool_class(size_t bytes)
+{
+  int k = 0;
+  if (bytes > DELAY_POOL_MAX) return -1;
+  while ((DELAY_POOL_MIN << k) < bytes) k++;
+  return k;
+}
+
+static t_delay_chunk *delay_arena_chunkof(const t_delay_arena *a, const void *p)
+{
+  t_delay_chunk *c;
+  if (!a) return NULL;
+  for (c = a->a_chunks; c; c = c->c_next) {
+    if ((const char *)p >= c->c_base && (const char *)p < c->c_base + c->c_size) return c;
+  }
+  return NULL;
+}
+
+static void delay_arena_push(t_delay_arena *a, int k, void *p)
+{
+  *(void **)p = a->a_free[k];
+  a->a_free[k] = p;
+  a->a_nfree[k]++;
+}
+
+// a new chunk to cut from, with room for a `need` byte block at least. what's
+// left at the end of the old one goes on the free lists, in the biggest blocks
+// that fit (it's a multiple of DELAY_POOL_MIN, as all the chunks and blocks
+// are)
+static t_delay_chunk *delay_arena_newchunk(t_delay_arena *a, size_t need)
+{
+  t_delay_chunk *old = a->a_chunks;
+  size_t size = old ? 2 * old->c_size : DELAY_POOL_FIRST;
+  if (size > DELAY_POOL_CHUNK) size = DELAY_POOL_CHUNK;
+  while (size < need) size *= 2;
+  t_delay_chunk *c = (t_delay_chunk *)getbytes(sizeof(t_delay_chunk));
+  if (!c) return NULL;
+  c->c_base = (char *)delay_mem_state()->s_chunk_alloc(size);
+  if (!c->c_base) {
+    freebytes(c, sizeof(t_delay_chunk));
+    return NULL;
+  }
+  c->c_size = size;
+  c->c_used = 0;
+  if (old) {
+    for (int k = DELAY_POOL_CLASSES - 1; k >= 0; k--) {
+      size_t size = DELAY_POOL_MIN << k;
+      while (old->c_size - old->c_used >= size) {
+        delay_arena_push(a, k, old->c_base + old->c_used);
+        old->c_used += size;
+      }
+    }
+  }
+  c->c_next = old;
+  a->a_chunks = c;
+  a->a_nchunks++;
+  a->a_held += c->c_size;
+  return c;
+}
+
+t_delay_arena *delay_arena_get(void)
+{
+  t_delay_mem_state *st = delay_mem_state();
+  t_glist *root = canvas_getcurrent();
+  t_delay_arena *a;
+  if (root) root = canvas_getrootfor(root);
+  for (a = st->s_arenas; a; a = a->a_next) {
+    if (a->a_root == root) break;
+  }
+  if (!a) {
+    a = (t_delay_arena *)getbytes(sizeof(t_delay_arena));
+    if (!a) return NULL; // the buffers will just come from delay_mem_alloc
+    memset(a, 0, sizeof(t_delay_arena));
+    a->a_root = root;
+    a->a_next = st->s_arenas;
+    st->s_arenas = a;
+  }
+  a->a_users++;
+  return a;
+}
+
+void delay_arena_release(t_delay_arena *a)
+{
+  t_delay_arena **ap;
+  if (!a || --a->a_users > 0) return;
+  t_delay_mem_state *st = delay_mem_state();
+  while (a->a_chunks) {
+    t_delay_chunk *c = a->a_chunks;
+    a->a_chunks = c->c_next;
+    st->s_chunk_free(c->c_base, c->c_size);
+    freebytes(c, sizeof(t_delay_chunk));
+  }
+  for (ap = &st->s_arenas; *ap != a; ap = &(*ap)->a_next) ;
+  *ap = a->a_next;
+  freebytes(a, sizeof(t_delay_arena));
+}
+
+void *delay_arena_alloc(t_delay_arena *a, size_t bytes)
+{
+  int k = delay_pool_class(bytes);
+  if (!a || k < 0) return delay_mem_alloc(bytes);
+  size_t size = DELAY_POOL_MIN << k;
+  char *p = a->a_free[k];
+  if (p) {
+    a->a_free[k] = *(void **)p;
+    a->a_nfree[k]--;
+    memset(p, 0, bytes);
+  } else {
+    t_delay_chunk *c = a->a_chunks;
+    if (!c || c->c_size - c->c_used < size) {
+      c = delay_arena_newchunk(a, size);
+      // no chunk to be had: a buffer of its own, if even that
+      if (!c) return delay_mem_alloc(bytes);
+    }
+    p = c->c_base + c->c_used;
+    c->c_used += size;
+  }
+  a->a_live += size;
+  a->a_asked += bytes;
+  if (a->a_live > a->a_peak) a->a_peak = a->a_live;
+  t_delay_mem_state *st = delay_mem_state();
+  st->s_pool_live += size;
+  if (st->s_pool_live > st->s_pool_peak) st->s_pool_peak = st->s_pool_live;
+  return p;
+}
+
+void delay_arena_free(t_delay_arena *a, void *p, size_t bytes)
+{
+  if (!p) return;
+  if (!delay_arena_chunkof(a, p)) {
+    delay_mem_free(p, bytes);
+    return;
+  }
+  int k = delay_pool_class(bytes);
+  delay_arena_push(a, k, p);
+  a->a_live -= DELAY_POOL_MIN << k;
+  a->a_asked -= bytes;
+  delay_mem_state()->s_pool_live -= DELAY_POOL_MIN << k;
+}
+
+void *delay_arena_resize(t_delay_arena *a, void *p, size_t bytes, size_t newbytes)
+{
+  if (!p) return delay_arena_alloc(a, newbytes);
+  int k = delay_pool_class(newbytes);
+  if (delay_arena_chunkof(a, p)) {
+    // still the same size of block: nothing to move
+    if (k == delay_pool_class(bytes)) {
+      if (newbytes > bytes) memset((char *)p + bytes, 0, newbytes - bytes);
+      a->a_asked = a->a_asked - bytes + newbytes;
+      return p;
+    }
+  } else if (!a || k < 0) {
+    return delay_mem_resize(p, bytes, newbytes);
+  }
+  void *q = delay_arena_alloc(a, newbytes);
+  if (!q) return NULL;
+  memcpy(q, p, bytes < newbytes ? bytes : newbytes);
+  delay_arena_free(a, p, bytes);
+  return q;
+}
+
+void delay_arena_post(const char *name, const t_delay_arena *a)
+{
+  const t_delay_mem_state *st = delay_mem_state();
+  const t_delay_arena *b;
+  size_t total = 0;
+  int narenas = 0;
+  for (b = st->s_arenas; b; b = b->a_next) {
+    narenas++;
+    total += b->a_held;
+  }
+  if (a) {
+    size_t held = a->a_held;
+    size_t freed = 0;
+    for (int k = 0; k < DELAY_POOL_CLASSES; k++) freed += (DELAY_POOL_MIN << k) * a->a_nfree[k];
+    size_t tail = a->a_chunks ? a->a_chunks->c_size - a->a_chunks->c_used : 0;
+    post("%s: patch arena of %d objects: %d chunks (%lu bytes), %lu bytes in use (peak %lu)",
+         name, a->a_users, a->a_nchunks, (unsigned long)held, (unsigned long)a->a_live,
+         (unsigned long)a->a_peak);
+    // free blocks are what a different size of buffer can't use; the rounding
+    // up to a power of two is what a buffer doesn't use of its block
+    post("%s: %lu bytes in free blocks, %lu never used, fragmentation %.1f%%, "
+         "rounding %.1f%%", name, (unsigned long)freed, (unsigned long)tail,
+         held ? 100.0 * freed / held : 0.0,
+         a->a_live ? 100.0 * (a->a_live - a->a_asked) / a->a_live : 0.0);
+  } else {
+    post("%s: not using an arena", name);
+  }
+  post("%s: all arenas: %d patches, %lu bytes in chunks, %lu in use (peak %lu)", name,
+       narenas, (unsigned long)total, (unsigned long)st->s_pool_live,
+       (unsigned long)st->s_pool_peak);
+}
+
+void delay_mem_post(const char *name, const void *buf, size_t bytes, const void *inline_buf)
+{
+  const char *backing;
+  if (!buf) {
+    post("%s: no buffer", name);
+    return;
+  }
+  if (buf == inline_buf) {
+    post("%s: %lu bytes, inside the object", name, (unsigned long)bytes);
+    return;
+  }
+  for (const t_delay_arena *a = delay_mem_state()->s_arenas; a; a = a->a_next) {
+    if (delay_arena_chunkof(a, buf)) {
+      post("%s: %lu bytes, in a %lu byte block of the patch's arena", name,
+           (unsigned long)bytes, (unsigned long)(DELAY_POOL_MIN << delay_pool_class(bytes)));
+      return;
+    }
+  }
+  t_delay_mem_map *m = delay_mem_findmap(buf);
+  switch (m ? m->m_backing : DELAY_MEM_HEAP) {
+    case DELAY_MEM_HUGETLB: backing = "2 MiB pages (hugetlb)"; break;
+    case DELAY_MEM_THP: backing = "transparent huge pages (madvise)"; break;
+    case DELAY_MEM_PAGES: backing = "4 KiB pages"; break;
+    default: backing = "heap"; break;
+  }
+  post("%s: %lu bytes, %d byte aligned, %s%s", name, (unsigned long)bytes, DELAY_MEM_ALIGN,
+       backing, (m && m->m_locked) ? ", locked" : "");
+}
@@ -18,17 +18,89 @@
 #define SIMPLE_DEL_SHARED_H
 
 #include "m_pd.h"
+#include <string.h>
+#include <stdint.h>
 
 #define XTRASAMPS 4
 #define SAMPBLK 4
 
+// samples of buffer kept inside the object itself, so that a short delay
+// needs no memory of its own (see delay_buffer_resize). a power of two
+#define DELAY_INLINE_SAMPLES 512
+
+/* Per-instance timing of the perform routines, see simple_del_stats.c. Only
+ * built with SIMPLE_DEL_STATS defined (the Makefile does that unless it's run
+ * with `stats=no`); without it there's no `stats` message, no info outlet and
+ * nothing added to the DSP chain.
+ */
+#ifdef SIMPLE_DEL_STATS
+// log-spaced: 4 buckets per power of two of clock ticks
+#define DELAY_STATS_BUCKETS 256
+
+typedef struct _delay_stats
+{
+  uint64_t s_start; // clock at the start of the current block
+  uint64_t s_total; // ticks over s_blocks blocks
+  uint64_t s_max;
+  unsigned int s_blocks;
+  double s_block_ns; // length of a block of audio, the budget
+  unsigned int s_hist[DELAY_STATS_BUCKETS];
+} t_delay_stats;
+
+void delay_stats_init(t_delay_stats *st);
+// around the object's own dsp_add: times everything added in between
+void delay_stats_dsp_begin(t_delay_stats *st, int n, t_float sr);
+void delay_stats_dsp_end(t_delay_stats *st);
+// `stats avg p99 max budget blocks` out of `out`, then starts counting again
+void delay_stats_output(t_delay_stats *st, t_outlet *out);
+
+#define DELAY_STATS_DSP_BEGIN(st, n, sr) delay_stats_dsp_begin(st, n, sr)
+#define DELAY_STATS_DSP_END(st) delay_stats_dsp_end(st)
+#else
+#define DELAY_STATS_DSP_BEGIN(st, n, sr)
+#define DELAY_STATS_DSP_END(st)
+#endif
+
+/* How a delay buffer stores its samples: as t_sample, or with `compact`, as
+ * 16 bit integers (see delay_compact_encode). Long delays spend most of their
+ * time waiting on memory, and 16 bit samples halve both the memory and the
+ * traffic of every read and write. The range is per buffer: a sample v is
+ * kept as v * 32767 / range, so anything up to +-range fits, 96 dB or so
+ * above the rounding, and anything louder is clipped.
+ */
+typedef struct _delay_format
+{
+  int f_compact;
+  t_sample f_gain; // sample to stored value, 32767 / range
+  t_sample f_scale; // and back again
+} t_delay_format;
+
+typedef int16_t t_delay_compact;
+#define DELAY_COMPACT_FULL 32767.0f
+
+// `range` 0 (or less) for t_sample, else 16 bit samples up to +-range
+static inline void delay_format_set(t_delay_format *fmt, t_float range)
+{
+  fmt->f_compact = (range > 0);
+  fmt->f_gain = (range > 0) ? DELAY_COMPACT_FULL / range : 1;
+  fmt->f_scale = (range > 0) ? range / DELAY_COMPACT_FULL : 1;
+}
+
 // core structure that manages the delay buffer. used by both delwrite and
 // delread
 typedef struct simple_delwritectl
 {
   int c_n; // size of the delay buffer in samples
-  t_sample *c_vec; // pointer to delay buffer: allocated with getbytes(XTRASAMPS * sizeof(t_sample))
+  int c_alloc; // samples allocated (not counting XTRASAMPS), c_n of them in use
+  t_sample *c_vec; // pointer to delay buffer: c_inline, or from delay_mem_alloc
+  // t_samples in the block at c_vec, which a `compact` that couldn't shrink it
+  // leaves bigger than c_format needs
+  int c_words;
   int c_phase; // current write position in the buffer
+  // c_vec holds t_delay_compact samples when c_format.f_compact is set. the
+  // readers look at it every block
+  t_delay_format c_format;
+  t_sample c_inline[DELAY_INLINE_SAMPLES + XTRASAMPS]; // c_vec, while it fits
 } t_simple_delwritectl;
 
 typedef struct _simple_delwrite
@@ -42,24 +114,1056 @@ typedef struct _simple_delwrite
   int x_vecsize; /* vector size for delread~ to use */
   t_float x_sr; /* system samplerate? */
   t_float x_f;
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
 } t_simple_delwrite;
 
 t_simple_delwrite *simple_delwrite_findbyname(t_symbol *s);
 void simple_delwrite_update(t_simple_delwrite *x);
 void simple_delwrite_check(t_simple_delwrite *x, int vecsize, t_float sr);
 
-static inline t_sample cubic_interpolate(t_sample *buffer, int phase, int mask, t_sample frac)
+/* 1/6 at the width of t_sample. 0.1666667f is only 1/6 to 7 digits, which a
+ * double precision build (PD_FLOATSIZE=64) would carry into every read; a
+ * cast of a double expression is worked out by the compiler, so it costs
+ * nothing in either build. The other constants in the interpolators (1, 2,
+ * 3, 0.5) are exact as floats.
+ */
+#define CUBIC_SIXTH ((t_sample)(1.0 / 6.0))
+
+// a is the newest of the four points, d the oldest
+static inline t_sample cubic_points(t_sample a, t_sample b, t_sample c, t_sample d,
+                                    t_sample frac)
 {
-  t_sample a = buffer[phase];
-  t_sample b = buffer[(phase - 1) & mask];
-  t_sample c = buffer[(phase - 2) & mask];
-  t_sample d = buffer[(phase - 3) & mask];
   t_sample cminusb = c - b;
 
   return b + frac * (
-      cminusb - 0.1666667f * (1.0f - frac) * (
+      cminusb - CUBIC_SIXTH * (1.0f - frac) * (
           (d - a - 3.0f * cminusb) * frac + (d + 2.0f * a - 3.0f * b)
       )
   );
 }
+
+static inline t_sample cubic_interpolate(t_sample *buffer, int phase, int mask, t_sample frac)
+{
+  return cubic_points(buffer[phase], buffer[(phase - 1) & mask],
+                      buffer[(phase - 2) & mask], buffer[(phase - 3) & mask], frac);
+}
+
+/* The same interpolation written as four weights, for when the fraction stays
+ * the same over a whole block: w_a * a + w_b * b + w_c * c + w_d * d gives the
+ * same result as cubic_interpolate.
+ */
+typedef struct _cubic_weights
+{
+  t_sample w_a;
+  t_sample w_b;
+  t_sample w_c;
+  t_sample w_d;
+} t_cubic_weights;
+
+static inline void cubic_weights(t_sample frac, t_cubic_weights *w)
+{
+  t_sample g = CUBIC_SIXTH * frac * (1.0f - frac);
+  w->w_a = g * (frac - 2.0f);
+  w->w_b = 1.0f - frac - g * (3.0f * frac - 3.0f);
+  w->w_c = frac + 3.0f * frac * g;
+  w->w_d = -g * (frac + 1.0f);
+}
+
+// `p` points at buffer[phase]. the caller makes sure phase >= 3
+static inline t_sample cubic_apply(const t_sample *p, const t_cubic_weights *w)
+{
+  return w->w_a * p[0] + w->w_b * p[-1] + w->w_c * p[-2] + w->w_d * p[-3];
+}
+
+static inline t_sample cubic_apply_masked(const t_sample *buffer, int phase, int mask,
+                                          const t_cubic_weights *w)
+{
+  return w->w_a * buffer[phase] + w->w_b * buffer[(phase - 1) & mask] +
+    w->w_c * buffer[(phase - 2) & mask] + w->w_d * buffer[(phase - 3) & mask];
+}
+
+/* The interpolation family. delay2~ and multitap~ take an `interp` creation
+ * argument and message that picks one of these:
+ *
+ *   none      the older of the two samples either side, i.e. the delay
+ *             rounded down to a whole sample (what delay1~ does)
+ *   linear    a straight line between them
+ *   cubic     4-point, 3rd order, as vd~ does (the default). This is the
+ *             4-point Lagrange polynomial
+ *   lagrange  6-point, 5th order Lagrange, centred on the same two samples.
+ *             Needs a delay of at least 2 samples rather than 1
+ *   allpass   1st order allpass (Thiran). Flat magnitude response, so good
+ *             for static echoes in a feedback loop, but it has a state per
+ *             read position and smears delay changes over a few samples
+ *   sinc      8-point windowed sinc from a table (see simple_del_sinc.c),
+ *             for modulated delays: chorus, flanging, pitch shifting. Needs
+ *             a delay of at least 3 samples
+ *
+ * All of them read the same way as cubic_interpolate: `phase` is the newest of
+ * cubic's four points, frac = 0 is buffer[phase - 1] and frac = 1 is
+ * buffer[phase - 2].
+ *
+ * Each object builds one perform routine per mode from a body written once
+ * (see DELAY_INTERP_PERFORM_TABLE) and hands dsp_add the one for its mode, so
+ * the choice costs nothing per sample.
+ */
+enum {
+  DELAY_INTERP_NONE,
+  DELAY_INTERP_LINEAR,
+  DELAY_INTERP_CUBIC,
+  DELAY_INTERP_LAGRANGE,
+  DELAY_INTERP_ALLPASS,
+  DELAY_INTERP_SINC,
+  DELAY_INTERP_COUNT
+};
+
+static const char *const delay_interp_names[DELAY_INTERP_COUNT] = {
+  "none", "linear", "cubic", "lagrange", "allpass", "sinc"
+};
+
+// the mode called `s`, or -1
+static inline int delay_interp_find(const t_symbol *s)
+{
+  for (int i = 0; i < DELAY_INTERP_COUNT; i++) {
+    if (!strcmp(s->s_name, delay_interp_names[i])) return i;
+  }
+  return -1;
+}
+
+#if defined(__GNUC__)
+#define DELAY_INTERP_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define DELAY_INTERP_INLINE static __forceinline
+#else
+#define DELAY_INTERP_INLINE static inline
+#endif
+
+// how far a mode reads from buffer[phase]: `older` samples back (so phase
+// must be at least that in a buffer read without a mask), `newer` forward
+DELAY_INTERP_INLINE int delay_interp_older(const int mode)
+{
+  switch (mode) {
+    case DELAY_INTERP_NONE: return 1;
+    case DELAY_INTERP_LINEAR: return 2;
+    case DELAY_INTERP_ALLPASS: return 2;
+    case DELAY_INTERP_LAGRANGE: return 4;
+    case DELAY_INTERP_SINC: return 5;
+    default: return 3;
+  }
+}
+
+DELAY_INTERP_INLINE int delay_interp_newer(const int mode)
+{
+  switch (mode) {
+    case DELAY_INTERP_LAGRANGE: return 1;
+    case DELAY_INTERP_SINC: return 2;
+    default: return 0;
+  }
+}
+
+// the shortest delay, in samples, a mode can read without reaching a sample
+// that hasn't been written yet
+DELAY_INTERP_INLINE t_sample delay_interp_min(const int mode)
+{
+  switch (mode) {
+    case DELAY_INTERP_LAGRANGE: return 2.00001f;
+    case DELAY_INTERP_SINC: return 3.00001f;
+    default: return 1.00001f;
+  }
+}
+
+/* The sinc table: a windowed sinc cut into DELAY_SINC_PHASES fractions of a
+ * sample, DELAY_SINC_TAPS points each, plus one more row for frac = 1 so that
+ * neighbouring rows can be mixed without wrapping. Built once by
+ * delay_sinc_init() and only ever read after that, so every instance shares
+ * it. Row entry m is the weight of buffer[phase - 5 + m], oldest first, so a
+ * row lines up with the points as they sit in the buffer.
+ */
+#define DELAY_SINC_TAPS 8
+#define DELAY_SINC_PHASES 512
+
+extern t_sample delay_sinc_table[(DELAY_SINC_PHASES + 1) * DELAY_SINC_TAPS];
+
+// call from the setup function of any class that reads with sinc. safe to
+// call more than once
+void delay_sinc_init(void);
+
+#if PD_FLOATSIZE == 32 && \
+    (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define DELAY_SINC_SSE 1
+#include <xmmintrin.h>
+#elif PD_FLOATSIZE == 64 && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+// two doubles to a register
+#define DELAY_SINC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// the weights for `frac`, mixed from the two nearest rows of the table
+DELAY_INTERP_INLINE void delay_sinc_coefs(t_sample frac, t_sample *w)
+{
+  t_sample pos = frac * DELAY_SINC_PHASES;
+  int row = (int)pos;
+  if (row < 0) row = 0;
+  if (row > DELAY_SINC_PHASES - 1) row = DELAY_SINC_PHASES - 1;
+  t_sample t = pos - (t_sample)row;
+  const t_sample *r0 = delay_sinc_table + row * DELAY_SINC_TAPS;
+  const t_sample *r1 = r0 + DELAY_SINC_TAPS;
+#ifdef DELAY_SINC_SSE
+  __m128 tt = _mm_set1_ps(t);
+  __m128 lo = _mm_loadu_ps(r0), hi = _mm_loadu_ps(r0 + 4);
+  _mm_storeu_ps(w, _mm_add_ps(lo, _mm_mul_ps(tt, _mm_sub_ps(_mm_loadu_ps(r1), lo))));
+  _mm_storeu_ps(w + 4, _mm_add_ps(hi, _mm_mul_ps(tt, _mm_sub_ps(_mm_loadu_ps(r1 + 4), hi))));
+#elif defined(DELAY_SINC_SSE2)
+  __m128d tt = _mm_set1_pd(t);
+  for (int m = 0; m < DELAY_SINC_TAPS; m += 2) {
+    __m128d a = _mm_loadu_pd(r0 + m);
+    _mm_storeu_pd(w + m, _mm_add_pd(a, _mm_mul_pd(tt, _mm_sub_pd(_mm_loadu_pd(r1 + m), a))));
+  }
+#else
+  for (int m = 0; m < DELAY_SINC_TAPS; m++) w[m] = r0[m] + t * (r1[m] - r0[m]);
+#endif
+}
+
+// the weights from delay_sinc_coefs against DELAY_SINC_TAPS points in a row
+DELAY_INTERP_INLINE t_sample delay_sinc_dot(const t_sample *p, const t_sample *w)
+{
+#ifdef DELAY_SINC_SSE
+  __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p), _mm_loadu_ps(w)),
+                          _mm_mul_ps(_mm_loadu_ps(p + 4), _mm_loadu_ps(w + 4)));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+#elif defined(DELAY_SINC_SSE2)
+  __m128d sum = _mm_mul_pd(_mm_loadu_pd(p), _mm_loadu_pd(w));
+  for (int m = 2; m < DELAY_SINC_TAPS; m += 2) {
+    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(p + m), _mm_loadu_pd(w + m)));
+  }
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+#else
+  t_sample sum = 0;
+  for (int m = 0; m < DELAY_SINC_TAPS; m++) sum += p[m] * w[m];
+  return sum;
+#endif
+}
+
+/* Whatever a mode can work out from the fraction alone, for when the fraction
+ * stays the same over a block. For cubic these are the weights from
+ * cubic_weights.
+ */
+typedef struct _interp_coefs
+{
+  t_sample k_w[DELAY_SINC_TAPS];
+  int k_shift; // allpass: read one sample newer
+} t_interp_coefs;
+
+DELAY_INTERP_INLINE void delay_interp_coefs(const int mode, t_sample frac, t_interp_coefs *k)
+{
+  switch (mode) {
+    case DELAY_INTERP_NONE:
+      break;
+    case DELAY_INTERP_LINEAR:
+      k->k_w[0] = frac;
+      break;
+    case DELAY_INTERP_CUBIC: {
+      t_cubic_weights w;
+      cubic_weights(frac, &w);
+      k->k_w[0] = w.w_a;
+      k->k_w[1] = w.w_b;
+      k->k_w[2] = w.w_c;
+      k->k_w[3] = w.w_d;
+      break;
+    }
+    case DELAY_INTERP_LAGRANGE: {
+      // the Lagrange basis polynomials for points at -2 ... 3, frac being the
+      // distance from point 0 (buffer[phase - 1]) towards point 1
+      t_sample xp2 = frac + 2, xp1 = frac + 1, x0 = frac;
+      t_sample xm1 = frac - 1, xm2 = frac - 2, xm3 = frac - 3;
+      t_sample lo = xp2 * xp1; // products of the factors from either end
+      t_sample hi = xm2 * xm3;
+      k->k_w[0] = xp1 * x0 * xm1 * hi * (t_sample)(-1.0 / 120.0);
+      k->k_w[1] = xp2 * x0 * xm1 * hi * (t_sample)(1.0 / 24.0);
+      k->k_w[2] = lo * xm1 * hi * (t_sample)(-1.0 / 12.0);
+      k->k_w[3] = lo * x0 * hi * (t_sample)(1.0 / 12.0);
+      k->k_w[4] = lo * x0 * xm1 * xm3 * (t_sample)(-1.0 / 24.0);
+      k->k_w[5] = lo * x0 * xm1 * xm2 * (t_sample)(1.0 / 120.0);
+      break;
+    }
+    case DELAY_INTERP_ALLPASS: {
+      // keeps the fractional part of the delay in [0.5, 1.5), where the
+      // filter's phase delay is flattest, by reading a sample newer when
+      // frac < 0.5
+      int shift = frac < 0.5f;
+      t_sample d = frac + shift;
+      k->k_shift = shift;
+      k->k_w[0] = (1.0f - d) / (1.0f + d);
+      break;
+    }
+    case DELAY_INTERP_SINC:
+      delay_sinc_coefs(frac, k->k_w);
+      break;
+  }
+}
+
+// reads with coefficients from delay_interp_coefs. `state` is only used by
+// allpass: one per read position, starting at 0
+DELAY_INTERP_INLINE t_sample delay_interp_apply(const int mode, const t_sample *buffer,
+                                                int phase, int mask, const t_interp_coefs *k,
+                                                t_sample *state)
+{
+  switch (mode) {
+    case DELAY_INTERP_NONE:
+      return buffer[(phase - 1) & mask];
+    case DELAY_INTERP_LINEAR: {
+      t_sample b = buffer[(phase - 1) & mask];
+      return b + k->k_w[0] * (buffer[(phase - 2) & mask] - b);
+    }
+    case DELAY_INTERP_LAGRANGE:
+      return k->k_w[0] * buffer[(phase + 1) & mask] + k->k_w[1] * buffer[phase & mask] +
+        k->k_w[2] * buffer[(phase - 1) & mask] + k->k_w[3] * buffer[(phase - 2) & mask] +
+        k->k_w[4] * buffer[(phase - 3) & mask] + k->k_w[5] * buffer[(phase - 4) & mask];
+    case DELAY_INTERP_ALLPASS: {
+      int p = phase + k->k_shift;
+      t_sample eta = k->k_w[0];
+      t_sample y = eta * buffer[(p - 1) & mask] + buffer[(p - 2) & mask] - eta * *state;
+      *state = y;
+      return y;
+    }
+    case DELAY_INTERP_SINC: {
+      int start = phase - 5;
+      if (mask == -1 || (start >= 0 && phase + 2 <= mask)) {
+        return delay_sinc_dot(buffer + start, k->k_w);
+      }
+      // the points wrap around an end of the buffer
+      t_sample p[DELAY_SINC_TAPS];
+      for (int m = 0; m < DELAY_SINC_TAPS; m++) p[m] = buffer[(start + m) & mask];
+      return delay_sinc_dot(p, k->k_w);
+    }
+    default:
+      return k->k_w[0] * buffer[phase & mask] + k->k_w[1] * buffer[(phase - 1) & mask] +
+        k->k_w[2] * buffer[(phase - 2) & mask] + k->k_w[3] * buffer[(phase - 3) & mask];
+  }
+}
+
+// one read with a fraction that changes from sample to sample
+DELAY_INTERP_INLINE t_sample delay_interp(const int mode, t_sample *buffer, int phase, int mask,
+                                          t_sample frac, t_sample *state)
+{
+  if (mode == DELAY_INTERP_CUBIC) return cubic_interpolate(buffer, phase, mask, frac);
+  t_interp_coefs k;
+  delay_interp_coefs(mode, frac, &k);
+  return delay_interp_apply(mode, buffer, phase, mask, &k, state);
+}
+
+/* delay_interp_apply for a buffer of frames, `nchans` samples each (channel
+ * c of frame p is buffer[p * nchans + c]), all of them read at the same
+ * position with the same coefficients. `out` and, for allpass, `state` hold
+ * one value per channel. The channel loops are innermost and run over
+ * neighbouring samples, so the compiler can do 4 or 8 channels per
+ * instruction.
+ */
+DELAY_INTERP_INLINE void delay_interp_apply_frames(const int mode, const t_sample *buffer,
+                                                   int phase, int mask, int nchans,
+                                                   const t_interp_coefs *k, t_sample *state,
+                                                   t_sample *restrict out)
+{
+#define DELAY_FRAME(i) (buffer + (((phase) + (i)) & mask) * nchans)
+  switch (mode) {
+    case DELAY_INTERP_NONE: {
+      const t_sample *b = DELAY_FRAME(-1);
+      for (int c = 0; c < nchans; c++) out[c] = b[c];
+      break;
+    }
+    case DELAY_INTERP_LINEAR: {
+      const t_sample *b = DELAY_FRAME(-1), *a = DELAY_FRAME(-2);
+      t_sample w = k->k_w[0];
+      for (int c = 0; c < nchans; c++) out[c] = b[c] + w * (a[c] - b[c]);
+      break;
+    }
+    case DELAY_INTERP_LAGRANGE: {
+      const t_sample *p0 = DELAY_FRAME(1), *p1 = DELAY_FRAME(0), *p2 = DELAY_FRAME(-1);
+      const t_sample *p3 = DELAY_FRAME(-2), *p4 = DELAY_FRAME(-3), *p5 = DELAY_FRAME(-4);
+      const t_sample *w = k->k_w;
+      for (int c = 0; c < nchans; c++) {
+        out[c] = w[0] * p0[c] + w[1] * p1[c] + w[2] * p2[c] + w[3] * p3[c] +
+          w[4] * p4[c] + w[5] * p5[c];
+      }
+      break;
+    }
+    case DELAY_INTERP_ALLPASS: {
+      const t_sample *b = DELAY_FRAME(k->k_shift - 1), *a = DELAY_FRAME(k->k_shift - 2);
+      t_sample eta = k->k_w[0];
+      for (int c = 0; c < nchans; c++) {
+        t_sample y = eta * b[c] + a[c] - eta * state[c];
+        state[c] = y;
+        out[c] = y;
+      }
+      break;
+    }
+    case DELAY_INTERP_SINC: {
+      const t_sample *p[DELAY_SINC_TAPS];
+      for (int m = 0; m < DELAY_SINC_TAPS; m++) p[m] = DELAY_FRAME(m - 5);
+      const t_sample *w = k->k_w;
+      for (int c = 0; c < nchans; c++) {
+        out[c] = w[0] * p[0][c] + w[1] * p[1][c] + w[2] * p[2][c] + w[3] * p[3][c] +
+          w[4] * p[4][c] + w[5] * p[5][c] + w[6] * p[6][c] + w[7] * p[7][c];
+      }
+      break;
+    }
+    default: {
+      const t_sample *p0 = DELAY_FRAME(0), *p1 = DELAY_FRAME(-1);
+      const t_sample *p2 = DELAY_FRAME(-2), *p3 = DELAY_FRAME(-3);
+      const t_sample *w = k->k_w;
+      for (int c = 0; c < nchans; c++) {
+        out[c] = w[0] * p0[c] + w[1] * p1[c] + w[2] * p2[c] + w[3] * p3[c];
+      }
+      break;
+    }
+  }
+#undef DELAY_FRAME
+}
+
+/* Feedback keeps a perform loop to one sample at a time: a short delay reads
+ * what the same loop wrote a few samples before. Once every read is at least
+ * DELAY_BLOCK_CHUNK samples old, though, nothing written in a stretch of that
+ * many samples is read in the same stretch, and the stretch can be done in
+ * passes: all the reads, then the feedback write, then the mix. The results
+ * are the same, and the write and the mix become plain loops the compiler
+ * vectorizes. (Stretches rather than whole blocks so that the reads fit in an
+ * array on the stack.)
+ */
+#define DELAY_BLOCK_CHUNK 64
+
+// whether the perform loops may use passes at all. always 1 in Pd: only the
+// bench (built with SIMPLE_DEL_BENCH) can clear it, so that its self-check (-c)
+// has one sample at a time to compare the passes against
+#ifdef SIMPLE_DEL_BENCH
+extern int delay_block_passes;
+#define DELAY_BLOCK_PASSES delay_block_passes
+#else
+#define DELAY_BLOCK_PASSES 1
+#endif
+
+/* Declares `name`, a table of perform routines indexed by mode, and one
+ * routine per mode that calls `body(w, mode)`. `body` should be a
+ * DELAY_INTERP_INLINE function so that it's built again for each mode, with
+ * the mode as a constant: the switches above then disappear.
+ */
+#define DELAY_INTERP_PERFORM_TABLE(name, body) \
+  static t_int *name##_none(t_int *w) { return body(w, DELAY_INTERP_NONE); } \
+  static t_int *name##_linear(t_int *w) { return body(w, DELAY_INTERP_LINEAR); } \
+  static t_int *name##_cubic(t_int *w) { return body(w, DELAY_INTERP_CUBIC); } \
+  static t_int *name##_lagrange(t_int *w) { return body(w, DELAY_INTERP_LAGRANGE); } \
+  static t_int *name##_allpass(t_int *w) { return body(w, DELAY_INTERP_ALLPASS); } \
+  static t_int *name##_sinc(t_int *w) { return body(w, DELAY_INTERP_SINC); } \
+  static const t_perfroutine name[DELAY_INTERP_COUNT] = { \
+    name##_none, name##_linear, name##_cubic, name##_lagrange, name##_allpass, name##_sinc \
+  }
+
+/* 1 if every sample of the vector is the same. Used on delay time inlets:
+ * those are nearly always fed from a float or a sig~, and then everything
+ * that depends on the delay time only needs working out once per block.
+ */
+static inline int signal_is_constant(const t_sample *vec, int n)
+{
+  t_sample f = vec[0];
+  int differs = 0;
+  for (int i = 1; i < n; i++) {
+    differs |= (vec[i] != f);
+  }
+  return !differs;
+}
+
+/* Denormals. A perform routine brackets its work with
+ *
+ *   t_denormal_state denormal_state = denormals_off();
+ *   ...
+ *   denormals_restore(denormal_state);
+ *
+ * which turns on flush-to-zero (and denormals-are-zero on x86) for the call
+ * and puts the FPU back the way it found it, so the rest of Pd isn't
+ * affected. That also catches the denormals that come out of the feedback
+ * path as a tail decays, which checking the input never did. Where there's
+ * no control register to set, both are no-ops.
+ *
+ * PD_BIGORSMALL on each input sample was about more than denormals, though:
+ * it also kept huge values, infinities and NaNs out of the buffer, where
+ * feedback would keep them going for good. FTZ does nothing about those, so
+ * every object that writes a buffer also calls denormals_sanitize_ring() (or
+ * _guarded()) on the span it wrote during the block, on every target. That
+ * zeroes what PD_BIGORSMALL would have, in one pass with no branches, rather
+ * than a test in the write loops. (Compact buffers are left alone: they
+ * can't hold any of those, delay_compact_encode clips.)
+ */
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+typedef unsigned int t_denormal_state;
+#define DENORMALS_MXCSR_FTZ_DAZ 0x8040
+
+static inline t_denormal_state denormals_off(void)
+{
+  t_denormal_state csr = _mm_getcsr();
+  _mm_setcsr(csr | DENORMALS_MXCSR_FTZ_DAZ);
+  return csr;
+}
+
+static inline void denormals_restore(t_denormal_state csr)
+{
+  _mm_setcsr(csr);
+}
+#elif defined(__aarch64__)
+typedef unsigned long t_denormal_state;
+
+static inline t_denormal_state denormals_off(void)
+{
+  t_denormal_state fpcr;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1UL << 24)));
+  return fpcr;
+}
+
+static inline void denormals_restore(t_denormal_state fpcr)
+{
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+}
+#elif defined(__arm__) && defined(__ARM_FP)
+typedef unsigned int t_denormal_state;
+
+static inline t_denormal_state denormals_off(void)
+{
+  t_denormal_state fpscr;
+  __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+  __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | (1U << 24)));
+  return fpscr;
+}
+
+static inline void denormals_restore(t_denormal_state fpscr)
+{
+  __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr));
+}
+#else
+typedef int t_denormal_state;
+
+static inline t_denormal_state denormals_off(void)
+{
+  return 0;
+}
+
+static inline void denormals_restore(t_denormal_state state)
+{
+  (void)state;
+}
+#endif
+
+// PD_BIGORSMALL's test: the top two bits of the exponent are the same for
+// tiny values, huge ones, infinities and NaNs. done on the bits, not with
+// comparisons, since -ffast-math lets the compiler assume there are no NaNs
+#if PD_FLOATSIZE == 64
+typedef uint64_t t_denormal_bits;
+#define DENORMALS_EXP_TOP 0x6000000000000000ULL
+#else
+typedef uint32_t t_denormal_bits;
+#define DENORMALS_EXP_TOP 0x60000000U
+#endif
+
+// `f`, or 0 where PD_BIGORSMALL(f) would be true. no branches, so loops of it
+// vectorize
+static inline t_sample denormals_clean(t_sample f)
+{
+  t_denormal_bits u, top;
+  memcpy(&u, &f, sizeof(u));
+  top = u & DENORMALS_EXP_TOP;
+  u &= -(t_denormal_bits)((top != 0) & (top != DENORMALS_EXP_TOP));
+  memcpy(&f, &u, sizeof(u));
+  return f;
+}
+
+static inline void denormals_sanitize(t_sample *vec, int n)
+{
+  for (int i = 0; i < n; i++) vec[i] = denormals_clean(vec[i]);
+}
+
+// denormals_sanitize() while copying, for the write loops
+static inline void denormals_sanitize_copy(t_sample *restrict dst, const t_sample *restrict src,
+                                           int n)
+{
+  for (int i = 0; i < n; i++) dst[i] = denormals_clean(src[i]);
+}
+
+// the n samples written from buf[start] on, in a ring of `size` samples
+static inline void denormals_sanitize_ring(t_sample *buf, int size, int start, int n)
+{
+  if (n >= size || start < 0 || start >= size) {
+    denormals_sanitize(buf, size);
+    return;
+  }
+  int first = size - start;
+  if (first > n) first = n;
+  denormals_sanitize(buf + start, first);
+  denormals_sanitize(buf, n - first);
+}
+
+// the same for buffers laid out like simple_delwrite~'s: a ring of `size`
+// samples that starts XTRASAMPS in, after a copy of its last XTRASAMPS
+// samples. `start` counts from the very start of the buffer
+static inline void denormals_sanitize_guarded(t_sample *vp, int size, int start, int n)
+{
+  denormals_sanitize_ring(vp + XTRASAMPS, size, start - XTRASAMPS, n);
+  denormals_sanitize(vp, XTRASAMPS);
+}
+
+/* Buffer sizes. The objects with power-of-two ring buffers (delay2~,
+ * multitap~, stereotaps~, stereotaps2~) and simple_delwrite~ keep track of
+ * how much memory they have separately from how much of it is in use. A
+ * rebuild of the DSP chain that needs the same size buffer doesn't allocate or
+ * touch anything. A different size is done in place if there's enough memory
+ * (reserved with `maxsize`, or the creation argument), and what's already in
+ * the buffer is kept, so the read positions carry on where they were.
+ */
+
+// the smallest power of two that's at least `samples`
+static inline int delay_pow2_size(double samples)
+{
+  int size = 1;
+  while (size < samples) size *= 2;
+  return size;
+}
+
+/* Memory for delay buffers, see simple_del_mem.c. Everything it hands out
+ * starts on a DELAY_MEM_ALIGN byte boundary and is zeroed; buffers of
+ * DELAY_MEM_HUGE bytes or more are put on huge pages where the system has
+ * them. delay_mem_resize keeps the old contents and zeroes what's added, and
+ * like resizebytes returns NULL with the old buffer untouched if it fails.
+ */
+#define DELAY_MEM_ALIGN 64
+#define DELAY_MEM_HUGE (2 * 1024 * 1024)
+
+void *delay_mem_alloc(size_t bytes);
+void *delay_mem_resize(void *p, size_t bytes, size_t newbytes);
+void delay_mem_free(void *p, size_t bytes);
+// posts `name: <bytes>, <alignment>, <backing>` for the `bufinfo` message.
+// `inline_buf` is the object's own array, if it has one
+void delay_mem_post(const char *name, const void *buf, size_t bytes, const void *inline_buf);
+// the `prefault` message: 0, 1 to fault buffers in as they're allocated, 2
+// to lock them in memory as well. for every buffer in the process, from now on
+void delay_mem_prefault(const void *owner, t_floatarg mode);
+
+/* The delay buffer arena, also in simple_del_mem.c: power of two blocks up
+ * to a megabyte, cut from chunks shared by the objects of a patch (its
+ * toplevel canvas, with all its subpatches and abstractions). An object
+ * takes its patch's arena with delay_arena_get when it's created, and
+ * gives it back with delay_arena_release after freeing its buffers. A NULL
+ * arena (what delay_arena_get returns if it's out of memory) passes
+ * everything through to delay_mem_alloc and co.
+ */
+typedef struct _delay_arena t_delay_arena;
+
+t_delay_arena *delay_arena_get(void);
+void delay_arena_release(t_delay_arena *a);
+void *delay_arena_alloc(t_delay_arena *a, size_t bytes);
+void *delay_arena_resize(t_delay_arena *a, void *p, size_t bytes, size_t newbytes);
+void delay_arena_free(t_delay_arena *a, void *p, size_t bytes);
+// `poolstats`: the arena's size, use and fragmentation, then the totals
+void delay_arena_post(const char *name, const t_delay_arena *a);
+
+/* Delay buffers start out in an array inside the object, `inline_size`
+ * samples of it, and only move to the heap once they outgrow it: objects with
+ * short delays (the thousands of them in a physical model, say) then each
+ * keep their buffer next to the rest of their state, rather than scattered
+ * about the heap. Like resizebytes, this keeps the first `alloc` samples and
+ * zeroes the rest, and returns NULL if there's no memory, with the old buffer
+ * still there. Past the inline array, the memory comes from `arena`, or from
+ * delay_mem_alloc when that's NULL.
+ */
+static inline t_sample *delay_buffer_resize(t_sample *buf, int alloc, int newalloc,
+                                            t_sample *inline_buf, int inline_size,
+                                            t_delay_arena *arena)
+{
+  if (newalloc <= inline_size) {
+    int keep = alloc < newalloc ? alloc : newalloc;
+    if (buf != inline_buf) {
+      memcpy(inline_buf, buf, keep * sizeof(t_sample));
+      delay_arena_free(arena, buf, alloc * sizeof(t_sample));
+    }
+    memset(inline_buf + keep, 0, (newalloc - keep) * sizeof(t_sample));
+    return inline_buf;
+  }
+  if (buf != inline_buf) {
+    return (t_sample *)delay_arena_resize(arena, buf, alloc * sizeof(t_sample),
+                                          newalloc * sizeof(t_sample));
+  }
+  t_sample *heap = (t_sample *)delay_arena_alloc(arena, newalloc * sizeof(t_sample));
+  if (heap) memcpy(heap, inline_buf, alloc * sizeof(t_sample));
+  return heap;
+}
+
+static inline void delay_buffer_free(t_sample *buf, int alloc, const t_sample *inline_buf,
+                                     t_delay_arena *arena)
+{
+  if (buf && buf != inline_buf) delay_arena_free(arena, buf, alloc * sizeof(t_sample));
+}
+
+/* Grows the n per-tap arrays in `arrays` from `old` to `num` entries, array i
+ * having sizes[i] bytes per entry. All the new arrays are allocated before any
+ * old one is let go, so it's all or nothing: on failure it returns 0 and the
+ * caller still has its old arrays, at their old size. On success the grown
+ * arrays are in `grown`, old contents copied and the rest zeroed, and the old
+ * ones are freed. */
+static inline int delay_arrays_grow(void *const arrays[], void *grown[], const size_t sizes[],
+                                    int n, int old, int num)
+{
+  int i;
+  for (i = 0; i < n; i++) {
+    grown[i] = getbytes(num * sizes[i]);
+    if (!grown[i]) {
+      while (i--) freebytes(grown[i], num * sizes[i]);
+      return 0;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    if (arrays[i]) {
+      memcpy(grown[i], arrays[i], old * sizes[i]);
+      freebytes(arrays[i], old * sizes[i]);
+    }
+  }
+  return 1;
+}
+
+/* Compact buffers (t_delay_format) are packed into memory counted in
+ * t_samples, so that they go through delay_buffer_resize, the inline arrays
+ * and the arena like any other buffer, only with fewer t_samples: this many
+ * for `samples` samples.
+ */
+static inline int delay_format_words(const t_delay_format *fmt, int samples)
+{
+  if (!fmt->f_compact) return samples;
+  return (samples * (int)sizeof(t_delay_compact) + (int)sizeof(t_sample) - 1) /
+    (int)sizeof(t_sample);
+}
+
+// the size of one sample in the buffer, in bytes
+static inline int delay_format_bytes(const t_delay_format *fmt)
+{
+  return fmt->f_compact ? (int)sizeof(t_delay_compact) : (int)sizeof(t_sample);
+}
+
+// clipped to the range, and rounded to the nearest step: the cast rounds
+// towards zero, so it's moved half a step away from zero first. no branches,
+// so the write loops still vectorize
+static inline t_delay_compact delay_compact_encode(t_sample f, t_sample gain)
+{
+  t_sample v = f * gain;
+  v = (v < DELAY_COMPACT_FULL) ? v : DELAY_COMPACT_FULL;
+  v = (v > -DELAY_COMPACT_FULL) ? v : -DELAY_COMPACT_FULL;
+  return (t_delay_compact)(v + ((v < 0) ? -0.5f : 0.5f));
+}
+
+static inline void delay_compact_encode_vec(t_delay_compact *restrict dst,
+                                            const t_sample *restrict src, int n, t_sample gain)
+{
+  for (int i = 0; i < n; i++) dst[i] = delay_compact_encode(src[i], gain);
+}
+
+static inline void delay_compact_decode_vec(t_sample *restrict dst,
+                                            const t_delay_compact *restrict src, int n,
+                                            t_sample scale)
+{
+  for (int i = 0; i < n; i++) dst[i] = (t_sample)src[i] * scale;
+}
+
+/* Converts the first n samples of `buf` from one format to another, in place.
+ * The memory has to be big enough for n samples of both. Floats to 16 bits
+ * runs from the start, so the smaller samples never catch up with the ones
+ * still to be read, and 16 bits to floats from the end; each stretch is
+ * copied out first, so neither kind of sample is ever read through a pointer
+ * to the other.
+ */
+static inline void delay_format_convert(void *buf, int n, const t_delay_format *from,
+                                        const t_delay_format *to)
+{
+  char *p = (char *)buf;
+  t_sample f[DELAY_INLINE_SAMPLES];
+  t_delay_compact q[DELAY_INLINE_SAMPLES];
+  if (!from->f_compact && !to->f_compact) return;
+  if (!from->f_compact) {
+    for (int i = 0; i < n; i += DELAY_INLINE_SAMPLES) {
+      int len = (n - i < DELAY_INLINE_SAMPLES) ? n - i : DELAY_INLINE_SAMPLES;
+      memcpy(f, p + i * sizeof(t_sample), len * sizeof(t_sample));
+      delay_compact_encode_vec(q, f, len, to->f_gain);
+      memcpy(p + i * sizeof(t_delay_compact), q, len * sizeof(t_delay_compact));
+    }
+  } else if (!to->f_compact) {
+    for (int i = (n - 1) / DELAY_INLINE_SAMPLES * DELAY_INLINE_SAMPLES; i >= 0;
+         i -= DELAY_INLINE_SAMPLES) {
+      int len = (n - i < DELAY_INLINE_SAMPLES) ? n - i : DELAY_INLINE_SAMPLES;
+      memcpy(q, p + i * sizeof(t_delay_compact), len * sizeof(t_delay_compact));
+      delay_compact_decode_vec(f, q, len, from->f_scale);
+      memcpy(p + i * sizeof(t_sample), f, len * sizeof(t_sample));
+    }
+  } else {
+    // a new range
+    t_delay_compact *vp = (t_delay_compact *)buf;
+    for (int i = 0; i < n; i++) {
+      vp[i] = delay_compact_encode((t_sample)vp[i] * from->f_scale, to->f_gain);
+    }
+  }
+}
+
+/* Resizes a power-of-two ring buffer from `size` to `newsize` in place, the
+ * memory being there already, and returns the new write position. Growing
+ * moves everything older than the write position `phase` to the end of the
+ * buffer and zeroes the gap left behind, so every delay up to `size` still
+ * reads the same samples. Shrinking keeps the newest `newsize` samples. `frame`
+ * is the number of bytes per position: for a buffer of t_samples see
+ * delay_ring_resize below.
+ */
+static inline int delay_ring_resize_bytes(char *buf, int size, int newsize, int phase,
+                                          size_t frame)
+{
+  if (newsize > size) {
+    memmove(buf + (phase + newsize - size) * frame, buf + phase * frame,
+            (size - phase) * frame);
+    memset(buf + phase * frame, 0, (newsize - size) * frame);
+  } else if (newsize < size) {
+    if (phase >= newsize) {
+      memmove(buf, buf + (phase - newsize) * frame, newsize * frame);
+      phase = 0;
+    } else {
+      memmove(buf + phase * frame, buf + (size - newsize + phase) * frame,
+              (newsize - phase) * frame);
+    }
+  }
+  return phase;
+}
+
+// `frame` samples per position: 2 for interleaved stereo
+static inline int delay_ring_resize(t_sample *buf, int size, int newsize, int phase, int frame)
+{
+  return delay_ring_resize_bytes((char *)buf, size, newsize, phase, frame * sizeof(t_sample));
+}
+
+/* The same for a buffer laid out like simple_delwrite~'s, where `phase` counts
+ * from vp[0] and the ring is vp[XTRASAMPS] to vp[size + XTRASAMPS], samples
+ * being `bytes` long. The guard samples at the start hold the last XTRASAMPS
+ * samples of the new ring afterwards.
+ */
+static inline int delay_guarded_resize_bytes(char *vp, int size, int newsize, int phase,
+                                             size_t bytes)
+{
+  if (newsize == size) return phase;
+  if (newsize > size) {
+    memmove(vp + (phase + newsize - size) * bytes, vp + phase * bytes,
+            (size + XTRASAMPS - phase) * bytes);
+    memset(vp + phase * bytes, 0, (newsize - size) * bytes);
+  } else {
+    int written = phase - XTRASAMPS; // samples since the last wrap
+    if (written >= newsize) {
+      memmove(vp + XTRASAMPS * bytes, vp + (phase - newsize) * bytes, newsize * bytes);
+      phase = XTRASAMPS;
+    } else {
+      memmove(vp + phase * bytes, vp + (XTRASAMPS + size - newsize + written) * bytes,
+              (newsize - written) * bytes);
+    }
+  }
+  // a write that's just reached the end of the buffer leaves the guard to be
+  // copied by the next one, so it's redone here rather than moved
+  memcpy(vp, vp + newsize * bytes, XTRASAMPS * bytes);
+  return phase;
+}
+
+static inline int delay_guarded_resize(t_sample *vp, int size, int newsize, int phase)
+{
+  return delay_guarded_resize_bytes((char *)vp, size, newsize, phase, sizeof(t_sample));
+}
+
+/* Copies a block of input into a buffer laid out like simple_delwrite~'s,
+ * starting at vp[phase] (XTRASAMPS <= phase <= size + XTRASAMPS). The copy
+ * is done in contiguous runs, normally one, or two when it reaches the end of
+ * the buffer, and is sanitized on the way in. The guard samples are copied
+ * once per wrap instead of checking for the end on every sample. Returns
+ * the phase after the last sample written.
+ */
+static inline int delay_write_guarded(t_sample *vp, int size, int phase,
+                                      const t_sample *in, int n)
+{
+  t_sample *ep = vp + (size + XTRASAMPS);
+  while (n > 0) {
+    int len = size + XTRASAMPS - phase;
+    if (len > n) len = n;
+    denormals_sanitize_copy(vp + phase, in, len);
+    in += len;
+    n -= len;
+    phase += len;
+    if (phase == size + XTRASAMPS) {
+      vp[0] = ep[-4];
+      vp[1] = ep[-3];
+      vp[2] = ep[-2];
+      vp[3] = ep[-1];
+      phase = XTRASAMPS;
+    }
+  }
+  return phase;
+}
+
+/* The other direction: copies n samples out of a buffer laid out like
+ * simple_delwrite~'s, starting at vp[phase] (0 <= phase < size + XTRASAMPS),
+ * again in one run or two if it gets to the end of the buffer.
+ */
+static inline void delay_read_guarded(const t_sample *vp, int size, int phase,
+                                      t_sample *out, int n)
+{
+  const t_sample *rp = vp + phase;
+  const t_sample *ep = vp + (size + XTRASAMPS);
+  while (n > 0) {
+    int len = ep - rp;
+    if (len > n) len = n;
+    memcpy(out, rp, len * sizeof(t_sample));
+    out += len;
+    rp += len;
+    n -= len;
+    if (rp == ep) rp -= size;
+  }
+}
+
+/* delay_write_guarded and delay_read_guarded for a compact buffer (see
+ * t_delay_format): the same runs, encoded on the way in and decoded on the
+ * way out. Nothing small enough to be a denormal survives being rounded to
+ * 16 bits, so there's no sanitizing.
+ */
+static inline int delay_write_guarded_compact(t_delay_compact *vp, int size, int phase,
+                                              const t_sample *in, int n, t_sample gain)
+{
+  t_delay_compact *ep = vp + (size + XTRASAMPS);
+  while (n > 0) {
+    int len = size + XTRASAMPS - phase;
+    if (len > n) len = n;
+    delay_compact_encode_vec(vp + phase, in, len, gain);
+    in += len;
+    n -= len;
+    phase += len;
+    if (phase == size + XTRASAMPS) {
+      vp[0] = ep[-4];
+      vp[1] = ep[-3];
+      vp[2] = ep[-2];
+      vp[3] = ep[-1];
+      phase = XTRASAMPS;
+    }
+  }
+  return phase;
+}
+
+static inline void delay_read_guarded_compact(const t_delay_compact *vp, int size, int phase,
+                                              t_sample *out, int n, t_sample scale)
+{
+  const t_delay_compact *rp = vp + phase;
+  const t_delay_compact *ep = vp + (size + XTRASAMPS);
+  while (n > 0) {
+    int len = ep - rp;
+    if (len > n) len = n;
+    delay_compact_decode_vec(out, rp, len, scale);
+    out += len;
+    rp += len;
+    n -= len;
+    if (rp == ep) rp -= size;
+  }
+}
+
+/* For readers inside this library that can work on the buffer in place
+ * rather than on a copy of it: the n samples delsamps behind the write
+ * position of `c`. Returns a pointer to the first of them and sets *len to
+ * how many are contiguous. If that's less than n, the rest start at
+ * c->c_vec + XTRASAMPS. Assumes n <= c->c_n, which simple_delwrite_check()
+ * and the readers' dsp methods make sure of.
+ */
+static inline t_sample *simple_delwrite_span(const t_simple_delwritectl *c, int delsamps,
+                                             int n, int *len)
+{
+  int phase = c->c_phase - delsamps;
+  if (phase < 0) phase += c->c_n;
+  int room = c->c_n + XTRASAMPS - phase;
+  *len = (room < n) ? room : n;
+  return c->c_vec + phase;
+}
+
+// the same, for when c->c_format is compact
+static inline t_delay_compact *simple_delwrite_span_compact(const t_simple_delwritectl *c,
+                                                            int delsamps, int n, int *len)
+{
+  int phase = c->c_phase - delsamps;
+  if (phase < 0) phase += c->c_n;
+  int room = c->c_n + XTRASAMPS - phase;
+  *len = (room < n) ? room : n;
+  return (t_delay_compact *)c->c_vec + phase;
+}
+
+/* Interpolates a whole set of taps at once: out[i] is cubic_interpolate(buffer,
+ * phase[i], mask, frac[i]). Points to the fastest kernel the CPU supports
+ * (see simple_del_kernels.c) once simple_del_kernels_init has been called.
+ * It also works on a buffer laid out like simple_delwrite~'s, with a mask of
+ * -1, as long as every phase[i] is at least 3.
+ */
+typedef void (*t_cubic_taps_fn)(t_sample *buffer, int mask, const int *phase,
+                                const t_sample *frac, t_sample *out, int ntaps);
+extern t_cubic_taps_fn cubic_interpolate_taps;
+
+/* The same for a stereo buffer stored as interleaved (left, right) frames:
+ * `phase` and `mask` count frames, and out[2 * i] and out[2 * i + 1] get the
+ * left and right channels of tap i. Both channels of a tap come from the same
+ * cache lines.
+ */
+extern t_cubic_taps_fn cubic_interpolate_taps_stereo;
+
+/* Both again for compact buffers (see t_delay_format): the points are
+ * decoded as they're loaded, four or eight taps at a time, and the results
+ * multiplied by `scale`, the buffer's f_scale.
+ */
+typedef void (*t_cubic_taps_compact_fn)(const t_delay_compact *buffer, int mask,
+                                        const int *phase, const t_sample *frac,
+                                        t_sample scale, t_sample *out, int ntaps);
+extern t_cubic_taps_compact_fn cubic_interpolate_taps_compact;
+extern t_cubic_taps_compact_fn cubic_interpolate_taps_stereo_compact;
+
+// call from each class's setup function, it's safe to call more than once
+void simple_del_kernels_init(void);
+// force a particular kernel ("scalar", "sse2" or "avx2"). returns 0 if the
+// kernel isn't available on this CPU or build
+int simple_del_kernels_select(const char *name);
+const char *simple_del_kernels_name(void);
+
+/* Convolution with a long impulse response, a block at a time, for multitap~
+ * when it has too many taps to read one by one (see simple_del_conv.c). The
+ * input is a ring buffer the caller has already written the block into.
+ */
+typedef struct _delay_conv
+{
+  int c_block; // partition size, the Pd block size. a power of two
+  int c_nparts; // partitions in use
+  int c_alloc_parts; // partitions there's memory for
+  int c_head; // slot in the delay line of the newest input spectrum
+  // impulse response partitions, then the frequency domain delay line: each
+  // c_alloc_parts spectra of c_block + 1 bins
+  t_sample *c_ir_re;
+  t_sample *c_ir_im;
+  t_sample *c_in_re;
+  t_sample *c_in_im;
+  t_sample *c_acc_re; // the output spectrum
+  t_sample *c_acc_im;
+  t_sample *c_time; // 2 * c_block samples, for the FFTs
+} t_delay_conv;
+
+void delay_conv_init(t_delay_conv *c);
+void delay_conv_free(t_delay_conv *c);
+// makes room for a response of `length` samples in blocks of `block`. returns
+// 0 if there isn't the memory, and then c is empty
+int delay_conv_setup(t_delay_conv *c, int block, int length);
+// sets the response, and fills the delay line from the ring buffer `buffer`
+// (mask + 1 samples), whose latest block ends just before `end`
+void delay_conv_set_ir(t_delay_conv *c, const t_sample *ir, int length,
+                       const t_sample *buffer, int mask, int end);
+// one block of output: the response convolved with `buffer` up to just
+// before `end`. points into c, valid until the next call
+t_sample *delay_conv_process(t_delay_conv *c, const t_sample *buffer, int mask, int end);
 #endif
@@ -0,0 +1,176 @@
+/* Timing for the `stats` message.
+ *
+ * Each object that has it puts an extra perform routine on either side of its
+ * own in the DSP chain: the first one reads the clock, the second one reads it
+ * again and adds the difference to a histogram. `stats` sends out
+ *
+ *   stats <avg> <p99> <max> <budget> <blocks>
+ *
+ * with the times in nanoseconds per block, `budget` being the average as a
+ * percentage of the time a block of audio lasts, over the blocks since the last
+ * `stats`. The p99 comes from the histogram, so it's rounded up to the top of
+ * a bucket (within about 20%).
+ *
+ * This file is compiled into every class (it's in `common.sources`), but is
+ * empty unless SIMPLE_DEL_STATS is defined.
+ * */
+
+#include "simple_del_shared.h"
+
+#ifdef SIMPLE_DEL_STATS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <x86intrin.h>
+#define DELAY_STATS_TSC 1
+#endif
+
+static uint64_t delay_stats_clock_ns(void)
+{
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER t;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&t);
+  return (uint64_t)((double)t.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* What's timed is counted in ticks of the cheapest clock there is: the time
+ * stamp counter on x86, which costs a few cycles to read where clock_gettime
+ * can cost a system call, and nanoseconds everywhere else. Ticks only become
+ * nanoseconds in `stats`, by comparing both clocks against where they were
+ * when the first object was made.
+ */
+#ifdef DELAY_STATS_TSC
+static uint64_t delay_stats_ref_ticks, delay_stats_ref_ns;
+
+static inline uint64_t delay_stats_ticks(void)
+{
+  return __rdtsc();
+}
+
+static double delay_stats_ns_per_tick(void)
+{
+  uint64_t ns, ticks;
+  // at least a millisecond between the two readings
+  do {
+    ns = delay_stats_clock_ns();
+    ticks = delay_stats_ticks();
+  } while (ns - delay_stats_ref_ns < 1000000);
+  return (double)(ns - delay_stats_ref_ns) / (double)(ticks - delay_stats_ref_ticks);
+}
+#else
+static inline uint64_t delay_stats_ticks(void)
+{
+  return delay_stats_clock_ns();
+}
+
+static double delay_stats_ns_per_tick(void)
+{
+  return 1;
+}
+#endif
+
+// below 8 ticks one bucket per tick, then 4 per power of two
+static int delay_stats_bucket(uint64_t ticks)
+{
+  int msb;
+  if (ticks < 8) return (int)ticks;
+  msb = 63 - __builtin_clzll(ticks);
+  return msb * 4 + (int)((ticks >> (msb - 2)) & 3);
+}
+
+// the largest number of ticks that goes in bucket i
+static uint64_t delay_stats_bucket_top(int i)
+{
+  int msb = i / 4;
+  if (i < 8) return (uint64_t)i;
+  return ((uint64_t)(5 + (i & 3)) << (msb - 2)) - 1;
+}
+
+void delay_stats_init(t_delay_stats *st)
+{
+  memset(st, 0, sizeof(*st));
+#ifdef DELAY_STATS_TSC
+  if (!delay_stats_ref_ns) {
+    delay_stats_ref_ns = delay_stats_clock_ns();
+    delay_stats_ref_ticks = delay_stats_ticks();
+  }
+#endif
+}
+
+static t_int *delay_stats_start(t_int *w)
+{
+  t_delay_stats *st = (t_delay_stats *)(w[1]);
+  st->s_start = delay_stats_ticks();
+  return (w+2);
+}
+
+static t_int *delay_stats_stop(t_int *w)
+{
+  t_delay_stats *st = (t_delay_stats *)(w[1]);
+  uint64_t ticks = delay_stats_ticks() - st->s_start;
+  st->s_total += ticks;
+  if (ticks > st->s_max) st->s_max = ticks;
+  st->s_hist[delay_stats_bucket(ticks)]++;
+  st->s_blocks++;
+  return (w+2);
+}
+
+void delay_stats_dsp_begin(t_delay_stats *st, int n, t_float sr)
+{
+  st->s_block_ns = (sr > 0) ? n * 1e9 / sr : 0;
+  dsp_add(delay_stats_start, 1, st);
+}
+
+void delay_stats_dsp_end(t_delay_stats *st)
+{
+  dsp_add(delay_stats_stop, 1, st);
+}
+
+void delay_stats_output(t_delay_stats *st, t_outlet *out)
+{
+  t_atom at[5];
+  double avg = 0, p99 = 0, max = 0, budget = 0;
+
+  if (st->s_blocks > 0) {
+    double ns_per_tick = delay_stats_ns_per_tick();
+    // the first bucket that takes the count past 99% of the blocks
+    unsigned int want = st->s_blocks - st->s_blocks / 100, seen = 0;
+    for (int i = 0; i < DELAY_STATS_BUCKETS; i++) {
+      seen += st->s_hist[i];
+      if (seen >= want) {
+        uint64_t top = delay_stats_bucket_top(i);
+        p99 = ns_per_tick * (double)(top < st->s_max ? top : st->s_max);
+        break;
+      }
+    }
+    avg = ns_per_tick * (double)st->s_total / st->s_blocks;
+    max = ns_per_tick * (double)st->s_max;
+    if (st->s_block_ns > 0) budget = 100 * avg / st->s_block_ns;
+  }
+  SETFLOAT(at, avg);
+  SETFLOAT(at + 1, p99);
+  SETFLOAT(at + 2, max);
+  SETFLOAT(at + 3, budget);
+  SETFLOAT(at + 4, st->s_blocks);
+  outlet_anything(out, gensym("stats"), 5, at);
+
+  // the block length stays, everything else starts again
+  st->s_total = 0;
+  st->s_max = 0;
+  st->s_blocks = 0;
+  memset(st->s_hist, 0, sizeof(st->s_hist));
+}
+
+#endif /* SIMPLE_DEL_STATS */
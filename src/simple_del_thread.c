@@ -0,0 +1,227 @@
+/* The helper thread behind `thread 1` (see simple_del_thread.h).
+ *
+ * Pd runs every perform routine on one thread, so a heavy multitap~ or
+ * stereotaps2~ can use up a core while the others sit idle. With `thread 1`
+ * the object's own perform routine runs on a thread of its own instead, and
+ * all the audio thread does is copy blocks to and from it:
+ *
+ *   - each block's input is copied into a slot, and the slot handed over
+ *   - the helper runs the perform routine on the slot, in place
+ *   - the next block, the audio thread copies that slot's output to the
+ *     outlets
+ *
+ * So the output is one block late, and the helper has a whole block's worth
+ * of time to do its work in. If it hasn't finished by then, the block goes
+ * out silent and is counted (`thread` with no argument posts the count). The
+ * helper still works through the blocks it was given, in order, so the delay
+ * line carries on as if nothing happened, but the output it was late with is
+ * skipped: the latency stays at one block. Only if it falls DELAY_THREAD_SLOTS
+ * blocks behind is input dropped.
+ *
+ * The slots are a ring with two counters: t_head, the blocks handed over, is
+ * only written by the audio thread, and t_tail, the blocks finished, only by
+ * the helper. Neither thread waits for the other to move them. The helper
+ * sleeps on a condition variable when it runs out of work, and says so in
+ * t_sleeping first. The audio thread only takes the mutex, to signal it, when
+ * that's set: while the helper has work, handing over a block is a store and
+ * a load. Once t_sleeping is set the helper holds the mutex for just the few
+ * instructions until it waits, so the audio thread can't be held up behind a
+ * perform routine running at a lower priority.
+ *
+ * Messages that change what the perform routine reads call
+ * delay_thread_sync() first. Pd sends messages from the thread that runs the
+ * DSP chain, so once the helper has caught up it stays idle until the message
+ * is done.
+ *
+ * This file is compiled into every class (it's in `common.sources`).
+ * */
+
+#include "simple_del_shared.h"
+#include "simple_del_thread.h"
+
+#if defined(__GNUC__)
+#define DELAY_THREAD_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define DELAY_THREAD_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define DELAY_THREAD_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#include <intrin.h>
+// MSVC's volatile loads and stores are acquire and release (the default
+// /volatile:ms)
+#define DELAY_THREAD_LOAD(p) (*(volatile unsigned int *)(p))
+#define DELAY_THREAD_STORE(p, v) (*(volatile unsigned int *)(p) = (v))
+// interlocked operations are full barriers
+#define DELAY_THREAD_FENCE() do { volatile long f_ = 0; _InterlockedExchange(&f_, 1); } while (0)
+#endif
+
+void delay_thread_init(t_delay_thread *t)
+{
+  memset(t, 0, sizeof(*t));
+  pthread_mutex_init(&t->t_mutex, NULL);
+  pthread_cond_init(&t->t_wake, NULL);
+  pthread_cond_init(&t->t_idle, NULL);
+}
+
+static void *delay_thread_main(void *z)
+{
+  t_delay_thread *t = (t_delay_thread *)z;
+  pthread_mutex_lock(&t->t_mutex);
+  while (!t->t_quit) {
+    unsigned int tail = t->t_tail;
+    if (tail == DELAY_THREAD_LOAD(&t->t_head)) {
+      // t_sleeping goes up before t_head is looked at again, and the audio
+      // thread moves t_head before it looks at t_sleeping, with a full fence
+      // on both sides: either this sees the new block or the audio thread
+      // sees the flag, and signals once the wait below has let go of the mutex
+      DELAY_THREAD_STORE(&t->t_sleeping, 1);
+      DELAY_THREAD_FENCE();
+      if (tail == DELAY_THREAD_LOAD(&t->t_head)) {
+        pthread_cond_signal(&t->t_idle);
+        pthread_cond_wait(&t->t_wake, &t->t_mutex);
+      }
+      DELAY_THREAD_STORE(&t->t_sleeping, 0);
+      continue;
+    }
+    pthread_mutex_unlock(&t->t_mutex);
+    t_int *w = t->t_w[tail % DELAY_THREAD_SLOTS];
+    ((t_perfroutine)w[0])(w);
+    DELAY_THREAD_STORE(&t->t_tail, tail + 1);
+    pthread_mutex_lock(&t->t_mutex);
+  }
+  pthread_mutex_unlock(&t->t_mutex);
+  return NULL;
+}
+
+// static but for the bench, which looks for it in the chain
+#ifndef SIMPLE_DEL_BENCH
+static
+#endif
+t_int *delay_thread_perform(t_int *w)
+{
+  t_delay_thread *t = (t_delay_thread *)(w[1]);
+  int n = t->t_n, nin = t->t_nin, nsig = t->t_nin + t->t_nout;
+  unsigned int head = t->t_head;
+  unsigned int tail = DELAY_THREAD_LOAD(&t->t_tail);
+  int room = t->t_running && head - tail < DELAY_THREAD_SLOTS;
+  int i;
+
+  // the input first: the outlets can be the same vectors as the inlets
+  if (room) {
+    t_sample *slot = t->t_buf + (head % DELAY_THREAD_SLOTS) * nsig * n;
+    for (i = 0; i < nin; i++) memcpy(slot + i * n, t->t_sig[i], n * sizeof(t_sample));
+  }
+
+  // then the output of the block handed over last time, if it's finished
+  if (t->t_handed && tail == head) {
+    t_sample *slot = t->t_buf + ((head - 1) % DELAY_THREAD_SLOTS) * nsig * n;
+    for (i = nin; i < nsig; i++) memcpy(t->t_sig[i], slot + i * n, n * sizeof(t_sample));
+  } else {
+    for (i = nin; i < nsig; i++) memset(t->t_sig[i], 0, n * sizeof(t_sample));
+    // (the first block after the chain is built has nothing to come out yet)
+    if (head) t->t_underruns++;
+  }
+
+  t->t_handed = room;
+  if (room) {
+    DELAY_THREAD_STORE(&t->t_head, head + 1);
+    // a helper that's still busy finds the block on its own (see
+    // delay_thread_main)
+    DELAY_THREAD_FENCE();
+    if (DELAY_THREAD_LOAD(&t->t_sleeping)) {
+      pthread_mutex_lock(&t->t_mutex);
+      pthread_cond_signal(&t->t_wake);
+      pthread_mutex_unlock(&t->t_mutex);
+    }
+  }
+  return (w+2);
+}
+
+int delay_thread_dsp(t_delay_thread *t, t_perfroutine perform, void *x, int nin, int nout,
+                     t_signal **sp)
+{
+  int n = sp[0]->s_length, nsig = nin + nout;
+  int size = DELAY_THREAD_SLOTS * nsig * n;
+
+  delay_thread_sync(t);
+  if (size > t->t_alloc) {
+    t_sample *buf = (t_sample *)resizebytes(t->t_buf, t->t_alloc * sizeof(t_sample),
+                                            size * sizeof(t_sample));
+    if (buf == NULL) {
+      pd_error(x, "unable to assign memory for the helper thread");
+      return 0;
+    }
+    t->t_buf = buf;
+    t->t_alloc = size;
+  }
+  if (!t->t_running) {
+    t->t_quit = 0;
+    if (pthread_create(&t->t_thread, NULL, delay_thread_main, t)) {
+      pd_error(x, "unable to start the helper thread");
+      return 0;
+    }
+    t->t_running = 1;
+  }
+
+  t->t_nin = nin;
+  t->t_nout = nout;
+  t->t_n = n;
+  for (int i = 0; i < nsig; i++) t->t_sig[i] = sp[i]->s_vec;
+  for (int s = 0; s < DELAY_THREAD_SLOTS; s++) {
+    t_int *w = t->t_w[s];
+    w[0] = (t_int)perform;
+    w[1] = (t_int)x;
+    for (int i = 0; i < nsig; i++) w[2 + i] = (t_int)(t->t_buf + (s * nsig + i) * n);
+    w[2 + nsig] = n;
+  }
+  // a new chain starts with nothing in flight. the helper is idle (it was
+  // synced above) and only looks at the counters with the mutex held
+  pthread_mutex_lock(&t->t_mutex);
+  t->t_head = t->t_tail = 0;
+  pthread_mutex_unlock(&t->t_mutex);
+  t->t_handed = 0;
+
+  dsp_add(delay_thread_perform, 1, t);
+  return 1;
+}
+
+void delay_thread_sync(t_delay_thread *t)
+{
+  if (!t->t_running) return;
+  pthread_mutex_lock(&t->t_mutex);
+  while (DELAY_THREAD_LOAD(&t->t_tail) != t->t_head) {
+    pthread_cond_wait(&t->t_idle, &t->t_mutex);
+  }
+  pthread_mutex_unlock(&t->t_mutex);
+}
+
+void delay_thread_stop(t_delay_thread *t)
+{
+  if (t->t_running) {
+    pthread_mutex_lock(&t->t_mutex);
+    t->t_quit = 1;
+    pthread_cond_signal(&t->t_wake);
+    pthread_mutex_unlock(&t->t_mutex);
+    pthread_join(t->t_thread, NULL);
+    t->t_running = 0;
+  }
+  t->t_handed = 0;
+  if (t->t_alloc > 0) {
+    freebytes(t->t_buf, t->t_alloc * sizeof(t_sample));
+    t->t_buf = NULL;
+    t->t_alloc = 0;
+  }
+}
+
+void delay_thread_free(t_delay_thread *t)
+{
+  delay_thread_stop(t);
+  pthread_mutex_destroy(&t->t_mutex);
+  pthread_cond_destroy(&t->t_wake);
+  pthread_cond_destroy(&t->t_idle);
+}
+
+unsigned int delay_thread_underruns(t_delay_thread *t)
+{
+  unsigned int underruns = t->t_underruns;
+  t->t_underruns = 0;
+  return underruns;
+}
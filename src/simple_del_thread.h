@@ -0,0 +1,68 @@
+/* `thread 1`: an object's perform routine run on a helper thread of its own,
+ * a block behind the audio thread (see simple_del_thread.c). In the DSP chain
+ * the object's perform routine is replaced by delay_thread_perform, which
+ * only copies blocks in and out.
+ *
+ * Only multitap~ and stereotaps2~ have it, so it has a header of its own and
+ * pthread.h stays out of the classes that don't.
+ * */
+
+#ifndef SIMPLE_DEL_THREAD_H
+#define SIMPLE_DEL_THREAD_H
+
+#include "simple_del_shared.h"
+#include <pthread.h>
+
+#define DELAY_THREAD_SLOTS 4 // blocks in flight between the two threads
+#define DELAY_THREAD_MAXSIGS 4 // inlets plus outlets
+
+typedef struct _delay_thread
+{
+  pthread_t t_thread;
+  pthread_mutex_t t_mutex;
+  pthread_cond_t t_wake; // the helper waits here for blocks
+  pthread_cond_t t_idle; // delay_thread_sync waits here for the helper
+  int t_running;
+  int t_quit;
+  int t_nin;
+  int t_nout;
+  int t_n;
+  t_sample *t_sig[DELAY_THREAD_MAXSIGS]; // Pd's signal vectors, inlets first
+  // the perform routine's arguments for each slot, pointing at the slot's
+  // copies of the signal vectors in t_buf
+  t_int t_w[DELAY_THREAD_SLOTS][DELAY_THREAD_MAXSIGS + 3];
+  t_sample *t_buf;
+  int t_alloc; // samples in t_buf
+  // blocks handed over by the audio thread, and blocks finished by the
+  // helper. each only ever written by its own thread
+  unsigned int t_head;
+  unsigned int t_tail;
+  unsigned int t_sleeping; // the helper is (about to be) waiting on t_wake
+  int t_handed; // the last block went to the helper
+  unsigned int t_underruns; // blocks that went out silent
+} t_delay_thread;
+
+void delay_thread_init(t_delay_thread *t);
+// called from the object's dsp method in place of its dsp_add, for a perform
+// routine that takes (x, the nin + nout vectors of sp, block size). starts
+// the helper if it isn't running. returns 0 if it can't, and then nothing was
+// added to the chain
+int delay_thread_dsp(t_delay_thread *t, t_perfroutine perform, void *x, int nin, int nout,
+                     t_signal **sp);
+// waits for the helper to finish every block it has been given. anything that
+// changes what the perform routine reads, other than single numbers, calls
+// this first
+void delay_thread_sync(t_delay_thread *t);
+// stops the helper and frees its slots, for `thread 0`. the object's dsp
+// method has to run again before the chain uses it
+void delay_thread_stop(t_delay_thread *t);
+// stops it and frees everything, from the object's free method
+void delay_thread_free(t_delay_thread *t);
+// blocks that went out silent since the last call
+unsigned int delay_thread_underruns(t_delay_thread *t);
+#ifdef SIMPLE_DEL_BENCH
+// what delay_thread_dsp puts in the chain, with the t_delay_thread as its one
+// argument. the bench's self-check looks for it, to wait for the helper
+t_int *delay_thread_perform(t_int *w);
+#endif
+#endif
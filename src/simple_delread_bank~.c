@@ -0,0 +1,313 @@
+#include "simple_del_shared.h"
+#include <m_pd.h>
+
+extern int ugen_getsortno(void);
+
+/* Any number of simple_delread~ objects on the same simple_delwrite~, in one
+ * object:
+ *
+ *   [simple_delread_bank~ name t1 t2 ... tN]        N outlets, one per delay
+ *   [simple_delread_bank~ name -sum t1 t2 ... tN]   one outlet, the sum of the
+ *                                                   delays weighted by `gains`
+ *
+ * All of them are read in one perform routine, and in the order they sit in
+ * the buffer, so delays close enough together to share cache lines only load
+ * them once. The delays are set in msecs with `delays t1 ... tN`, the gains
+ * (default 1) with `gains g1 ... gN`.
+ * */
+
+static t_class *simple_delread_bank_class = NULL;
+
+typedef struct _simple_delread_bank {
+  t_object x_obj;
+  t_symbol *x_sym;
+  int x_ntaps;
+  int x_sum; // one summed outlet rather than one outlet per delay
+  t_float *x_deltime; /* delays in msecs */
+  int *x_delsamps; /* delays in samples */
+  t_sample *x_gain; // only used for -sum
+  int *x_phase; // where each delay reads from in the current block
+  int *x_order; // delays in the order they're read in, by x_phase
+  t_sample **x_outvec; // signal vectors of the outlets, set in dsp
+  t_float x_sr; /* samples per msec */
+  t_float x_n; /* vector size */
+  int x_zerodel; /* 0 or vecsize depending on read/write order */
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+} t_simple_delread_bank;
+
+static void simple_delread_bank_update(t_simple_delread_bank *x);
+
+static void *simple_delread_bank_new(t_symbol *s, int argc, t_atom *argv)
+{
+  t_simple_delread_bank *x = (t_simple_delread_bank *)pd_new(simple_delread_bank_class);
+  int i, noutlets;
+  (void)s;
+
+  x->x_sym = atom_getsymbolarg(0, argc, argv);
+  if (argc) {
+    argc--;
+    argv++;
+  }
+  x->x_sum = 0;
+  if (argc && argv[0].a_type == A_SYMBOL && argv[0].a_w.w_symbol == gensym("-sum")) {
+    x->x_sum = 1;
+    argc--;
+    argv++;
+  }
+  // at least one delay, so there's always an outlet
+  x->x_ntaps = (argc > 0) ? argc : 1;
+
+  x->x_deltime = (t_float *)getbytes(x->x_ntaps * sizeof(t_float));
+  x->x_delsamps = (int *)getbytes(x->x_ntaps * sizeof(int));
+  x->x_gain = (t_sample *)getbytes(x->x_ntaps * sizeof(t_sample));
+  x->x_phase = (int *)getbytes(x->x_ntaps * sizeof(int));
+  x->x_order = (int *)getbytes(x->x_ntaps * sizeof(int));
+  noutlets = x->x_sum ? 1 : x->x_ntaps;
+  x->x_outvec = (t_sample **)getbytes(noutlets * sizeof(t_sample *));
+  if (!x->x_deltime || !x->x_delsamps || !x->x_gain || !x->x_phase || !x->x_order ||
+      !x->x_outvec) {
+    pd_error(x, "simple_delread_bank~: unable to assign memory");
+    // whichever of them did get allocated goes back in simple_delread_bank_free
+    pd_free((t_pd *)x);
+    return NULL;
+  }
+
+  for (i = 0; i < x->x_ntaps; i++) {
+    x->x_deltime[i] = atom_getfloatarg(i, argc, argv);
+    x->x_gain[i] = 1;
+    x->x_order[i] = i;
+  }
+  x->x_sr = 1;
+  x->x_n = 1;
+  x->x_zerodel = 0;
+  simple_delread_bank_update(x);
+
+  for (i = 0; i < noutlets; i++) outlet_new(&x->x_obj, &s_signal);
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
+  return (void *)x;
+}
+
+// the same as simple_delread_float, for every delay
+static void simple_delread_bank_update(t_simple_delread_bank *x)
+{
+  t_simple_delwrite *delwriter = (t_simple_delwrite *)simple_delwrite_findbyname(x->x_sym);
+  if (!delwriter) return;
+  for (int i = 0; i < x->x_ntaps; i++) {
+    int delsamps = (int)(0.5 + x->x_sr * x->x_deltime[i]) + x->x_n - x->x_zerodel;
+    if (delsamps < x->x_n) {
+      delsamps = x->x_n;
+    } else if (delsamps > delwriter->x_cspace.c_n) {
+      delsamps = delwriter->x_cspace.c_n;
+    }
+    x->x_delsamps[i] = delsamps;
+  }
+}
+
+static void simple_delread_bank_delays(t_simple_delread_bank *x, t_symbol *s,
+                                       int argc, t_atom *argv)
+{
+  (void)s;
+  if (argc > x->x_ntaps) argc = x->x_ntaps;
+  for (int i = 0; i < argc; i++) x->x_deltime[i] = atom_getfloat(argv + i);
+  simple_delread_bank_update(x);
+}
+
+static void simple_delread_bank_gains(t_simple_delread_bank *x, t_symbol *s,
+                                      int argc, t_atom *argv)
+{
+  (void)s;
+  if (argc > x->x_ntaps) argc = x->x_ntaps;
+  for (int i = 0; i < argc; i++) x->x_gain[i] = atom_getfloat(argv + i);
+}
+
+/* The same reads from a compact buffer (see t_delay_format). Summed, each
+ * tap is decoded and added in in one loop, its gain and the buffer's scale
+ * as one multiplier. x_order and x_phase are up to date.
+ */
+static void simple_delread_bank_compact(t_simple_delread_bank *x,
+                                        const t_simple_delwritectl *c, int n)
+{
+  t_sample scale = c->c_format.f_scale;
+  if (!x->x_sum) {
+    for (int k = 0; k < x->x_ntaps; k++) {
+      int tap = x->x_order[k];
+      delay_read_guarded_compact((const t_delay_compact *)c->c_vec, c->c_n, x->x_phase[tap],
+                                 x->x_outvec[tap], n, scale);
+    }
+    return;
+  }
+  t_sample *out = x->x_outvec[0];
+  memset(out, 0, n * sizeof(t_sample));
+  for (int k = 0; k < x->x_ntaps; k++) {
+    int tap = x->x_order[k];
+    int len;
+    const t_delay_compact *p = simple_delwrite_span_compact(c, x->x_delsamps[tap], n, &len);
+    t_sample g = x->x_gain[tap] * scale;
+    for (int i = 0; i < len; i++) out[i] += g * p[i];
+    if (len < n) {
+      p = (const t_delay_compact *)c->c_vec + XTRASAMPS;
+      for (int i = len; i < n; i++) out[i] += g * p[i - len];
+    }
+  }
+}
+
+static t_int *simple_delread_bank_perform(t_int *w)
+{
+  t_simple_delread_bank *x = (t_simple_delread_bank *)(w[1]);
+  t_simple_delwritectl *c = (t_simple_delwritectl *)(w[2]);
+  int n = (int)(w[3]);
+
+  int ntaps = x->x_ntaps;
+  int nsamps = c->c_n;
+  int *delsamps = x->x_delsamps;
+  int *phase = x->x_phase;
+  int *order = x->x_order;
+  t_sample **outvec = x->x_outvec;
+
+  if (n > nsamps) { /* blocksize is larger than simple_delwrite~ buffer size */
+    for (int i = 0; i < (x->x_sum ? 1 : ntaps); i++) {
+      memset(outvec[i], 0, n * sizeof(t_sample));
+    }
+    return (w+4);
+  }
+
+  for (int i = 0; i < ntaps; i++) {
+    int p = c->c_phase - delsamps[i];
+    if (p < 0) p += nsamps;
+    phase[i] = p;
+  }
+
+  // the order only changes when a delay is changed or a read position wraps,
+  // so it's nearly always sorted already and this is one pass
+  for (int i = 1; i < ntaps; i++) {
+    int tap = order[i];
+    int j = i - 1;
+    while (j >= 0 && phase[order[j]] > phase[tap]) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = tap;
+  }
+
+  if (c->c_format.f_compact) {
+    simple_delread_bank_compact(x, c, n);
+  } else if (x->x_sum) {
+    t_sample *out = outvec[0];
+    t_sample *gain = x->x_gain;
+    memset(out, 0, n * sizeof(t_sample));
+    // taps are added in four at a time, so the output is only loaded and
+    // stored once for every four taps. a tap that runs past the end of the
+    // buffer this block (at most one block in c_n / n for each tap) is added
+    // in on its own, in two pieces
+    t_sample *bp[4];
+    t_sample g[4];
+    int ngroup = 0;
+    for (int k = 0; k < ntaps; k++) {
+      int tap = order[k];
+      int len;
+      t_sample *p = simple_delwrite_span(c, delsamps[tap], n, &len);
+      if (len < n) {
+        t_sample gt = gain[tap];
+        for (int i = 0; i < len; i++) out[i] += gt * p[i];
+        // past the end of the buffer: carries on XTRASAMPS in
+        p = c->c_vec + XTRASAMPS;
+        for (int i = len; i < n; i++) out[i] += gt * p[i - len];
+        continue;
+      }
+      bp[ngroup] = p;
+      g[ngroup] = gain[tap];
+      if (++ngroup == 4) {
+        t_sample *p0 = bp[0], *p1 = bp[1], *p2 = bp[2], *p3 = bp[3];
+        t_sample g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3];
+        for (int i = 0; i < n; i++) {
+          out[i] += g0 * p0[i] + g1 * p1[i] + g2 * p2[i] + g3 * p3[i];
+        }
+        ngroup = 0;
+      }
+    }
+    for (int j = 0; j < ngroup; j++) {
+      t_sample *p = bp[j];
+      t_sample gj = g[j];
+      for (int i = 0; i < n; i++) out[i] += gj * p[i];
+    }
+  } else {
+    for (int k = 0; k < ntaps; k++) {
+      int tap = order[k];
+      delay_read_guarded(c->c_vec, nsamps, phase[tap], outvec[tap], n);
+    }
+  }
+  return (w+4);
+}
+
+static void simple_delread_bank_dsp(t_simple_delread_bank *x, t_signal **sp)
+{
+  t_simple_delwrite *delwriter = (t_simple_delwrite *)simple_delwrite_findbyname(x->x_sym);
+  int noutlets = x->x_sum ? 1 : x->x_ntaps;
+  x->x_sr = sp[0]->s_sr * 0.001;
+  x->x_n = sp[0]->s_length;
+  for (int i = 0; i < noutlets; i++) x->x_outvec[i] = sp[i]->s_vec;
+
+  if (delwriter) {
+    // one findbyname, one check and one chain entry for all of the delays
+    simple_delwrite_check(delwriter, sp[0]->s_n, sp[0]->s_sr);
+    x->x_zerodel = (delwriter->x_sortno == ugen_getsortno() ?
+                    0 : delwriter->x_vecsize);
+    simple_delread_bank_update(x);
+    DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
+    dsp_add(simple_delread_bank_perform, 3, x, &delwriter->x_cspace,
+            (t_int)sp[0]->s_length);
+    DELAY_STATS_DSP_END(&x->x_stats);
+
+    if (delwriter->x_cspace.c_n > 0 && sp[0]->s_n > delwriter->x_cspace.c_n) {
+      pd_error(x, "simple_delread_bank~ %s: blocksize larger than simple_delwrite~ buffer",
+               x->x_sym->s_name);
+    }
+  } else if (*x->x_sym->s_name) {
+    pd_error(x, "simple_delread_bank~ %s: no such simple_delwrite~", x->x_sym->s_name);
+  }
+}
+
+static void simple_delread_bank_free(t_simple_delread_bank *x)
+{
+  int ntaps = x->x_ntaps;
+  freebytes(x->x_deltime, ntaps * sizeof(t_float));
+  freebytes(x->x_delsamps, ntaps * sizeof(int));
+  freebytes(x->x_gain, ntaps * sizeof(t_sample));
+  freebytes(x->x_phase, ntaps * sizeof(int));
+  freebytes(x->x_order, ntaps * sizeof(int));
+  freebytes(x->x_outvec, (x->x_sum ? 1 : ntaps) * sizeof(t_sample *));
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void simple_delread_bank_stats(t_simple_delread_bank *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+void simple_delread_bank_tilde_setup(void)
+{
+  simple_delread_bank_class = class_new(gensym("simple_delread_bank~"),
+                                        (t_newmethod)simple_delread_bank_new,
+                                        (t_method)simple_delread_bank_free,
+                                        sizeof(t_simple_delread_bank),
+                                        0,
+                                        A_GIMME, 0);
+  class_addmethod(simple_delread_bank_class, (t_method)simple_delread_bank_dsp,
+                  gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(simple_delread_bank_class, (t_method)simple_delread_bank_stats, gensym("stats"), 0);
+#endif
+  class_addmethod(simple_delread_bank_class, (t_method)simple_delread_bank_delays,
+                  gensym("delays"), A_GIMME, 0);
+  class_addmethod(simple_delread_bank_class, (t_method)simple_delread_bank_gains,
+                  gensym("gains"), A_GIMME, 0);
+  class_addlist(simple_delread_bank_class, (t_method)simple_delread_bank_delays);
+  class_sethelpsymbol(simple_delread_bank_class, gensym("delay-tilde-objects"));
+}
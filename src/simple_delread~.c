@@ -13,6 +13,10 @@ typedef struct _simple_delread {
   t_float x_sr; /* samples per msec */
   t_float x_n; /* vector size */
   int x_zerodel; /* 0 or vecsize depending on read/write order */
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
 } t_simple_delread;
 
 static void simple_delread_float(t_simple_delread *x, t_float f);
@@ -26,6 +30,10 @@ static void *simple_delread_new(t_symbol *s, t_floatarg f)
   x->x_zerodel = 0;
   simple_delread_float(x, f);
   outlet_new(&x->x_obj, &s_signal);
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
@@ -58,26 +66,20 @@ static t_int *simple_delread_perform(t_int *w)
   int phase = c->c_phase - delsamps;
   int nsamps = c->c_n; // size of delay buffer
 
-
-  t_sample *vp = c->c_vec; // start of the buffer
-  t_sample *bp; // current position, assigned below
-  t_sample *ep = vp + (c->c_n + XTRASAMPS); // end of the buffer, including
-  // extra samples
-
   // handle negative phase (wrap arount)
   if (phase < 0) {
     phase += nsamps;
   }
 
-  bp = vp + phase; // current position
-
-  while (n--) {
-    *out++ = *bp++; // read from the buffer
-
-    // wrap around if the end of the buffer is reached
-    if (bp == ep) {
-      bp -= nsamps;
-    }
+  // the delay only changes between blocks, so the whole block is one
+  // contiguous span of the buffer, or two if it runs past the end (then it
+  // carries on XTRASAMPS in): copied with memcpy rather than a sample at a
+  // time
+  if (c->c_format.f_compact) {
+    delay_read_guarded_compact((const t_delay_compact *)c->c_vec, nsamps, phase, out, n,
+                               c->c_format.f_scale);
+  } else {
+    delay_read_guarded(c->c_vec, nsamps, phase, out, n);
   }
   return (w+5);
 }
@@ -98,8 +100,10 @@ static void simple_delread_dsp(t_simple_delread *x, t_signal **sp)
     x->x_zerodel = (delwriter->x_sortno == ugen_getsortno() ?
                     0 : delwriter->x_vecsize);
     simple_delread_float(x, x->x_deltime);
+    DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
     dsp_add(simple_delread_perform, 4,
             sp[0]->s_vec, &delwriter->x_cspace, &x->x_delsamps, (t_int)sp[0]->s_length);
+    DELAY_STATS_DSP_END(&x->x_stats);
 
     if (delwriter->x_cspace.c_n > 0 && sp[0]->s_n > delwriter->x_cspace.c_n) {
       pd_error(x, "simple_delread~ %s: blocksize larger than simple_delwrite~ buffer", x->x_sym->s_name);
@@ -109,6 +113,13 @@ static void simple_delread_dsp(t_simple_delread *x, t_signal **sp)
   }
 }
 
+#ifdef SIMPLE_DEL_STATS
+static void simple_delread_stats(t_simple_delread *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
 void simple_delread_tilde_setup(void)
 {
   simple_delread_class = class_new(gensym("simple_delread~"),
@@ -118,6 +129,9 @@ void simple_delread_tilde_setup(void)
                                    0,
                                    A_DEFSYM, A_DEFFLOAT, 0);
   class_addmethod(simple_delread_class, (t_method)simple_delread_dsp, gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(simple_delread_class, (t_method)simple_delread_stats, gensym("stats"), 0);
+#endif
   class_addfloat(simple_delread_class, (t_method)simple_delread_float);
   class_sethelpsymbol(simple_delread_class, gensym("delay-tilde-objects"));
 }
@@ -15,40 +15,112 @@ t_simple_delwrite *simple_delwrite_findbyname(t_symbol *s)
   return (t_simple_delwrite *)pd_findbyclass(s, simple_delwrite_class);
 }
 
-/* handles buffer allocation and resizing */
-void simple_delwrite_update(t_simple_delwrite *x)
+/* makes sure there's memory for a ring of `nsamps` samples (plus XTRASAMPS),
+ * without changing the size in use. returns 0 on failure */
+static int simple_delwrite_reserve(t_simple_delwrite *x, int nsamps)
 {
-  // calculates buffer size in samples based on delay time
-  int nsamps = x->x_deltime * x->x_sr * (t_float)(0.001f);
-  if (nsamps < 1) nsamps = 1;
+  t_sample *vec;
+  int words = delay_format_words(&x->x_cspace.c_format, nsamps + XTRASAMPS);
+  if (nsamps <= x->x_cspace.c_alloc) return 1;
+  if (words > x->x_cspace.c_words) {
+    vec = delay_buffer_resize(x->x_cspace.c_vec, x->x_cspace.c_words, words,
+                              x->x_cspace.c_inline, DELAY_INLINE_SAMPLES + XTRASAMPS, NULL);
+    if (vec == NULL) {
+      pd_error(x, "simple_delwrite~: unable to assign memory for %d samples", nsamps);
+      return 0;
+    }
+    x->x_cspace.c_vec = vec;
+    x->x_cspace.c_words = words;
+  }
+  x->x_cspace.c_alloc = nsamps;
+  return 1;
+}
 
-  // round up to a multiple of SAMPBLK (4)
+// buffer size in samples for a delay time, rounded up to a multiple of
+// SAMPBLK (4), plus the vector size
+static int simple_delwrite_nsamps(t_float msecs, t_float sr, int vecsize)
+{
+  int nsamps = msecs * sr * (t_float)(0.001f);
+  if (nsamps < 1) nsamps = 1;
   nsamps += ((- nsamps) & (SAMPBLK - 1));
+  return nsamps + vecsize;
+}
 
-  // add the vector size to ensure the buffer has enough space (set in delwrite_check from its vecsize arg
-  // (sp[0]->s_length))
-  nsamps += x->x_vecsize;
+/* handles buffer allocation and resizing */
+void simple_delwrite_update(t_simple_delwrite *x)
+{
+  // calculates buffer size in samples based on delay time, plus the vector
+  // size to ensure the buffer has enough space (set in delwrite_check from its
+  // vecsize arg (sp[0]->s_length))
+  int nsamps = simple_delwrite_nsamps(x->x_deltime, x->x_sr, x->x_vecsize);
 
-  // resize the buffer if needed
-  if (x->x_cspace.c_n != nsamps) {
-    x->x_cspace.c_vec = (t_sample *)resizebytes(x->x_cspace.c_vec,
-                         (x->x_cspace.c_n + XTRASAMPS) * sizeof(t_sample),
-                         (nsamps + XTRASAMPS) * sizeof(t_sample));
+  // a DSP rebuild that needs the same size leaves the buffer, and the write
+  // position, alone. a different size keeps what's already in the buffer: see
+  // delay_guarded_resize
+  if (nsamps != x->x_cspace.c_n) {
+    if (!simple_delwrite_reserve(x, nsamps)) return;
+    x->x_cspace.c_phase = delay_guarded_resize_bytes((char *)x->x_cspace.c_vec,
+                                                     x->x_cspace.c_n, nsamps, x->x_cspace.c_phase,
+                                                     delay_format_bytes(&x->x_cspace.c_format));
     x->x_cspace.c_n = nsamps;
-    x->x_cspace.c_phase = XTRASAMPS;
-    #if 0
-      post("delay line resized to %d samples", nsamps);
-    #endif
   }
 }
 
+// reserves memory for a delay of up to `msecs`, so that DSP rebuilds that
+// need a bigger buffer later on (a longer delay, a higher sample rate) don't
+// have to allocate
+static void simple_delwrite_maxsize(t_simple_delwrite *x, t_floatarg msecs)
+{
+  t_float sr = (x->x_sr > 0) ? x->x_sr : sys_getsr();
+  int vecsize = (x->x_vecsize > 0) ? x->x_vecsize : sys_getblksize();
+  simple_delwrite_reserve(x, simple_delwrite_nsamps(msecs, sr, vecsize));
+}
+
 static void simple_delwrite_clear(t_simple_delwrite *x)
 {
   if (x->x_cspace.c_n > 0) {
-    memset(x->x_cspace.c_vec, 0, sizeof(t_sample) * (x->x_cspace.c_n + XTRASAMPS));
+    memset(x->x_cspace.c_vec, 0, sizeof(t_sample) * x->x_cspace.c_words);
   }
 }
 
+// `compact <range>` keeps the buffer as 16 bit samples up to +-range (see
+// t_delay_format) and `compact 0` as floats again. the readers follow along
+// from the next block, so it can be changed while DSP is running
+static void simple_delwrite_compact(t_simple_delwrite *x, t_floatarg range)
+{
+  t_simple_delwritectl *c = &x->x_cspace;
+  t_delay_format to;
+  delay_format_set(&to, range);
+  int words = c->c_words;
+  int newwords = delay_format_words(&to, c->c_alloc + XTRASAMPS);
+  t_sample *vec = c->c_vec;
+
+  // more memory before the samples get bigger, less after they get smaller
+  if (newwords > words) {
+    vec = delay_buffer_resize(vec, words, newwords, c->c_inline,
+                              DELAY_INLINE_SAMPLES + XTRASAMPS, NULL);
+    if (vec == NULL) {
+      pd_error(x, "simple_delwrite~: unable to assign memory for float samples");
+      return;
+    }
+    words = newwords;
+  }
+  delay_format_convert(vec, c->c_n + XTRASAMPS, &c->c_format, &to);
+  if (newwords < words) {
+    t_sample *shrunk = delay_buffer_resize(vec, words, newwords, c->c_inline,
+                                           DELAY_INLINE_SAMPLES + XTRASAMPS, NULL);
+    // if it can't be given back, the buffer stays where it is, a bit too big,
+    // and c_words keeps its real size for the next resize or free
+    if (shrunk) {
+      vec = shrunk;
+      words = newwords;
+    }
+  }
+  c->c_vec = vec;
+  c->c_words = words;
+  c->c_format = to;
+}
+
 // ensures that delread and delwrite objects in a chain have compatible vector
 // sizes and sample rates
 void simple_delwrite_check(t_simple_delwrite *x, int vecsize, t_float sr)
@@ -76,7 +148,7 @@ void simple_delwrite_check(t_simple_delwrite *x, int vecsize, t_float sr)
 #endif
 }
 
-static void *simple_delwrite_new(t_symbol *s, t_floatarg msec)
+static void *simple_delwrite_new(t_symbol *s, t_floatarg msec, t_floatarg maxmsec)
 {
   t_simple_delwrite *x = (t_simple_delwrite *)pd_new(simple_delwrite_class);
   if (!*s->s_name) s = gensym("simple_delwrite~");
@@ -84,11 +156,21 @@ static void *simple_delwrite_new(t_symbol *s, t_floatarg msec)
   x->x_sym = s;
   x->x_deltime = msec;
   x->x_cspace.c_n = 0;
-  x->x_cspace.c_vec = getbytes(XTRASAMPS * sizeof(t_sample));
+  x->x_cspace.c_alloc = 0;
+  x->x_cspace.c_phase = XTRASAMPS;
+  x->x_cspace.c_vec = x->x_cspace.c_inline;
+  x->x_cspace.c_words = XTRASAMPS;
+  delay_format_set(&x->x_cspace.c_format, 0);
   x->x_sortno = 0;
   x->x_vecsize = 0;
   x->x_sr = 0;
   x->x_f = 0;
+  // optional third argument: reserve memory for up to this many msecs
+  if (maxmsec > 0) simple_delwrite_maxsize(x, maxmsec);
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
@@ -98,43 +180,26 @@ static t_int *simple_delwrite_perform(t_int *w)
   t_simple_delwritectl *c = (t_simple_delwritectl *)(w[2]); // delay buffer
   // control
   int n = (int)(w[3]); // block size
-  int phase = c->c_phase; // current write position
-  int nsamps = c->c_n; // size of delay buffer
-
-  // various pointers into the buffer (current write position and buffer
-  // boundaries)
-  t_sample *vp = c->c_vec; // (pointer to) the start of the buffer
-  t_sample *bp = vp + phase; // current write position
-  t_sample *ep = vp + (c->c_n + XTRASAMPS); // end of the buffer (including
-  // extra samples)
-  phase += n; // advance phase by block size
-
-  while (n--) {
-    t_sample f = *in++;
-    if (PD_BIGORSMALL(f)) { /* exponent outside (-64,64) */
-      f = 0;
-    }
-    *bp++ = f; // current write position = f, then advance pointer
-
-    // if the end of the buffer is reached (bp == ep) wrap around and copy the
-    // last few samples to the start (the start being vp[0]). These are the
-    // XTRASAMPS (4)
-    if (bp == ep) {
-      vp[0] = ep[-4];
-      vp[1] = ep[-3];
-      vp[2] = ep[-2];
-      vp[3] = ep[-1];
-      bp = vp + XTRASAMPS;
-      phase -= nsamps;
-    }
+
+  // copies the block in at the current write position, in one piece or two
+  // if it reaches the end of the buffer. When it does, the last few samples
+  // (XTRASAMPS) get copied to the start (vp[0]) and writing carries on at
+  // vp[XTRASAMPS]. The input is sanitized on the way in, rather than with a
+  // PD_BIGORSMALL check on every sample
+  if (c->c_format.f_compact) {
+    c->c_phase = delay_write_guarded_compact((t_delay_compact *)c->c_vec, c->c_n, c->c_phase,
+                                             in, n, c->c_format.f_gain);
+  } else {
+    c->c_phase = delay_write_guarded(c->c_vec, c->c_n, c->c_phase, in, n);
   }
-  c->c_phase = phase;
   return (w+4);
 }
 
 static void simple_delwrite_dsp(t_simple_delwrite *x, t_signal **sp)
 {
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
   dsp_add(simple_delwrite_perform, 3, sp[0]->s_vec, &x->x_cspace , (t_int)sp[0]->s_length);
+  DELAY_STATS_DSP_END(&x->x_stats);
   x->x_sortno = ugen_getsortno();
   simple_delwrite_check(x, sp[0]->s_length, sp[0]->s_sr);
   simple_delwrite_update(x);
@@ -143,12 +208,29 @@ static void simple_delwrite_dsp(t_simple_delwrite *x, t_signal **sp)
 static void simple_delwrite_free(t_simple_delwrite *x)
 {
   pd_unbind(&x->x_obj.ob_pd, x->x_sym);
-  if (x->x_cspace.c_vec != NULL) {
-    freebytes(x->x_cspace.c_vec,
-              (x->x_cspace.c_n + XTRASAMPS) * sizeof(t_sample));
-  }
+  delay_buffer_free(x->x_cspace.c_vec, x->x_cspace.c_words, x->x_cspace.c_inline, NULL);
 }
 
+// posts the size of the buffer the readers share, and where it lives
+static void simple_delwrite_bufinfo(t_simple_delwrite *x)
+{
+  delay_mem_post(x->x_sym->s_name, x->x_cspace.c_vec, x->x_cspace.c_words * sizeof(t_sample),
+                 x->x_cspace.c_inline);
+}
+
+// `prefault`: see delay_mem_prefault. the readers have no buffer of their own
+static void simple_delwrite_prefault(t_simple_delwrite *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void simple_delwrite_stats(t_simple_delwrite *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
 void simple_delwrite_tilde_setup(void)
 {
   simple_delwrite_class = class_new(gensym("simple_delwrite~"),
@@ -156,11 +238,22 @@ void simple_delwrite_tilde_setup(void)
                                     (t_method)simple_delwrite_free,
                                     sizeof(t_simple_delwrite),
                                     CLASS_DEFAULT,
-                                    A_DEFSYM, A_DEFFLOAT, 0);
+                                    A_DEFSYM, A_DEFFLOAT, A_DEFFLOAT, 0);
   CLASS_MAINSIGNALIN(simple_delwrite_class, t_simple_delwrite, x_f);
   class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_stats, gensym("stats"), 0);
+#endif
   class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_clear, gensym("clear"), 0);
+  class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_maxsize,
+                  gensym("maxsize"), A_FLOAT, 0);
+  class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_compact,
+                  gensym("compact"), A_FLOAT, 0);
+  class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_bufinfo,
+                  gensym("bufinfo"), 0);
+  class_addmethod(simple_delwrite_class, (t_method)simple_delwrite_prefault,
+                  gensym("prefault"), A_FLOAT, 0);
   /* important? I had the idea it was needed for pd_findbyclass to work, but not
    * so sure about that */
   class_sethelpsymbol(simple_delwrite_class, gensym("simple_delwrite~"));
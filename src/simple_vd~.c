@@ -0,0 +1,200 @@
+#include "simple_del_shared.h"
+#include <m_pd.h>
+
+extern int ugen_getsortno(void);
+
+/* A variable delay reader for simple_delwrite~, like vd~ (delread4~) in
+ * pure_data/src/d_delay.c: the delay time comes in as a signal, and is read
+ * with cubic (or linear) interpolation. Any number of them can share one
+ * simple_delwrite~ buffer.
+ * */
+
+static t_class *simple_vd_class = NULL;
+
+typedef struct _simple_vd {
+  t_object x_obj;
+  t_symbol *x_sym;
+  t_float x_sr; /* samples per msec */
+  int x_zerodel; /* 0 or vecsize depending on read/write order */
+  int x_linear; // linear rather than cubic interpolation
+
+  // read positions for a block, all worked out before anything is
+  // interpolated. room for x_alloc samples
+  int *x_phase;
+  t_sample *x_frac;
+  int x_alloc;
+
+  t_float x_f;
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+} t_simple_vd;
+
+static void simple_vd_interp(t_simple_vd *x, t_symbol *s);
+
+static void *simple_vd_new(t_symbol *s, t_symbol *interp)
+{
+  t_simple_vd *x = (t_simple_vd *)pd_new(simple_vd_class);
+  x->x_sym = s;
+  x->x_sr = 1;
+  x->x_zerodel = 0;
+  x->x_linear = 0;
+  x->x_phase = NULL;
+  x->x_frac = NULL;
+  x->x_alloc = 0;
+  x->x_f = 0;
+  if (*interp->s_name) simple_vd_interp(x, interp);
+  outlet_new(&x->x_obj, &s_signal);
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
+  return (void *)x;
+}
+
+// `interp cubic` (the default) or `interp linear`
+static void simple_vd_interp(t_simple_vd *x, t_symbol *s)
+{
+  if (s == gensym("cubic")) {
+    x->x_linear = 0;
+  } else if (s == gensym("linear")) {
+    x->x_linear = 1;
+  } else {
+    pd_error(x, "simple_vd~: interp: '%s' isn't cubic or linear", s->s_name);
+  }
+}
+
+static t_int *simple_vd_perform(t_int *w)
+{
+  t_sample *in = (t_sample *)(w[1]); // delay time in msecs
+  t_sample *out = (t_sample *)(w[2]);
+  t_simple_delwritectl *c = (t_simple_delwritectl *)(w[3]);
+  t_simple_vd *x = (t_simple_vd *)(w[4]);
+  int n = (int)(w[5]);
+
+  int nsamps = c->c_n;
+  t_sample limit = nsamps - n;
+  t_sample fn = n - 1;
+  t_sample *vp = c->c_vec;
+  int write_phase = c->c_phase;
+  t_sample sr = x->x_sr;
+  t_sample zerodel = x->x_zerodel;
+  int *phase = x->x_phase;
+  t_sample *frac = x->x_frac;
+
+  if (limit < 0) { /* blocksize is larger than simple_delwrite~ buffer size */
+    while (n--) *out++ = 0;
+    return (w+6);
+  }
+
+  // where each sample of the block reads from. this loop has no loads from
+  // the buffer, so it vectorizes. `in` and `out` can be the same vector, which
+  // is one more reason to be done with `in` before writing anything out
+  for (int i = 0; i < n; i++) {
+    t_sample delsamps = sr * in[i] - zerodel;
+    if (!(delsamps >= 1.00001f)) delsamps = 1.00001f; /* too small or NAN */
+    if (delsamps > limit) delsamps = limit; /* too big */
+    // a sliding window, as in vd~: sample i is (n - 1 - i) samples behind the
+    // write position at the end of the block
+    delsamps += fn - (t_sample)i;
+    int idelsamps = delsamps;
+    frac[i] = delsamps - (t_sample)idelsamps;
+    int read_phase = write_phase - idelsamps;
+    // the XTRASAMPS guard samples at the start of the buffer are a copy of
+    // the last few samples, so all four points are always contiguous
+    if (read_phase < XTRASAMPS) read_phase += nsamps;
+    phase[i] = read_phase;
+  }
+
+  if (c->c_format.f_compact) {
+    const t_delay_compact *vq = (const t_delay_compact *)vp;
+    t_sample scale = c->c_format.f_scale;
+    if (x->x_linear) {
+      for (int i = 0; i < n; i++) {
+        const t_delay_compact *bp = vq + phase[i];
+        t_sample b = bp[-1];
+        out[i] = scale * (b + frac[i] * ((t_sample)bp[-2] - b));
+      }
+    } else {
+      cubic_interpolate_taps_compact(vq, -1, phase, frac, scale, out, n);
+    }
+  } else if (x->x_linear) {
+    for (int i = 0; i < n; i++) {
+      t_sample *bp = vp + phase[i];
+      out[i] = bp[-1] + frac[i] * (bp[-2] - bp[-1]);
+    }
+  } else {
+    // every phase is >= XTRASAMPS, so no masking is needed: -1 leaves the
+    // indexes alone
+    cubic_interpolate_taps(vp, -1, phase, frac, out, n);
+  }
+  return (w+6);
+}
+
+static void simple_vd_dsp(t_simple_vd *x, t_signal **sp)
+{
+  t_simple_delwrite *delwriter = (t_simple_delwrite *)simple_delwrite_findbyname(x->x_sym);
+  int n = sp[0]->s_length;
+  x->x_sr = sp[0]->s_sr * 0.001;
+
+  if (n > x->x_alloc) {
+    // both or neither: x_alloc has to stay the size of the two of them
+    void *arrays[] = {x->x_phase, x->x_frac};
+    const size_t sizes[] = {sizeof(int), sizeof(t_sample)};
+    void *grown[2];
+    if (!delay_arrays_grow(arrays, grown, sizes, 2, x->x_alloc, n)) {
+      pd_error(x, "simple_vd~: unable to assign memory");
+      return;
+    }
+    x->x_phase = (int *)grown[0];
+    x->x_frac = (t_sample *)grown[1];
+    x->x_alloc = n;
+  }
+
+  if (delwriter) {
+    simple_delwrite_check(delwriter, sp[0]->s_n, sp[0]->s_sr);
+    x->x_zerodel = (delwriter->x_sortno == ugen_getsortno() ?
+                    0 : delwriter->x_vecsize);
+    DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
+    dsp_add(simple_vd_perform, 5,
+            sp[0]->s_vec, sp[1]->s_vec, &delwriter->x_cspace, x, (t_int)n);
+    DELAY_STATS_DSP_END(&x->x_stats);
+  } else if (*x->x_sym->s_name) {
+    pd_error(x, "simple_vd~: %s: no such simple_delwrite~", x->x_sym->s_name);
+  }
+}
+
+static void simple_vd_free(t_simple_vd *x)
+{
+  if (x->x_alloc > 0) {
+    freebytes(x->x_phase, x->x_alloc * sizeof(int));
+    freebytes(x->x_frac, x->x_alloc * sizeof(t_sample));
+  }
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void simple_vd_stats(t_simple_vd *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+void simple_vd_tilde_setup(void)
+{
+  simple_del_kernels_init();
+
+  simple_vd_class = class_new(gensym("simple_vd~"),
+                              (t_newmethod)simple_vd_new,
+                              (t_method)simple_vd_free,
+                              sizeof(t_simple_vd),
+                              0,
+                              A_DEFSYM, A_DEFSYM, 0);
+  class_addmethod(simple_vd_class, (t_method)simple_vd_dsp, gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(simple_vd_class, (t_method)simple_vd_stats, gensym("stats"), 0);
+#endif
+  class_addmethod(simple_vd_class, (t_method)simple_vd_interp, gensym("interp"), A_SYMBOL, 0);
+  CLASS_MAINSIGNALIN(simple_vd_class, t_simple_vd, x_f);
+  class_sethelpsymbol(simple_vd_class, gensym("delay-tilde-objects"));
+}
@@ -7,17 +7,32 @@ typedef struct _stereotaps {
   t_float x_s_per_msec; // samples per msec
   t_float x_delay_buffer_msecs;
   int x_delay_buffer_samples; // number of samples in delay buffer
+  int x_delay_buffer_alloc; // samples allocated per channel, at least x_delay_buffer_samples
   int x_delay_buffer_initial_samples;
   t_float x_delay_msecs; // number of msecs to delay
   t_float x_delay_samples; // number of samples of delay
   t_sample *x_delay_buffer_l;
   t_sample *x_delay_buffer_r;
+  // both channels in one buffer as (left, right) frames, 2 *
+  // x_delay_buffer_samples long. used instead of _l and _r when x_interleaved
+  // is set, so a tap reads its 4 points for both channels from one run of
+  // memory
+  t_sample *x_delay_buffer_lr;
+  int x_interleaved;
   int x_pd_block_size;
   int x_phase; // current __write__ position
   int x_num_taps;
   int x_feedback_tap_l;
   int x_feedback_tap_r;
 
+  // scratch space for cubic_interpolate_taps, room for x_tap_alloc taps
+  int *x_tap_phase;
+  t_sample *x_tap_frac;
+  t_sample *x_tap_out_l;
+  t_sample *x_tap_out_r;
+  t_sample *x_tap_out_lr; // 2 * x_tap_alloc, for the interleaved buffer
+  int x_tap_alloc;
+
   t_float x_wet_dry;
   t_float x_feedback;
   t_float x_cross_feedback;
@@ -26,14 +41,23 @@ typedef struct _stereotaps {
   t_outlet *x_out1;
   t_outlet *x_out2;
 
+#ifdef SIMPLE_DEL_STATS
+  t_delay_stats x_stats;
+  t_outlet *x_info; // where `stats` goes
+#endif
+
+  t_delay_arena *x_arena; // the patch's pool, that the buffers come from
 } t_stereotaps;
 
 t_class *stereotaps_class = NULL;
 
 static void delay_buffer_update(t_stereotaps *x);
+static void delay_maxsize(t_stereotaps *x, t_floatarg msecs);
 static void delay_set_delay_samples(t_stereotaps *x, t_float f);
+static int delay_tap_alloc(t_stereotaps *x, int num_taps);
 
-static void *stereotaps_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
+static void *stereotaps_new(t_floatarg buffer_msecs, t_floatarg delay_msecs,
+                            t_floatarg max_msecs)
 {
   t_stereotaps *x = (t_stereotaps *)pd_new(stereotaps_class);
 
@@ -46,23 +70,35 @@ static void *stereotaps_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_delay_samples = 0;
   
   x->x_delay_buffer_samples = 1024; // initialize with 2^10;
-
-  x->x_delay_buffer_l = getbytes(x->x_delay_buffer_samples * sizeof(t_sample));
-  if (x->x_delay_buffer_l == NULL) {
-    pd_error(x, "stereotaps~: unable to assign memory to delay buffer");
-    return NULL;
-    }
-  x->x_delay_buffer_r = getbytes(x->x_delay_buffer_samples * sizeof(t_sample));
-  if (x->x_delay_buffer_r == NULL) {
+  x->x_delay_buffer_alloc = x->x_delay_buffer_samples;
+
+  x->x_interleaved = 1;
+  x->x_delay_buffer_l = NULL;
+  x->x_delay_buffer_r = NULL;
+  x->x_arena = delay_arena_get();
+  x->x_delay_buffer_lr = delay_arena_alloc(x->x_arena,
+                                           2 * x->x_delay_buffer_samples * sizeof(t_sample));
+  if (x->x_delay_buffer_lr == NULL) {
     pd_error(x, "stereotaps~: unable to assign memory to delay buffer");
+    pd_free((t_pd *)x);
     return NULL;
     }
+  // optional third argument: reserve memory for a buffer of up to this many
+  // msecs
+  if (max_msecs > 0) delay_maxsize(x, max_msecs);
 
   x->x_num_taps = 4; // hardcoded for now
   x->x_feedback_tap_l = 3; // these probably don't make sense as default values
   x->x_feedback_tap_r = 4;
   x->x_cross_feedback = 0.0f;
 
+  x->x_tap_alloc = 0;
+  if (!delay_tap_alloc(x, x->x_num_taps)) {
+    pd_error(x, "stereotaps~: unable to assign memory for taps");
+    pd_free((t_pd *)x); // delay_free releases the buffer and the arena ref
+    return NULL;
+  }
+
   x->x_delay_msec_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   // set inlet initial float value
   pd_float((t_pd *)x->x_delay_msec_inlet, x->x_delay_msecs);
@@ -70,41 +106,106 @@ static void *stereotaps_new(t_floatarg buffer_msecs, t_floatarg delay_msecs)
   x->x_out1 = outlet_new(&x->x_obj, &s_signal);
   x->x_out2 = outlet_new(&x->x_obj, &s_signal);
 
+#ifdef SIMPLE_DEL_STATS
+  delay_stats_init(&x->x_stats);
+  x->x_info = outlet_new(&x->x_obj, 0);
+#endif
   return (void *)x;
 }
 
-static void delay_buffer_update(t_stereotaps *x)
+// grows the per-tap scratch arrays. returns 0 on failure
+static int delay_tap_alloc(t_stereotaps *x, int num_taps)
 {
-  int buffer_size = 1;
-  while (buffer_size < (x->x_delay_buffer_msecs * x->x_s_per_msec + x->x_pd_block_size)) {
-    buffer_size *= 2;
-  }
+  if (num_taps <= x->x_tap_alloc) return 1;
+
+  // x_tap_out_lr holds a pair of samples per tap
+  void *arrays[] = {x->x_tap_phase, x->x_tap_frac, x->x_tap_out_l, x->x_tap_out_r,
+                    x->x_tap_out_lr};
+  const size_t sizes[] = {sizeof(int), sizeof(t_sample), sizeof(t_sample), sizeof(t_sample),
+                          2 * sizeof(t_sample)};
+  void *grown[5];
+  if (!delay_arrays_grow(arrays, grown, sizes, 5, x->x_tap_alloc, num_taps)) return 0;
+
+  x->x_tap_phase = (int *)grown[0];
+  x->x_tap_frac = (t_sample *)grown[1];
+  x->x_tap_out_l = (t_sample *)grown[2];
+  x->x_tap_out_r = (t_sample *)grown[3];
+  x->x_tap_out_lr = (t_sample *)grown[4];
+  x->x_tap_alloc = num_taps;
+  return 1;
+}
 
-  x->x_delay_buffer_l = (t_sample *)resizebytes(x->x_delay_buffer_l,
-                                              x->x_delay_buffer_samples *
-                                              sizeof(t_sample), buffer_size * sizeof(t_sample));
-  if (x->x_delay_buffer_l == NULL) {
-    pd_error(x, "stereotaps~: unable to resize x_delay_buffer_l");
-    return;
-  }
-  x->x_delay_buffer_r = (t_sample *)resizebytes(x->x_delay_buffer_r,
-                                              x->x_delay_buffer_samples *
-                                              sizeof(t_sample), buffer_size * sizeof(t_sample));
-  if (x->x_delay_buffer_r == NULL) {
-    pd_error(x, "stereotaps~: unable to resize x_delay_buffer_r");
-    return;
+// makes sure there's memory for `samples` frames, in whichever layout is in
+// use, without changing the size of the buffer in use. returns 0 on failure
+static int delay_buffer_reserve(t_stereotaps *x, int samples)
+{
+  int alloc = x->x_delay_buffer_alloc;
+  if (samples <= alloc) return 1;
+
+  if (x->x_interleaved) {
+    t_sample *lr = (t_sample *)delay_arena_resize(x->x_arena, x->x_delay_buffer_lr,
+                                                  2 * alloc * sizeof(t_sample),
+                                                  2 * samples * sizeof(t_sample));
+    if (lr == NULL) {
+      pd_error(x, "stereotaps~: unable to resize x_delay_buffer_lr");
+      return 0;
+    }
+    x->x_delay_buffer_lr = lr;
+  } else {
+    // both new buffers before either old one goes, so that running out of
+    // memory leaves l and r as they were, matching x_delay_buffer_alloc
+    t_sample *l = delay_arena_alloc(x->x_arena, samples * sizeof(t_sample));
+    t_sample *r = delay_arena_alloc(x->x_arena, samples * sizeof(t_sample));
+    if (l == NULL || r == NULL) {
+      if (l != NULL) delay_arena_free(x->x_arena, l, samples * sizeof(t_sample));
+      if (r != NULL) delay_arena_free(x->x_arena, r, samples * sizeof(t_sample));
+      pd_error(x, "stereotaps~: unable to resize x_delay_buffer_l and x_delay_buffer_r");
+      return 0;
+    }
+    memcpy(l, x->x_delay_buffer_l, alloc * sizeof(t_sample));
+    memcpy(r, x->x_delay_buffer_r, alloc * sizeof(t_sample));
+    delay_arena_free(x->x_arena, x->x_delay_buffer_l, alloc * sizeof(t_sample));
+    delay_arena_free(x->x_arena, x->x_delay_buffer_r, alloc * sizeof(t_sample));
+    x->x_delay_buffer_l = l;
+    x->x_delay_buffer_r = r;
   }
+  x->x_delay_buffer_alloc = samples;
+  return 1;
+}
 
+// called on every DSP rebuild: does nothing unless the size has changed, and
+// keeps the contents of the buffer when it has (see delay_ring_resize)
+static void delay_buffer_update(t_stereotaps *x)
+{
+  int size = x->x_delay_buffer_samples;
+  int buffer_size = delay_pow2_size(x->x_delay_buffer_msecs * x->x_s_per_msec +
+                                    x->x_pd_block_size);
+  if (buffer_size == size) return;
+  if (!delay_buffer_reserve(x, buffer_size)) return;
+
+  if (x->x_interleaved) {
+    x->x_phase = delay_ring_resize(x->x_delay_buffer_lr, size, buffer_size, x->x_phase, 2);
+  } else {
+    delay_ring_resize(x->x_delay_buffer_l, size, buffer_size, x->x_phase, 1);
+    x->x_phase = delay_ring_resize(x->x_delay_buffer_r, size, buffer_size, x->x_phase, 1);
+  }
   x->x_delay_buffer_samples = buffer_size;
-  x->x_phase = 0;
-  post("stereotaps~: (debug) updated delay buffer");
-  post("stereotaps~: (debug) x_delay_buffer_samples: %d", x->x_delay_buffer_samples);
+}
+
+// reserves memory for a buffer of up to `msecs`, so that a DSP rebuild that
+// needs a bigger buffer (a longer buffer time, a higher sample rate) doesn't
+// have to allocate
+static void delay_maxsize(t_stereotaps *x, t_floatarg msecs)
+{
+  t_float s_per_msec = (x->x_s_per_msec > 0) ? x->x_s_per_msec : sys_getsr() * 0.001;
+  int block_size = (x->x_pd_block_size > 0) ? x->x_pd_block_size : sys_getblksize();
+  delay_buffer_reserve(x, delay_pow2_size(msecs * s_per_msec + block_size));
 }
 
 static void delay_set_system_params(t_stereotaps *x, int blocksize, t_float sr)
 {
   x->x_pd_block_size = blocksize;
-  x->x_s_per_msec = sr * 0.001f;
+  x->x_s_per_msec = sr * 0.001;
 }
 
 static void delay_set_delay_samples(t_stereotaps *x, t_float f)
@@ -126,10 +227,15 @@ static t_int *stereotaps_perform(t_int *w)
   int delay_buffer_mask = delay_buffer_samples - 1;
   int write_phase = x->x_phase;
   write_phase = write_phase & delay_buffer_mask;
+  int write_start = write_phase;
+  int block_size = n;
 
   // todo: get pointers to left and right buffers
   t_sample *vpl = x->x_delay_buffer_l;
   t_sample *vpr = x->x_delay_buffer_r;
+  t_sample *vplr = x->x_delay_buffer_lr;
+  int interleaved = x->x_interleaved;
+  t_denormal_state denormal_state = denormals_off();
 
   t_float wet_dry = x->x_wet_dry;
   t_float wet_dry_inv = (1.0f - wet_dry);
@@ -145,21 +251,41 @@ static t_int *stereotaps_perform(t_int *w)
     while (n--) {
       t_sample f = *in1++;
       f *= 0.5f;
-      if (PD_BIGORSMALL(f)) f = 0.0f;
-      vpl[write_phase] = f;
-      vpr[write_phase] = f;
+      if (interleaved) {
+        vplr[2 * write_phase] = f;
+        vplr[2 * write_phase + 1] = f;
+      } else {
+        vpl[write_phase] = f;
+        vpr[write_phase] = f;
+      }
       *out1++ = 0;
       *out2++ = 0;
       write_phase = (write_phase + 1) & delay_buffer_mask;
     }
     x->x_phase = write_phase;
+    if (interleaved) {
+      denormals_sanitize_ring(vplr, 2 * delay_buffer_samples, 2 * write_start, 2 * block_size);
+    } else {
+      denormals_sanitize_ring(vpl, delay_buffer_samples, write_start, block_size);
+      denormals_sanitize_ring(vpr, delay_buffer_samples, write_start, block_size);
+    }
+    denormals_restore(denormal_state);
     return (w+7);
   }
 
+  t_float s_per_msec = x->x_s_per_msec;
+  int num_taps = x->x_num_taps;
+  int feedback_tap_l = x->x_feedback_tap_l;
+  int feedback_tap_r = x->x_feedback_tap_r;
+  int *tap_phase = x->x_tap_phase;
+  t_sample *tap_frac = x->x_tap_frac;
+  t_sample *tap_out_l = x->x_tap_out_l;
+  t_sample *tap_out_r = x->x_tap_out_r;
+  t_sample *tap_out_lr = x->x_tap_out_lr;
+
   while (n--) {
     t_sample f = *in1++;
     f *= 0.5f;
-    if (PD_BIGORSMALL(f)) f = 0.0f;
 
     t_sample delms = *in2++;
 
@@ -168,41 +294,81 @@ static t_int *stereotaps_perform(t_int *w)
     t_sample tap_delay_left = 0.0f;
     t_sample tap_delay_right = 0.0f;
 
-    for (int i = 0; i < x->x_num_taps; i++) {
+    // both channels read from the same positions, so they're worked out once
+    // and used for both channels
+    for (int i = 0; i < num_taps; i++) {
       int tap = i + 1;
-      t_sample delsamps = x->x_s_per_msec * (float)tap * delms;
+      t_sample delsamps = s_per_msec * (t_sample)tap * delms;
 
       if (!(delsamps >= 1.00001f)) delsamps = 1.00001f;
       if (delsamps > limit) delsamps = limit;
 
       int idelsamps = delsamps;
-      int read_phase = (write_phase - idelsamps) & delay_buffer_mask;
-      t_sample frac = delsamps - (t_sample)idelsamps;
-      t_sample delay_line_left = cubic_interpolate(vpl, read_phase, delay_buffer_mask, frac);
-      t_sample delay_line_right = cubic_interpolate(vpr, read_phase, delay_buffer_mask, frac);
-      out_delays_left += tap_level * delay_line_left;
-      out_delays_right += tap_level * delay_line_right;
-      
-      if (tap == x->x_feedback_tap_l) tap_delay_left = delay_line_left;
-      if (tap == x->x_feedback_tap_r) tap_delay_right = delay_line_right;
+      tap_phase[i] = (write_phase - idelsamps) & delay_buffer_mask;
+      tap_frac[i] = delsamps - (t_sample)idelsamps;
+    }
+
+    if (interleaved) {
+      cubic_interpolate_taps_stereo(vplr, delay_buffer_mask, tap_phase, tap_frac, tap_out_lr, num_taps);
+
+      for (int i = 0; i < num_taps; i++) {
+        out_delays_left += tap_level * tap_out_lr[2 * i];
+        out_delays_right += tap_level * tap_out_lr[2 * i + 1];
+      }
+      if (feedback_tap_l >= 1 && feedback_tap_l <= num_taps) {
+        tap_delay_left = tap_out_lr[2 * (feedback_tap_l - 1)];
+      }
+      if (feedback_tap_r >= 1 && feedback_tap_r <= num_taps) {
+        tap_delay_right = tap_out_lr[2 * (feedback_tap_r - 1) + 1];
+      }
+    } else {
+      cubic_interpolate_taps(vpl, delay_buffer_mask, tap_phase, tap_frac, tap_out_l, num_taps);
+      cubic_interpolate_taps(vpr, delay_buffer_mask, tap_phase, tap_frac, tap_out_r, num_taps);
+
+      for (int i = 0; i < num_taps; i++) {
+        out_delays_left += tap_level * tap_out_l[i];
+        out_delays_right += tap_level * tap_out_r[i];
+      }
+      if (feedback_tap_l >= 1 && feedback_tap_l <= num_taps) {
+        tap_delay_left = tap_out_l[feedback_tap_l - 1];
+      }
+      if (feedback_tap_r >= 1 && feedback_tap_r <= num_taps) {
+        tap_delay_right = tap_out_r[feedback_tap_r - 1];
+      }
     }
 
     *out1++ = wet_dry * out_delays_left + wet_dry_inv * f;
     *out2++ = wet_dry * out_delays_right + wet_dry_inv * f;
 
-    vpl[write_phase] = (f * feedback_inv) + (tap_delay_left * feedback) + (tap_delay_right * cross_feedback);
-    vpr[write_phase] = (f * feedback_inv) + (tap_delay_right * feedback) + (tap_delay_left * cross_feedback);
+    t_sample in_left = (f * feedback_inv) + (tap_delay_left * feedback) + (tap_delay_right * cross_feedback);
+    t_sample in_right = (f * feedback_inv) + (tap_delay_right * feedback) + (tap_delay_left * cross_feedback);
+    if (interleaved) {
+      vplr[2 * write_phase] = in_left;
+      vplr[2 * write_phase + 1] = in_right;
+    } else {
+      vpl[write_phase] = in_left;
+      vpr[write_phase] = in_right;
+    }
 
     write_phase = (write_phase + 1) & delay_buffer_mask;
   }
 
   x->x_phase = write_phase;
+  if (interleaved) {
+    denormals_sanitize_ring(vplr, 2 * delay_buffer_samples, 2 * write_start, 2 * block_size);
+  } else {
+    denormals_sanitize_ring(vpl, delay_buffer_samples, write_start, block_size);
+    denormals_sanitize_ring(vpr, delay_buffer_samples, write_start, block_size);
+  }
+  denormals_restore(denormal_state);
   return (w+7);
 }
 
 static void stereotaps_dsp(t_stereotaps *x, t_signal **sp)
 {
+  DELAY_STATS_DSP_BEGIN(&x->x_stats, sp[0]->s_length, sp[0]->s_sr);
   dsp_add(stereotaps_perform, 6, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, sp[0]->s_length);
+  DELAY_STATS_DSP_END(&x->x_stats);
   delay_set_system_params(x, sp[0]->s_length, sp[0]->s_sr);
   delay_buffer_update(x);
   delay_set_delay_samples(x, x->x_delay_msecs);
@@ -211,17 +377,33 @@ static void stereotaps_dsp(t_stereotaps *x, t_signal **sp)
 static void delay_free(t_stereotaps *x)
 {
   if (x->x_delay_buffer_l != NULL) {
-    freebytes(x->x_delay_buffer_l,
-              x->x_delay_buffer_samples * sizeof(t_sample));
+    delay_arena_free(x->x_arena, x->x_delay_buffer_l,
+                     x->x_delay_buffer_alloc * sizeof(t_sample));
     x->x_delay_buffer_l = NULL;
   }
 
   if (x->x_delay_buffer_r != NULL) {
-    freebytes(x->x_delay_buffer_r,
-              x->x_delay_buffer_samples * sizeof(t_sample));
+    delay_arena_free(x->x_arena, x->x_delay_buffer_r,
+                     x->x_delay_buffer_alloc * sizeof(t_sample));
     x->x_delay_buffer_r = NULL;
   }
 
+  if (x->x_delay_buffer_lr != NULL) {
+    delay_arena_free(x->x_arena, x->x_delay_buffer_lr,
+                     2 * x->x_delay_buffer_alloc * sizeof(t_sample));
+    x->x_delay_buffer_lr = NULL;
+  }
+  delay_arena_release(x->x_arena);
+
+  if (x->x_tap_alloc > 0) {
+    freebytes(x->x_tap_phase, x->x_tap_alloc * sizeof(int));
+    freebytes(x->x_tap_frac, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_out_l, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_out_r, x->x_tap_alloc * sizeof(t_sample));
+    freebytes(x->x_tap_out_lr, 2 * x->x_tap_alloc * sizeof(t_sample));
+    x->x_tap_alloc = 0;
+  }
+
   if (x->x_out1 != NULL) {
     outlet_free(x->x_out1);
   }
@@ -254,6 +436,10 @@ static void delay_taps(t_stereotaps *x, t_floatarg f)
     pd_error(x, "stereotaps~: there needs to be at least 1 tap. Setting to 1");
     f = 1.0f;
   }
+  if (!delay_tap_alloc(x, (int)f)) {
+    pd_error(x, "stereotaps~: unable to assign memory for %d taps", (int)f);
+    return;
+  }
   x->x_num_taps = (int)f;
 }
 
@@ -274,17 +460,102 @@ static void delay_cross_feedback(t_stereotaps *x, t_floatarg f)
   x->x_cross_feedback = f;
 }
 
+// `interleaved 1` (the default) keeps both channels in one buffer of
+// (left, right) frames, `interleaved 0` in two separate buffers. what's
+// already in the buffer is kept, along with any memory reserved with `maxsize`
+static void delay_interleaved(t_stereotaps *x, t_floatarg f)
+{
+  int interleaved = (f != 0);
+  int size = x->x_delay_buffer_alloc;
+  if (interleaved == x->x_interleaved) return;
+
+  if (interleaved) {
+    t_sample *lr = delay_arena_alloc(x->x_arena, 2 * size * sizeof(t_sample));
+    if (lr == NULL) {
+      pd_error(x, "stereotaps~: unable to assign memory to delay buffer");
+      return;
+    }
+    for (int i = 0; i < size; i++) {
+      lr[2 * i] = x->x_delay_buffer_l[i];
+      lr[2 * i + 1] = x->x_delay_buffer_r[i];
+    }
+    delay_arena_free(x->x_arena, x->x_delay_buffer_l, size * sizeof(t_sample));
+    delay_arena_free(x->x_arena, x->x_delay_buffer_r, size * sizeof(t_sample));
+    x->x_delay_buffer_l = NULL;
+    x->x_delay_buffer_r = NULL;
+    x->x_delay_buffer_lr = lr;
+  } else {
+    t_sample *l = delay_arena_alloc(x->x_arena, size * sizeof(t_sample));
+    t_sample *r = delay_arena_alloc(x->x_arena, size * sizeof(t_sample));
+    if (l == NULL || r == NULL) {
+      if (l != NULL) delay_arena_free(x->x_arena, l, size * sizeof(t_sample));
+      if (r != NULL) delay_arena_free(x->x_arena, r, size * sizeof(t_sample));
+      pd_error(x, "stereotaps~: unable to assign memory to delay buffer");
+      return;
+    }
+    for (int i = 0; i < size; i++) {
+      l[i] = x->x_delay_buffer_lr[2 * i];
+      r[i] = x->x_delay_buffer_lr[2 * i + 1];
+    }
+    delay_arena_free(x->x_arena, x->x_delay_buffer_lr, 2 * size * sizeof(t_sample));
+    x->x_delay_buffer_lr = NULL;
+    x->x_delay_buffer_l = l;
+    x->x_delay_buffer_r = r;
+  }
+  x->x_interleaved = interleaved;
+}
+
+#ifdef SIMPLE_DEL_STATS
+static void delay_stats(t_stereotaps *x)
+{
+  delay_stats_output(&x->x_stats, x->x_info);
+}
+#endif
+
+// `bufinfo`: the buffer (or the left and right buffers, when they aren't
+// interleaved), and what memory each is in
+static void delay_bufinfo(t_stereotaps *x)
+{
+  if (x->x_interleaved) {
+    delay_mem_post("stereotaps~", x->x_delay_buffer_lr,
+                   2 * x->x_delay_buffer_alloc * sizeof(t_sample), NULL);
+  } else {
+    delay_mem_post("stereotaps~ left", x->x_delay_buffer_l,
+                   x->x_delay_buffer_alloc * sizeof(t_sample), NULL);
+    delay_mem_post("stereotaps~ right", x->x_delay_buffer_r,
+                   x->x_delay_buffer_alloc * sizeof(t_sample), NULL);
+  }
+}
+
+// `poolstats` reports on the pool both channels' buffers come from
+static void delay_poolstats(t_stereotaps *x)
+{
+  delay_arena_post("stereotaps~", x->x_arena);
+}
+
+// `prefault 0|1|2` sets how every delay buffer's pages are handled (see
+// delay_mem_prefault)
+static void delay_prefault(t_stereotaps *x, t_floatarg mode)
+{
+  delay_mem_prefault(x, mode);
+}
+
 void stereotaps_tilde_setup(void)
 {
+  simple_del_kernels_init();
+
   stereotaps_class = class_new(gensym("stereotaps~"),
                           (t_newmethod)stereotaps_new,
                           (t_method)delay_free,
                           sizeof(t_stereotaps),
                           CLASS_DEFAULT,
-                          A_DEFFLOAT, A_DEFFLOAT, 0);
+                          A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
 
   class_addmethod(stereotaps_class, (t_method)stereotaps_dsp,
                   gensym("dsp"), A_CANT, 0);
+#ifdef SIMPLE_DEL_STATS
+  class_addmethod(stereotaps_class, (t_method)delay_stats, gensym("stats"), 0);
+#endif
 
   class_addmethod(stereotaps_class, (t_method)delay_wet_dry,
                   gensym("wet_dry"), A_FLOAT, 0);
@@ -298,6 +569,13 @@ void stereotaps_tilde_setup(void)
                   gensym("feedback_tap_r"), A_FLOAT, 0);
   class_addmethod(stereotaps_class, (t_method)delay_cross_feedback,
                   gensym("cross_feedback"), A_FLOAT, 0);
+  class_addmethod(stereotaps_class, (t_method)delay_interleaved,
+                  gensym("interleaved"), A_FLOAT, 0);
+  class_addmethod(stereotaps_class, (t_method)delay_maxsize,
+                  gensym("maxsize"), A_FLOAT, 0);
+  class_addmethod(stereotaps_class, (t_method)delay_bufinfo, gensym("bufinfo"), 0);
+  class_addmethod(stereotaps_class, (t_method)delay_prefault, gensym("prefault"), A_FLOAT, 0);
+  class_addmethod(stereotaps_class, (t_method)delay_poolstats, gensym("poolstats"), 0);
 
   // dummy float arg is required by Pd
   // but... is this right?